@@ -0,0 +1,37 @@
+#pragma once
+#include "Arduino.h"
+#include "driver/uart.h"
+#include "consoleEgress.h"
+#include "esPod_conf.h"
+#include "snooper.h"
+
+/// @brief Loopback stress benchmark for a snooper channel. With the TX pin of a sender channel UART jumpered to the RX pin
+/// of the channel under test, the sender is forced to every candidate rate in turn and sends frames back-to-back for
+/// STRESS_DURATION_MS. The channel under test is left hunting, so it has to detect each change : the frames lost until it
+/// locks on the new rate are reported apart from the steady-state drops, next to the overflow, pool and console counters.
+class baudStress
+{
+private:
+    /// @brief How the channel under test caught up with the rate of the sender
+    struct relockStats
+    {
+        bool relocked = false;
+        uint32_t ms = 0;      // From the first frame sent to the lock
+        uint32_t sent = 0;    // Frames sent until the lock
+        uint32_t decoded = 0; // Frames decoded until the lock, the ones that locked the rate included
+    };
+
+    snooper &_snooper;
+    uint8_t _channel;
+    uint8_t _sender;
+    consoleEgress &_egress;
+    TaskHandle_t _stressTaskHandle = NULL;
+
+    static void _stressTask(void *pvParameters);
+    uint32_t _sendFor(uint32_t durationMs, uint32_t baudRate, relockStats &relock);
+
+public:
+    baudStress(snooper &target, uint8_t channel, uint8_t sender, consoleEgress &egress);
+
+    esp_err_t begin();
+};
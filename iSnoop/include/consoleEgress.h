@@ -0,0 +1,32 @@
+#pragma once
+#include "Arduino.h"
+#include "freertos/ringbuf.h"
+#include "esPod_conf.h"
+
+/// @brief Single console output stage shared by every snooper channel. Records are coalesced in a byte ring buffer
+/// and flushed to the console by a dedicated task in writes of up to CONSOLE_FLUSH_MAX_BYTES.
+class consoleEgress
+{
+private:
+    RingbufHandle_t _ring = NULL;
+    TaskHandle_t _flushTaskHandle = NULL;
+
+    static void _flushTask(void *pvParameters);
+
+    // Counters
+    uint32_t _peakBacklog = 0;
+    uint32_t _droppedBytes = 0;
+    uint32_t _droppedRecords = 0;
+    uint32_t _writes = 0;
+    uint64_t _bytesWritten = 0;
+
+public:
+    esp_err_t begin(uint32_t baudRate);
+    bool push(const byte *data, size_t len);
+    void logStats();
+
+    uint32_t backlog() const;
+    uint32_t peakBacklog() const { return _peakBacklog; }
+    uint32_t droppedBytes() const { return _droppedBytes; }
+    uint32_t droppedRecords() const { return _droppedRecords; }
+};
@@ -0,0 +1,37 @@
+#pragma once
+#include "Arduino.h"
+#include "esp_timer.h"
+#include "aapCapture.h"
+#include "streamMerger.h"
+#include "esPod_conf.h"
+
+/// @brief Background sampler of the iPod detect line, shared by every snooper channel.
+/// ADC1 pins are sampled in continuous (DMA) mode, other pins (e.g. GPIO4 on ADC2) fall back to periodic one-shot reads.
+/// Min/max windows are also emitted as AAP_CAPTURE_DETECT records to give a voltage timeline on the console.
+class detectSampler
+{
+private:
+    streamMerger &_merger;
+    uint8_t _pin = 0;
+    bool _continuous = false;
+    TaskHandle_t _sampleTaskHandle = NULL;
+
+    static detectSampler *_instance; // For the ADC ISR callback
+    static void ARDUINO_ISR_ATTR _onConversionDone();
+    static void _sampleTask(void *pvParameters);
+
+    // Latest value and current window, written by the sample task only
+    volatile uint16_t _latestMilliVolts = 0;
+    uint16_t _windowMin = UINT16_MAX;
+    uint16_t _windowMax = 0;
+
+    void _record(uint16_t milliVolts);
+    void _emitWindow();
+
+public:
+    detectSampler(streamMerger &merger);
+
+    esp_err_t begin(uint8_t pin);
+    uint16_t latestMilliVolts() const { return _latestMilliVolts; }
+    bool isContinuous() const { return _continuous; }
+};
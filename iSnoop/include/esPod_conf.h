@@ -2,21 +2,46 @@
 #include "Arduino.h"
 
 // Serial settings
-#ifndef MAX_PACKET_SIZE
-#define MAX_PACKET_SIZE 1024
-#endif
 #ifndef SERIAL_TIMEOUT
 #define SERIAL_TIMEOUT 60000
 #endif
+#ifndef COMMAND_DESCRIPTION_SIZE
+#define COMMAND_DESCRIPTION_SIZE 160
+#endif
 #ifndef INTERBYTE_TIMEOUT
 #define INTERBYTE_TIMEOUT 500
 #endif
+// UART driver settings
+#ifndef RX_BUFFER_SIZE
+#define RX_BUFFER_SIZE 2048
+#endif
+#ifndef UART_EVENT_QUEUE_SIZE
+#define UART_EVENT_QUEUE_SIZE 20
+#endif
+#ifndef RX_CHUNK_SIZE
+#define RX_CHUNK_SIZE 128
+#endif
+// Snooper channels, all serviced by the same RX and processing tasks
+#ifndef SNOOPER_MAX_CHANNELS
+#define SNOOPER_MAX_CHANNELS 4
+#endif
+// Line rate detection, the rate passed to addChannel() is tried first
+#ifndef AUTOBAUD
+#define AUTOBAUD 1
+#endif
+#ifndef AUTOBAUD_CANDIDATES
+#define AUTOBAUD_CANDIDATES 19200, 57600, 38400, 115200, 9600
+#endif
 // FreeRTOS Queues
 #ifndef CMD_QUEUE_SIZE
 #define CMD_QUEUE_SIZE 32
 #endif
-#ifndef TX_QUEUE_SIZE
-#define TX_QUEUE_SIZE 32
+// Packet pool, shared by every channel of the snooper
+#ifndef PACKET_POOL_SIZE
+#define PACKET_POOL_SIZE 32
+#endif
+#ifndef PACKET_SLAB_SIZE
+#define PACKET_SLAB_SIZE 256
 #endif
 #ifndef TIMER_QUEUE_SIZE
 #define TIMER_QUEUE_SIZE 10
@@ -26,10 +51,10 @@
 #define RX_TASK_STACK_SIZE 4096
 #endif
 #ifndef RX_TASK_PRIORITY
-#define RX_TASK_PRIORITY 2
+#define RX_TASK_PRIORITY 6
 #endif
-#ifndef RX_TASK_INTERVAL_MS
-#define RX_TASK_INTERVAL_MS 10
+#ifndef RX_EVENT_TIMEOUT_MS
+#define RX_EVENT_TIMEOUT_MS 100
 #endif
 // Process Task settings
 #ifndef PROCESS_TASK_STACK_SIZE
@@ -38,18 +63,70 @@
 #ifndef PROCESS_TASK_PRIORITY
 #define PROCESS_TASK_PRIORITY 5
 #endif
-#ifndef PROCESS_INTERVAL_MS
-#define PROCESS_INTERVAL_MS 15
+// Merged output settings
+#ifndef MERGE_WINDOW_US
+#define MERGE_WINDOW_US 20000
+#endif
+#ifndef MERGE_INTERVAL_MS
+#define MERGE_INTERVAL_MS 5
+#endif
+#ifndef MERGE_TASK_STACK_SIZE
+#define MERGE_TASK_STACK_SIZE 3072
+#endif
+#ifndef MERGE_TASK_PRIORITY
+#define MERGE_TASK_PRIORITY 4
+#endif
+// Latency analyzer, flags the commands whose worst case gets close to TRACK_CHANGE_TIMEOUT
+#ifndef LATENCY_WARN_MS
+#define LATENCY_WARN_MS (TRACK_CHANGE_TIMEOUT * 3 / 4)
+#endif
+// Loopback stress benchmark (BAUD_STRESS_TEST builds only)
+#ifndef STRESS_DURATION_MS
+#define STRESS_DURATION_MS 5000
+#endif
+#ifndef STRESS_TASK_STACK_SIZE
+#define STRESS_TASK_STACK_SIZE 3072
+#endif
+#ifndef STRESS_TASK_PRIORITY
+#define STRESS_TASK_PRIORITY 1
+#endif
+// Console egress settings
+#ifndef CONSOLE_BAUDRATE
+#define CONSOLE_BAUDRATE 921600
+#endif
+#ifndef CONSOLE_RING_SIZE
+#define CONSOLE_RING_SIZE 8192
+#endif
+#ifndef CONSOLE_FLUSH_MAX_BYTES
+#define CONSOLE_FLUSH_MAX_BYTES 2048
+#endif
+#ifndef CONSOLE_TX_BUFFER_SIZE
+#define CONSOLE_TX_BUFFER_SIZE 2048
+#endif
+#ifndef CONSOLE_TASK_STACK_SIZE
+#define CONSOLE_TASK_STACK_SIZE 2048
+#endif
+#ifndef CONSOLE_TASK_PRIORITY
+#define CONSOLE_TASK_PRIORITY 4
+#endif
+// Detect line sampler settings
+#ifndef DETECT_SAMPLING_FREQ_HZ
+#define DETECT_SAMPLING_FREQ_HZ 20000
+#endif
+#ifndef DETECT_CONVERSIONS_PER_PIN
+#define DETECT_CONVERSIONS_PER_PIN 200
+#endif
+#ifndef DETECT_POLL_INTERVAL_MS
+#define DETECT_POLL_INTERVAL_MS 10
 #endif
-// TX Task settings
-#ifndef TX_TASK_STACK_SIZE
-#define TX_TASK_STACK_SIZE 4096
+#ifndef DETECT_RECORD_INTERVAL_MS
+#define DETECT_RECORD_INTERVAL_MS 100
 #endif
-#ifndef TX_TASK_PRIORITY
-#define TX_TASK_PRIORITY 20
+#ifndef DETECT_TASK_STACK_SIZE
+#define DETECT_TASK_STACK_SIZE 2048
 #endif
-#ifndef TX_INTERVAL_MS
-#define TX_INTERVAL_MS 20
+#ifndef DETECT_TASK_PRIORITY
+#define DETECT_TASK_PRIORITY 3
 #endif
 // Timer Task settings
 #ifndef TIMER_TASK_STACK_SIZE
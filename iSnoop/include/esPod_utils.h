@@ -58,6 +58,24 @@ struct aapCommand
 {
     byte *payload = nullptr;
     uint32_t length = 0;
+    int64_t timestamp = 0; // esp_timer time at which the packet was received, in us
+    uint8_t channel = 0;   // Index of the snooper channel the packet was received on
+};
+
+struct stageLatency
+{
+    uint32_t count = 0;
+    uint64_t totalUs = 0;
+    uint32_t maxUs = 0;
+
+    void record(int64_t latencyUs)
+    {
+        count++;
+        totalUs += latencyUs;
+        if (latencyUs > maxUs)
+            maxUs = latencyUs;
+    }
+    uint32_t averageUs() const { return count ? totalUs / count : 0; }
 };
 
 struct TimerCallbackMessage
@@ -0,0 +1,29 @@
+#pragma once
+#include "Arduino.h"
+#include "esPod_conf.h"
+
+/// @brief Fixed pool of packet slabs shared by the RX and processing tasks of the snooper, across all its channels.
+/// All the storage lives in the object itself, so acquire() and release() never touch the heap.
+class packetPool
+{
+private:
+    byte _slabs[PACKET_POOL_SIZE][PACKET_SLAB_SIZE];
+    uint16_t _freeStack[PACKET_POOL_SIZE];
+    uint16_t _freeCount = PACKET_POOL_SIZE;
+    portMUX_TYPE _lock = portMUX_INITIALIZER_UNLOCKED;
+
+    // Counters
+    uint32_t _peakInUse = 0;
+    uint32_t _exhaustions = 0;
+
+public:
+    packetPool();
+
+    byte *acquire();
+    void release(byte *slab);
+
+    uint32_t capacity() const { return PACKET_POOL_SIZE; }
+    uint32_t inUse() const { return PACKET_POOL_SIZE - _freeCount; }
+    uint32_t peakInUse() const { return _peakInUse; }
+    uint32_t exhaustions() const { return _exhaustions; }
+};
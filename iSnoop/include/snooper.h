@@ -1,61 +1,128 @@
 #pragma once
 #include "Arduino.h"
-#include "L0x00.h"
-#include "L0x04.h"
+#include <initializer_list>
+#include <new>
+#include "driver/uart.h"
+#include "esp_timer.h"
+#include "aapCapture.h"
+#include "aapDecoder.h"
+#include "aapBaudHunter.h"
+#include "aapCommands.h"
+#include "aapLogTokens.h"
 #include "esPod_conf.h"
 #include "esPod_utils.h"
+#include "streamMerger.h"
+#include "detectSampler.h"
+#include "packetPool.h"
 
 
+class snooper;
+
+/// @brief Per-channel state of the snooper : one listened UART, its frame decoder, line rate detection and counters.
+/// Channels own no task nor queue, they are all serviced by the shared tasks of the snooper.
+struct snoopChannel
+{
+    snooper *engine;
+    uint8_t index;
+    const char *name;
+    uart_port_t uartPort;
+    QueueHandle_t uartEventQueue = NULL;
+
+    // Frame decoder, fed by the RX task only
+    aapDecoder decoder;
+
+    // Line rate detection, applied by the RX task only
+    aapBaudHunter baudHunter;
+    bool baudSwitchPending = false;
+    volatile uint32_t requestedBaudRate = 0;
+    volatile bool autobaudRequested = false;
+
+    // Counters
+    unsigned long lastActivity = 0;
+    uint32_t rxOverflows = 0;
+    stageLatency processLatency;
+    stageLatency mergeLatency;
+
+    snoopChannel(snooper *engine, uint8_t index, uart_port_t uartPort, const char *name);
+};
+
+/// @brief Snooper engine for up to SNOOPER_MAX_CHANNELS UARTs. A single RX task waits on the driver event queues of
+/// every channel through a queue set, a single processing task decodes the packets of all channels, and the records go
+/// straight to the merged output stage. Memory grows with the per-channel state only, not with tasks and queues.
 class snooper
 {
+    friend struct snoopChannel;
+
 public:
 
 
     // Metadata variables
     const char* snooperName;
-    uint8_t detectPin;
+    detectSampler *detector = nullptr;
 
 
 private:
-    // FreeRTOS Queues
+    // Channels, added before begin()
+    snoopChannel *_channels[SNOOPER_MAX_CHANNELS] = {nullptr};
+    uint8_t _channelCount = 0;
+
+    // FreeRTOS Queues : UART events of every channel, and validated packets of every channel
+    QueueSetHandle_t _uartEventSet = NULL;
     QueueHandle_t _cmdQueue;
-    QueueHandle_t _txQueue;
+
+    // Preallocated payload storage for the processing queue
+    packetPool _pool;
+
+    // Shared, time-ordered output stage
+    streamMerger &_merger;
 
 
     // FreeRTOS tasks (and methods...)
-    TaskHandle_t _rxTaskHandle;
-    TaskHandle_t _processTaskHandle;
-    TaskHandle_t _txTaskHandle;
+    TaskHandle_t _rxTaskHandle = NULL;
+    TaskHandle_t _processTaskHandle = NULL;
 
 
     static void _rxTask(void *pvParameters);
     static void _processTask(void *pvParameters);
-    static void _txTask(void *pvParameters);
 
 
+    // RX path, run by the RX task only
+    byte _rxChunk[RX_CHUNK_SIZE] = {0x00};
+    snoopChannel *_channelOf(QueueSetMemberHandle_t member);
+    void _handleUartEvent(snoopChannel &channel, const uart_event_t &event);
+    void _serviceChannel(snoopChannel &channel);
+    void _applyBaudRate(snoopChannel &channel);
+    void _resetChannel(snoopChannel &channel);
 
-    // Serial to the listening device
-    Stream &_targetSerial;
+    // Frame decoder callbacks, the context is the channel
+    static void _onFrame(void *context, const uint8_t *payload, uint32_t len);
+    static void _onDecodeError(void *context, aapDecoderError error);
 
     // Packet utilities
-    static byte _checksum(const byte *byteArray, uint32_t len);
-    void _sendPacket(const byte *byteArray, uint32_t len);
-    void _queuePacket(const byte *byteArray, uint32_t len);
-    void _processPacket(const byte *byteArray, uint32_t len);
-
-    bool _rxIncomplete = false;
+    void _sendPacket(snoopChannel &channel, const byte *byteArray, uint32_t len, int64_t timestamp);
+    void _processPacket(snoopChannel &channel, const byte *byteArray, uint32_t len, int64_t timestamp);
+    void _logCommand(const snoopChannel &channel, byte lingo, const aapCommandDescriptor *command, const byte *params, uint32_t paramsLen);
+    void _logWarning(const snoopChannel &channel, aapLogToken token, std::initializer_list<uint32_t> args = {});
+    void _sendLogRecord(const snoopChannel &channel, uint16_t token, const byte *args, uint32_t argsLen);
 
 
 
 public:
-    snooper(Stream &targetSerial, const char* name);
+    snooper(const char* name, streamMerger &merger);
     ~snooper();
-    void resetState();
+    esp_err_t addChannel(uart_port_t uartPort, const char *name, uint32_t baudRate, int rxPin, int txPin);
+    esp_err_t begin();
+    void logStats();
+    void setBaudRate(uint8_t index, uint32_t baudRate);
+    void startAutobaud(uint8_t index);
+    uint8_t channelCount() const { return _channelCount; }
+    const snoopChannel &channel(uint8_t index) const { return *_channels[index]; }
+    const packetPool &pool() const { return _pool; }
 
 
     // Processors
-    void processLingo0x00(const byte *byteArray, uint32_t len);
-    void processLingo0x04(const byte *byteArray, uint32_t len);
+    void processLingo0x00(const snoopChannel &channel, const byte *byteArray, uint32_t len);
+    void processLingo0x04(const snoopChannel &channel, const byte *byteArray, uint32_t len);
 
     // // Lingo 0x00
     // void L0x00_0x00_RequestIdentify();
@@ -0,0 +1,49 @@
+#pragma once
+#include "Arduino.h"
+#include "esp_timer.h"
+#include "aapCapture.h"
+#include "aapMerger.h"
+#include "aapLatency.h"
+#include "aapCommands.h"
+#include "consoleEgress.h"
+#include "esPod_conf.h"
+
+/// @brief Merged output stage shared by every snooper channel and the detect sampler.
+/// Records from all sources are stamped on the esp_timer clock and released to the console in global timestamp order,
+/// once MERGE_WINDOW_US has elapsed since their timestamp. The ordered frames also feed the request->response latency analyzer.
+class streamMerger
+{
+private:
+    /// @brief What logLatency() prints of a command, small enough to copy the whole table under the lock
+    struct latencySummary
+    {
+        uint8_t lingo;
+        uint8_t cmdID;
+        uint32_t count;
+        uint32_t p50Us;
+        uint32_t p99Us;
+        uint32_t maxUs;
+        uint32_t retries;
+        uint32_t unanswered;
+    };
+
+    consoleEgress &_egress;
+    aapMerger _merger;
+    aapLatencyAnalyzer _latency;
+    SemaphoreHandle_t _lock = NULL;
+    TaskHandle_t _mergeTaskHandle = NULL;
+
+    static void _mergeTask(void *pvParameters);
+    static void _onRecord(void *context, const aapCaptureRecord &record);
+
+public:
+    streamMerger(consoleEgress &egress);
+
+    esp_err_t begin();
+    bool push(const aapCaptureRecord &record);
+    void logStats();
+    void logLatency();
+    void resetLatency();
+
+    consoleEgress &egress() { return _egress; }
+};
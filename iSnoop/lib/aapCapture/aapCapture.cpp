@@ -0,0 +1,105 @@
+#include "aapCapture.h"
+#include <string.h>
+
+/// @brief Serialises a capture record
+/// @param record Record to encode, the payload is copied
+/// @param out Destination buffer
+/// @param outSize Size of the destination buffer, AAP_CAPTURE_MAX_RECORD is always enough
+/// @return Number of bytes written, 0 if the record does not fit
+size_t aapCaptureEncode(const aapCaptureRecord &record, uint8_t *out, size_t outSize)
+{
+    size_t total = AAP_CAPTURE_OVERHEAD + record.length;
+    if (record.length > AAP_CAPTURE_MAX_PAYLOAD || total > outSize)
+        return 0;
+
+    out[0] = AAP_CAPTURE_SYNC_0;
+    out[1] = AAP_CAPTURE_SYNC_1;
+    out[2] = (uint8_t)((record.type << 4) | (record.channel & 0x0F));
+    for (int i = 0; i < 6; i++)
+        out[3 + i] = (uint8_t)(record.timestampUs >> (8 * i));
+    out[9] = (uint8_t)record.detectMilliVolts;
+    out[10] = (uint8_t)(record.detectMilliVolts >> 8);
+    out[11] = (uint8_t)record.length;
+    out[12] = (uint8_t)(record.length >> 8);
+    if (record.length > 0)
+        memcpy(&out[AAP_CAPTURE_HEADER_SIZE], record.payload, record.length);
+
+    uint8_t checksum = 0;
+    for (size_t i = 2; i < total - 1; i++)
+        checksum += out[i];
+    out[total - 1] = (uint8_t)(0x100 - checksum);
+    return total;
+}
+
+/// @brief Constructor for the capture reader
+/// @param onRecord Called for every valid record. The payload pointer is only valid during the call.
+/// @param context Opaque pointer handed back to the handler
+aapCaptureReader::aapCaptureReader(recordHandler onRecord, void *context)
+    : _onRecord(onRecord), _context(context)
+{
+}
+
+/// @brief Runs a span of captured bytes through the reader
+/// @param data Captured bytes, may contain text logs between records
+/// @param len Number of bytes
+void aapCaptureReader::feed(const uint8_t *data, size_t len)
+{
+    for (size_t i = 0; i < len; i++)
+    {
+        _buf[_cursor++] = data[i];
+        _parse();
+    }
+}
+
+/// @brief Consumes the buffered bytes as far as possible, dropping one byte at a time on a sync/checksum miss
+void aapCaptureReader::_parse()
+{
+    while (_cursor > 0)
+    {
+        // Hunt for the sync bytes
+        if (_buf[0] != AAP_CAPTURE_SYNC_0 || (_cursor > 1 && _buf[1] != AAP_CAPTURE_SYNC_1))
+        {
+            _skippedBytes++;
+            memmove(_buf, _buf + 1, --_cursor);
+            continue;
+        }
+        if (_cursor < AAP_CAPTURE_HEADER_SIZE)
+            return;
+
+        uint16_t length = (uint16_t)(_buf[11] | (_buf[12] << 8));
+        if (length > AAP_CAPTURE_MAX_PAYLOAD)
+        {
+            _skippedBytes++;
+            memmove(_buf, _buf + 1, --_cursor);
+            continue;
+        }
+        uint32_t total = AAP_CAPTURE_OVERHEAD + length;
+        if (_cursor < total)
+            return;
+
+        uint8_t checksum = 0;
+        for (uint32_t i = 2; i < total; i++)
+            checksum += _buf[i];
+        if (checksum != 0)
+        {
+            _skippedBytes++;
+            memmove(_buf, _buf + 1, --_cursor);
+            continue;
+        }
+
+        aapCaptureRecord record;
+        record.type = _buf[2] >> 4;
+        record.channel = _buf[2] & 0x0F;
+        record.timestampUs = 0;
+        for (int i = 0; i < 6; i++)
+            record.timestampUs |= (uint64_t)_buf[3 + i] << (8 * i);
+        record.detectMilliVolts = (uint16_t)(_buf[9] | (_buf[10] << 8));
+        record.length = length;
+        record.payload = &_buf[AAP_CAPTURE_HEADER_SIZE];
+        _records++;
+        _onRecord(_context, record);
+
+        _cursor -= total;
+        memmove(_buf, _buf + total, _cursor);
+    }
+}
@@ -0,0 +1,60 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+// Record layout, all multi-byte fields little-endian :
+// 0xA5 0x5A | Type<<4 | Channel | Timestamp us (48 bits) | Detect mV (16 bits) | Length (16 bits) | Payload | Checksum
+// The checksum covers everything after the sync bytes, so text logs interleaved on the console are skipped by readers.
+#define AAP_CAPTURE_SYNC_0 0xA5
+#define AAP_CAPTURE_SYNC_1 0x5A
+#define AAP_CAPTURE_HEADER_SIZE 13
+#define AAP_CAPTURE_OVERHEAD (AAP_CAPTURE_HEADER_SIZE + 1)
+#ifndef AAP_CAPTURE_MAX_PAYLOAD
+#define AAP_CAPTURE_MAX_PAYLOAD 255
+#endif
+#define AAP_CAPTURE_MAX_RECORD (AAP_CAPTURE_OVERHEAD + AAP_CAPTURE_MAX_PAYLOAD)
+
+enum aapCaptureType : uint8_t
+{
+    AAP_CAPTURE_FRAME = 0x01, // Checksum-validated AAP payload, starting at the Lingo byte
+    AAP_CAPTURE_DETECT = 0x02, // Detect line window : Min mV (16 bits) | Max mV (16 bits)
+    AAP_CAPTURE_LOG = 0x03     // Tokenized log : Token (16 bits) | Arguments, expanded by aapExpandLog
+};
+
+struct aapCaptureRecord
+{
+    uint8_t type = AAP_CAPTURE_FRAME;
+    uint8_t channel = 0;        // 0-15, the snooper uses the UART number of the channel
+    uint64_t timestampUs = 0;   // Only the lower 48 bits are stored
+    uint16_t detectMilliVolts = 0;
+    uint16_t length = 0;
+    const uint8_t *payload = nullptr;
+};
+
+size_t aapCaptureEncode(const aapCaptureRecord &record, uint8_t *out, size_t outSize);
+
+/// @brief Incremental reader of a capture byte stream. Anything that is not a valid record is skipped.
+class aapCaptureReader
+{
+public:
+    typedef void (*recordHandler)(void *context, const aapCaptureRecord &record);
+
+private:
+    recordHandler _onRecord;
+    void *_context;
+
+    uint8_t _buf[AAP_CAPTURE_MAX_RECORD];
+    uint32_t _cursor = 0;
+    uint32_t _skippedBytes = 0;
+    uint32_t _records = 0;
+
+    void _parse();
+
+public:
+    aapCaptureReader(recordHandler onRecord, void *context);
+
+    void feed(const uint8_t *data, size_t len);
+
+    uint32_t records() const { return _records; }
+    uint32_t skippedBytes() const { return _skippedBytes; }
+};
@@ -0,0 +1,83 @@
+#include "aapBaudHunter.h"
+
+/// @brief Constructor for the baud hunter
+/// @param candidates Rates to try, in order of preference
+/// @param count Number of candidates, at most AAP_BAUD_MAX_CANDIDATES
+aapBaudHunter::aapBaudHunter(const uint32_t *candidates, uint8_t count)
+{
+    if (count > AAP_BAUD_MAX_CANDIDATES)
+        count = AAP_BAUD_MAX_CANDIDATES;
+    for (uint8_t i = 0; i < count; i++)
+        _candidates[i] = candidates[i];
+    _count = count;
+}
+
+/// @brief (Re)starts hunting from a given rate
+/// @param baudRate First rate to try. If it is not a candidate, hunting starts from the first candidate.
+/// @return Rate the caller must apply on the line
+uint32_t aapBaudHunter::start(uint32_t baudRate)
+{
+    _index = 0;
+    for (uint8_t i = 0; i < _count; i++)
+        if (_candidates[i] == baudRate)
+            _index = i;
+    _enabled = true;
+    _locked = false;
+    _framesAtRate = 0;
+    _errorsSinceFrame = 0;
+    _bytesSinceFrame = 0;
+    return _candidates[_index];
+}
+
+/// @brief Disables the detection and locks on a rate, which does not need to be a candidate
+/// @param baudRate Rate applied on the line by the caller
+void aapBaudHunter::fix(uint32_t baudRate)
+{
+    _enabled = false;
+    _locked = true;
+    _fixedRate = baudRate;
+}
+
+/// @brief Accounts for received bytes
+/// @param count Number of bytes received since the last call
+/// @return true if the caller must switch to baudRate()
+bool aapBaudHunter::onBytes(uint32_t count)
+{
+    _bytesSinceFrame += count;
+    if (_enabled && _bytesSinceFrame >= (_locked ? AAP_BAUD_UNLOCK_BYTES : AAP_BAUD_HUNT_BYTES))
+        return _next();
+    return false;
+}
+
+/// @brief Accounts for a valid frame
+/// @return Always false, a valid frame never triggers a switch
+bool aapBaudHunter::onFrame()
+{
+    _framesAtRate++;
+    _errorsSinceFrame = 0;
+    _bytesSinceFrame = 0;
+    if (!_locked && _framesAtRate >= AAP_BAUD_LOCK_FRAMES)
+        _locked = true;
+    return false;
+}
+
+/// @brief Accounts for a discarded frame or a line (framing/parity) error
+/// @return true if the caller must switch to baudRate()
+bool aapBaudHunter::onError()
+{
+    _errorsSinceFrame++;
+    if (_enabled && _errorsSinceFrame >= (_locked ? AAP_BAUD_UNLOCK_ERRORS : AAP_BAUD_HUNT_ERRORS))
+        return _next();
+    return false;
+}
+
+bool aapBaudHunter::_next()
+{
+    _index = (_index + 1) % _count;
+    _locked = false;
+    _framesAtRate = 0;
+    _errorsSinceFrame = 0;
+    _bytesSinceFrame = 0;
+    _switches++;
+    return _count > 1;
+}
@@ -0,0 +1,60 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+#ifndef AAP_BAUD_MAX_CANDIDATES
+#define AAP_BAUD_MAX_CANDIDATES 8
+#endif
+// Frames needed to lock on a rate, and evidence needed to give up on it while hunting / once locked
+#ifndef AAP_BAUD_LOCK_FRAMES
+#define AAP_BAUD_LOCK_FRAMES 2
+#endif
+#ifndef AAP_BAUD_HUNT_ERRORS
+#define AAP_BAUD_HUNT_ERRORS 16
+#endif
+#ifndef AAP_BAUD_HUNT_BYTES
+#define AAP_BAUD_HUNT_BYTES 300
+#endif
+#ifndef AAP_BAUD_UNLOCK_ERRORS
+#define AAP_BAUD_UNLOCK_ERRORS 32
+#endif
+#ifndef AAP_BAUD_UNLOCK_BYTES
+#define AAP_BAUD_UNLOCK_BYTES 2048
+#endif
+
+/// @brief Line rate detection from the decoder verdicts. At the wrong rate, the 0xFF 0x55 sync pattern
+/// never shows up with a valid checksum, while line errors and unframed bytes pile up.
+/// The hunter cycles through the candidate rates until AAP_BAUD_LOCK_FRAMES valid frames are seen,
+/// and starts hunting again if a locked rate stops producing valid frames.
+/// The caller applies the rate on the UART whenever a method returns true.
+class aapBaudHunter
+{
+private:
+    uint32_t _candidates[AAP_BAUD_MAX_CANDIDATES];
+    uint8_t _count = 0;
+    uint8_t _index = 0;
+    bool _locked = false;
+    bool _enabled = true;
+    uint32_t _fixedRate = 0;
+    uint32_t _framesAtRate = 0;
+    uint32_t _errorsSinceFrame = 0;
+    uint32_t _bytesSinceFrame = 0;
+    uint32_t _switches = 0;
+
+    bool _next();
+
+public:
+    aapBaudHunter(const uint32_t *candidates, uint8_t count);
+
+    uint32_t start(uint32_t baudRate);
+    void fix(uint32_t baudRate);
+
+    bool onBytes(uint32_t count);
+    bool onFrame();
+    bool onError();
+
+    uint32_t baudRate() const { return _enabled ? _candidates[_index] : _fixedRate; }
+    bool enabled() const { return _enabled; }
+    bool locked() const { return _locked; }
+    uint32_t switches() const { return _switches; }
+};
@@ -0,0 +1,120 @@
+#include "aapDecoder.h"
+
+/// @brief Constructor for the streaming decoder
+/// @param onFrame Called for every payload that passes the checksum. The payload pointer is only valid during the call.
+/// @param onError Called for every discarded frame, can be nullptr
+/// @param context Opaque pointer handed back to both handlers
+/// @param interbyteTimeoutMs Maximum silence inside a frame before it is discarded by checkTimeout()
+aapDecoder::aapDecoder(frameHandler onFrame, errorHandler onError, void *context, uint32_t interbyteTimeoutMs)
+    : _onFrame(onFrame), _onError(onError), _context(context), _interbyteTimeoutMs(interbyteTimeoutMs)
+{
+}
+
+/// @brief Calculates the checksum of a payload, the length byte being implicit
+/// @param payload Array from Lingo byte to last parameter byte
+/// @param len Length of the payload
+/// @return Calculated checksum for comparison
+uint8_t aapDecoder::checksum(const uint8_t *payload, uint32_t len)
+{
+    uint32_t tempChecksum = len;
+    for (uint32_t i = 0; i < len; i++)
+    {
+        tempChecksum += payload[i];
+    }
+    tempChecksum = 0x100 - (tempChecksum & 0xFF);
+    return (uint8_t)tempChecksum;
+}
+
+/// @brief Runs a span of received bytes through the sync/length/checksum state machine
+/// @param data Received bytes
+/// @param len Number of received bytes
+/// @param nowMs Current time in ms, used for the interbyte timeout
+void aapDecoder::feed(const uint8_t *data, size_t len, uint32_t nowMs)
+{
+    _stats.bytes += len;
+    for (size_t i = 0; i < len; i++)
+    {
+        uint8_t incByte = data[i];
+        // If we are not in the middle of a RX, and we receive a 0xFF 0x55, start sequence, reset expected length and position cursor
+        if (_prevByte == 0xFF && incByte == 0x55 && !_inFrame)
+        {
+            _lastByteMs = nowMs;
+            _inFrame = true;
+            _expLength = 0;
+            _cursor = 0;
+        }
+        else if (_inFrame)
+        {
+            _lastByteMs = nowMs;
+            if (_expLength == 0 && _cursor == 0) // First byte after 0xFF 0x55 is the length
+            {
+                _expLength = incByte;
+                if (_expLength == 0)
+                {
+                    _inFrame = false;
+                    _error(AAP_ERR_LENGTH);
+                }
+            }
+            else // Length is already received
+            {
+                _buf[_cursor++] = incByte;
+                if (_cursor == _expLength + 1) // Payload and checksum received
+                {
+                    _inFrame = false;
+                    if (checksum(_buf, _expLength) == incByte)
+                    {
+                        _stats.frames++;
+                        _onFrame(_context, _buf, _expLength);
+                    }
+                    else
+                    {
+                        _error(AAP_ERR_CHECKSUM);
+                    }
+                }
+            }
+        }
+        // Always update the previous byte
+        _prevByte = incByte;
+    }
+}
+
+/// @brief Discards the frame in progress if no byte was received for longer than the interbyte timeout
+/// @param nowMs Current time in ms
+/// @return true if a frame was discarded
+bool aapDecoder::checkTimeout(uint32_t nowMs)
+{
+    if (_inFrame && nowMs - _lastByteMs > _interbyteTimeoutMs)
+    {
+        _inFrame = false;
+        _error(AAP_ERR_TIMEOUT);
+        return true;
+    }
+    return false;
+}
+
+/// @brief Drops any frame in progress and forgets the sync history. Statistics are kept.
+void aapDecoder::reset()
+{
+    _inFrame = false;
+    _prevByte = 0x00;
+    _expLength = 0;
+    _cursor = 0;
+}
+
+void aapDecoder::_error(aapDecoderError error)
+{
+    switch (error)
+    {
+    case AAP_ERR_LENGTH:
+        _stats.lengthErrors++;
+        break;
+    case AAP_ERR_CHECKSUM:
+        _stats.checksumErrors++;
+        break;
+    case AAP_ERR_TIMEOUT:
+        _stats.timeouts++;
+        break;
+    }
+    if (_onError != nullptr)
+        _onError(_context, error);
+}
@@ -0,0 +1,63 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+// Largest payload (Lingo + command + parameters) a small-packet frame can carry
+#ifndef AAP_MAX_PAYLOAD
+#define AAP_MAX_PAYLOAD 255
+#endif
+
+enum aapDecoderError : uint8_t
+{
+    AAP_ERR_LENGTH = 0x01,   // Length byte is 0 (large packet format is not supported)
+    AAP_ERR_CHECKSUM = 0x02, // Checksum mismatch
+    AAP_ERR_TIMEOUT = 0x03   // Frame not completed within the interbyte timeout
+};
+
+struct aapDecoderStats
+{
+    uint32_t bytes = 0;
+    uint32_t frames = 0;
+    uint32_t lengthErrors = 0;
+    uint32_t checksumErrors = 0;
+    uint32_t timeouts = 0;
+};
+
+/// @brief Platform-independent streaming decoder for 0xFF 0x55 | Length | Payload | Checksum frames.
+/// Bytes can be fed in spans of any size, validated payloads (starting at the Lingo byte) are handed to the frame handler.
+/// Time is passed in by the caller, so the decoder has no dependency on Arduino or FreeRTOS.
+class aapDecoder
+{
+public:
+    typedef void (*frameHandler)(void *context, const uint8_t *payload, uint32_t len);
+    typedef void (*errorHandler)(void *context, aapDecoderError error);
+
+private:
+    frameHandler _onFrame;
+    errorHandler _onError;
+    void *_context;
+    uint32_t _interbyteTimeoutMs;
+
+    uint8_t _buf[AAP_MAX_PAYLOAD + 1]; // Payload and checksum
+    uint8_t _prevByte = 0x00;
+    bool _inFrame = false;
+    uint32_t _expLength = 0;
+    uint32_t _cursor = 0;
+    uint32_t _lastByteMs = 0;
+
+    aapDecoderStats _stats;
+
+    void _error(aapDecoderError error);
+
+public:
+    aapDecoder(frameHandler onFrame, errorHandler onError, void *context, uint32_t interbyteTimeoutMs);
+
+    void feed(const uint8_t *data, size_t len, uint32_t nowMs);
+    bool checkTimeout(uint32_t nowMs);
+    void reset();
+
+    bool inFrame() const { return _inFrame; }
+    const aapDecoderStats &stats() const { return _stats; }
+
+    static uint8_t checksum(const uint8_t *payload, uint32_t len);
+};
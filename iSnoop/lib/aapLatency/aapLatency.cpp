@@ -0,0 +1,212 @@
+#include "aapLatency.h"
+#include "aapCommands.h"
+
+/// @brief Runs a record through the analyzer. Anything other than a frame only advances the clock.
+/// @param record Capture record, timestamps must not go backwards
+void aapLatencyAnalyzer::observe(const aapCaptureRecord &record)
+{
+    _expire(record.timestampUs);
+    if (record.type != AAP_CAPTURE_FRAME || record.length < 2)
+        return;
+
+    uint8_t lingo = record.payload[0];
+    uint8_t cmdID;
+    const uint8_t *params;
+    uint32_t paramsLen;
+    if (lingo == 0x04) // 2-byte command IDs, the first one is always 0x00
+    {
+        if (record.length < 3)
+            return;
+        cmdID = record.payload[2];
+        params = record.payload + 3;
+        paramsLen = record.length - 3;
+    }
+    else
+    {
+        cmdID = record.payload[1];
+        params = record.payload + 2;
+        paramsLen = record.length - 2;
+    }
+
+    // Which request this frame would answer, if any : the acknowledged one, or else the one this command replies to
+    uint8_t answeredID = cmdID;
+    bool isAck = false;
+    if (lingo == 0x00 && cmdID == L0x00_iPodAck && paramsLen >= 2)
+    {
+        isAck = true;
+        answeredID = params[1];
+    }
+    else if (lingo == 0x04 && cmdID == L0x04_iPodAck && paramsLen >= 3)
+    {
+        isAck = true;
+        answeredID = params[2];
+    }
+
+    pendingRequest *request = _findAnswered(lingo, answeredID, isAck, record.channel);
+    if (request != nullptr)
+    {
+        if (isAck && params[0] == iPodAck_CmdPending) // The real reply comes later
+            return;
+        aapLatencyStats *stats = _statsFor(request->lingo, request->cmdID);
+        if (stats != nullptr)
+        {
+            uint64_t latency = record.timestampUs - request->timestampUs;
+            uint32_t latencyUs = (latency > UINT32_MAX) ? UINT32_MAX : (uint32_t)latency;
+            stats->count++;
+            stats->totalUs += latencyUs;
+            if (latencyUs > stats->maxUs)
+                stats->maxUs = latencyUs;
+            stats->histogram[bucketOf(latencyUs)]++;
+        }
+        request->active = false;
+        return;
+    }
+    const aapCommandDescriptor *command = aapFindCommand(lingo, cmdID);
+    if (command != nullptr && command->reply != AAP_NO_COMMAND)
+        _addPending(lingo, cmdID, command->reply, record.channel, record.timestampUs);
+}
+
+/// @brief Clears every pending request and histogram
+void aapLatencyAnalyzer::reset()
+{
+    for (pendingRequest &request : _pending)
+        request.active = false;
+    for (uint32_t i = 0; i < _commandCount; i++)
+        _commands[i] = aapLatencyStats();
+    _commandCount = 0;
+    _untracked = 0;
+}
+
+/// @brief Histogram bucket of a latency. Values under 4 us get their own bucket, then 4 buckets per power of two.
+uint32_t aapLatencyAnalyzer::bucketOf(uint32_t latencyUs)
+{
+    if (latencyUs < 4)
+        return latencyUs;
+    uint32_t octave = 31 - __builtin_clz(latencyUs);
+    if (octave > AAP_LATENCY_OCTAVES)
+        return AAP_LATENCY_BUCKETS - 1;
+    uint32_t sub = (latencyUs >> (octave - 2)) & 0x03;
+    return 4 * (octave - 1) + sub;
+}
+
+/// @brief Largest latency that falls into a bucket
+uint32_t aapLatencyAnalyzer::bucketUpperUs(uint32_t bucket)
+{
+    if (bucket < 4)
+        return bucket;
+    uint32_t octave = bucket / 4 + 1;
+    uint32_t sub = bucket % 4;
+    uint64_t lower = (uint64_t)(4 + sub) << (octave - 2);
+    uint64_t upper = lower + (1ULL << (octave - 2)) - 1;
+    return (upper > UINT32_MAX) ? UINT32_MAX : (uint32_t)upper;
+}
+
+/// @brief Percentile of the latency of a command, rounded up to its bucket and capped by the exact maximum
+/// @param stats Stats of the command
+/// @param percent Percentile, 1 to 100
+/// @return Latency in us, 0 if the command never got a reply
+uint32_t aapLatencyAnalyzer::percentileUs(const aapLatencyStats &stats, uint32_t percent)
+{
+    if (stats.count == 0)
+        return 0;
+    uint64_t rank = ((uint64_t)stats.count * percent + 99) / 100;
+    if (rank == 0)
+        rank = 1;
+    uint64_t cumulated = 0;
+    for (uint32_t bucket = 0; bucket < AAP_LATENCY_BUCKETS; bucket++)
+    {
+        cumulated += stats.histogram[bucket];
+        if (cumulated >= rank)
+        {
+            uint32_t upper = bucketUpperUs(bucket);
+            return (upper < stats.maxUs) ? upper : stats.maxUs;
+        }
+    }
+    return stats.maxUs;
+}
+
+aapLatencyStats *aapLatencyAnalyzer::_statsFor(uint8_t lingo, uint8_t cmdID)
+{
+    for (uint32_t i = 0; i < _commandCount; i++)
+        if (_commands[i].lingo == lingo && _commands[i].cmdID == cmdID)
+            return &_commands[i];
+    if (_commandCount == AAP_LATENCY_MAX_COMMANDS)
+    {
+        _untracked++;
+        return nullptr;
+    }
+    aapLatencyStats *stats = &_commands[_commandCount++];
+    stats->lingo = lingo;
+    stats->cmdID = cmdID;
+    return stats;
+}
+
+/// @brief Finds a request pending on a channel, to spot retries
+aapLatencyAnalyzer::pendingRequest *aapLatencyAnalyzer::_findPending(uint8_t lingo, uint8_t cmdID, uint8_t channel)
+{
+    for (pendingRequest &request : _pending)
+        if (request.active && request.lingo == lingo && request.cmdID == cmdID && request.channel == channel)
+            return &request;
+    return nullptr;
+}
+
+/// @brief Finds the request of another channel that a frame answers
+/// @param cmdID Command ID the iPodAck refers to if isAck, otherwise command ID of the frame
+/// @param isAck true for an iPodAck, which may answer any request, e.g. to report a bad parameter
+aapLatencyAnalyzer::pendingRequest *aapLatencyAnalyzer::_findAnswered(uint8_t lingo, uint8_t cmdID, bool isAck, uint8_t channel)
+{
+    for (pendingRequest &request : _pending)
+        if (request.active && request.lingo == lingo && request.channel != channel &&
+            (isAck ? request.cmdID : request.reply) == cmdID)
+            return &request;
+    return nullptr;
+}
+
+void aapLatencyAnalyzer::_expire(uint64_t nowUs)
+{
+    for (pendingRequest &request : _pending)
+    {
+        if (request.active && nowUs - request.timestampUs > AAP_LATENCY_TIMEOUT_US)
+        {
+            request.active = false;
+            aapLatencyStats *stats = _statsFor(request.lingo, request.cmdID);
+            if (stats != nullptr)
+                stats->unanswered++;
+        }
+    }
+}
+
+/// @brief Registers a request. A repeated request keeps the original timestamp, the latency is what the sender waited.
+void aapLatencyAnalyzer::_addPending(uint8_t lingo, uint8_t cmdID, uint8_t reply, uint8_t channel, uint64_t timestampUs)
+{
+    if (_findPending(lingo, cmdID, channel) != nullptr)
+    {
+        aapLatencyStats *stats = _statsFor(lingo, cmdID);
+        if (stats != nullptr)
+            stats->retries++;
+        return;
+    }
+    pendingRequest *slot = nullptr;
+    for (pendingRequest &request : _pending)
+    {
+        if (!request.active)
+        {
+            slot = &request;
+            break;
+        }
+        if (slot == nullptr || request.timestampUs < slot->timestampUs)
+            slot = &request; // Recycle the oldest one if the table is full
+    }
+    if (slot->active)
+    {
+        aapLatencyStats *stats = _statsFor(slot->lingo, slot->cmdID);
+        if (stats != nullptr)
+            stats->unanswered++;
+    }
+    slot->active = true;
+    slot->lingo = lingo;
+    slot->cmdID = cmdID;
+    slot->reply = reply;
+    slot->channel = channel;
+    slot->timestampUs = timestampUs;
+}
@@ -0,0 +1,70 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include "aapCapture.h"
+
+#ifndef AAP_LATENCY_MAX_COMMANDS
+#define AAP_LATENCY_MAX_COMMANDS 32
+#endif
+#ifndef AAP_LATENCY_MAX_PENDING
+#define AAP_LATENCY_MAX_PENDING 16
+#endif
+#ifndef AAP_LATENCY_TIMEOUT_US
+#define AAP_LATENCY_TIMEOUT_US 5000000
+#endif
+// Histogram with 4 sub-buckets per power of two, i.e. within 25% of the true value, up to 2^27 us (134 s)
+#define AAP_LATENCY_OCTAVES 26
+#define AAP_LATENCY_BUCKETS (4 * AAP_LATENCY_OCTAVES)
+
+struct aapLatencyStats
+{
+    uint8_t lingo = 0;
+    uint8_t cmdID = 0;
+    uint32_t count = 0;
+    uint32_t unanswered = 0; // Expired without a reply
+    uint32_t retries = 0;    // Sent again on the same channel before the reply
+    uint64_t totalUs = 0;
+    uint32_t maxUs = 0;
+    uint32_t histogram[AAP_LATENCY_BUCKETS] = {0};
+};
+
+/// @brief Pairs requests with their replies across channels, and keeps per-command latency histograms.
+/// Feed it frame records in timestamp order, e.g. from the merged stream.
+/// Only the requests of the accessory described in aapCommands are tracked, what the iPod sends is never taken for a
+/// request. A frame answers a pending request of the other channel if it is an iPodAck of that command ID, or the
+/// reply the descriptor of the request names, in the same Lingo.
+class aapLatencyAnalyzer
+{
+private:
+    struct pendingRequest
+    {
+        bool active = false;
+        uint8_t lingo = 0;
+        uint8_t cmdID = 0;
+        uint8_t reply = 0; // Command ID of the expected reply
+        uint8_t channel = 0;
+        uint64_t timestampUs = 0;
+    };
+    pendingRequest _pending[AAP_LATENCY_MAX_PENDING];
+    aapLatencyStats _commands[AAP_LATENCY_MAX_COMMANDS];
+    uint32_t _commandCount = 0;
+    uint32_t _untracked = 0;
+
+    aapLatencyStats *_statsFor(uint8_t lingo, uint8_t cmdID);
+    pendingRequest *_findPending(uint8_t lingo, uint8_t cmdID, uint8_t channel);
+    pendingRequest *_findAnswered(uint8_t lingo, uint8_t cmdID, bool isAck, uint8_t channel);
+    void _expire(uint64_t nowUs);
+    void _addPending(uint8_t lingo, uint8_t cmdID, uint8_t reply, uint8_t channel, uint64_t timestampUs);
+
+public:
+    void observe(const aapCaptureRecord &record);
+    void reset();
+
+    uint32_t commandCount() const { return _commandCount; }
+    const aapLatencyStats &command(uint32_t index) const { return _commands[index]; }
+    uint32_t untracked() const { return _untracked; }
+
+    static uint32_t bucketOf(uint32_t latencyUs);
+    static uint32_t bucketUpperUs(uint32_t bucket);
+    static uint32_t percentileUs(const aapLatencyStats &stats, uint32_t percent);
+};
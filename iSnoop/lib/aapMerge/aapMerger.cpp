@@ -0,0 +1,134 @@
+#include "aapMerger.h"
+#include <string.h>
+
+/// @brief Constructor for the merger
+/// @param onRecord Called for every record, in timestamp order. The payload pointer is only valid during the call.
+/// @param context Opaque pointer handed back to the handler
+/// @param windowUs Reorder window, i.e. how long a record is held after its timestamp before being emitted
+aapMerger::aapMerger(recordHandler onRecord, void *context, uint32_t windowUs)
+    : _onRecord(onRecord), _context(context), _windowUs(windowUs)
+{
+    for (uint16_t i = 0; i < AAP_MERGE_CAPACITY; i++)
+        _freeSlots[i] = AAP_MERGE_CAPACITY - 1 - i;
+}
+
+/// @brief Copies a record into the merger. If the merger is full, the oldest record is emitted first to make room.
+/// @param record Record to merge, the payload is copied
+/// @return false if the record was rejected because its payload is too large
+bool aapMerger::push(const aapCaptureRecord &record)
+{
+    if (record.length > AAP_CAPTURE_MAX_PAYLOAD)
+    {
+        _stats.oversized++;
+        return false;
+    }
+    if (_freeCount == 0)
+    {
+        _stats.forced++;
+        _emitOldest();
+    }
+    uint16_t index = _freeSlots[--_freeCount];
+    slot &entry = _slots[index];
+    entry.record = record;
+    entry.sequence = _sequence++;
+    if (record.length > 0)
+        memcpy(entry.payload, record.payload, record.length);
+    entry.record.payload = entry.payload;
+
+    _heap[_depth] = index;
+    _siftUp(_depth++);
+    _stats.pushed++;
+    if (_depth > _stats.peakDepth)
+        _stats.peakDepth = _depth;
+    return true;
+}
+
+/// @brief Emits, in order, every record whose reorder window has closed
+/// @param nowUs Current time, on the same clock as the record timestamps
+/// @return Number of records emitted
+uint32_t aapMerger::drain(uint64_t nowUs)
+{
+    uint32_t emitted = 0;
+    while (_depth > 0 && _slots[_heap[0]].record.timestampUs + _windowUs <= nowUs)
+    {
+        _emitOldest();
+        emitted++;
+    }
+    return emitted;
+}
+
+/// @brief Emits every held record regardless of the reorder window
+/// @return Number of records emitted
+uint32_t aapMerger::flush()
+{
+    uint32_t emitted = 0;
+    while (_depth > 0)
+    {
+        _emitOldest();
+        emitted++;
+    }
+    return emitted;
+}
+
+/// @brief Hands the top of the heap over to the handler and frees its slot
+void aapMerger::_emitOldest()
+{
+    uint16_t index = _heap[0];
+    _heap[0] = _heap[--_depth];
+    if (_depth > 0)
+        _siftDown(0);
+
+    const aapCaptureRecord &record = _slots[index].record;
+    if (record.timestampUs < _lastEmittedUs)
+        _stats.late++;
+    else
+        _lastEmittedUs = record.timestampUs;
+    _stats.emitted++;
+    if (_onRecord != nullptr)
+        _onRecord(_context, record);
+    _freeSlots[_freeCount++] = index;
+}
+
+/// @brief Heap order : oldest timestamp first, then push order
+bool aapMerger::_before(uint16_t a, uint16_t b) const
+{
+    const slot &slotA = _slots[a];
+    const slot &slotB = _slots[b];
+    if (slotA.record.timestampUs != slotB.record.timestampUs)
+        return slotA.record.timestampUs < slotB.record.timestampUs;
+    return (int32_t)(slotA.sequence - slotB.sequence) < 0;
+}
+
+void aapMerger::_siftUp(uint16_t pos)
+{
+    while (pos > 0)
+    {
+        uint16_t parent = (pos - 1) / 2;
+        if (!_before(_heap[pos], _heap[parent]))
+            break;
+        uint16_t tmp = _heap[pos];
+        _heap[pos] = _heap[parent];
+        _heap[parent] = tmp;
+        pos = parent;
+    }
+}
+
+void aapMerger::_siftDown(uint16_t pos)
+{
+    while (true)
+    {
+        uint16_t smallest = pos;
+        uint16_t left = 2 * pos + 1;
+        uint16_t right = left + 1;
+        if (left < _depth && _before(_heap[left], _heap[smallest]))
+            smallest = left;
+        if (right < _depth && _before(_heap[right], _heap[smallest]))
+            smallest = right;
+        if (smallest == pos)
+            break;
+        uint16_t tmp = _heap[pos];
+        _heap[pos] = _heap[smallest];
+        _heap[smallest] = tmp;
+        pos = smallest;
+    }
+}
@@ -0,0 +1,64 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include "aapCapture.h"
+
+#ifndef AAP_MERGE_CAPACITY
+#define AAP_MERGE_CAPACITY 64
+#endif
+
+struct aapMergerStats
+{
+    uint32_t pushed = 0;
+    uint32_t emitted = 0;
+    uint32_t late = 0;      // Emitted after a younger record, the reorder window was too short for them
+    uint32_t forced = 0;    // Emitted before the end of their window because the merger was full
+    uint32_t oversized = 0; // Rejected, payload larger than AAP_CAPTURE_MAX_PAYLOAD
+    uint32_t peakDepth = 0;
+};
+
+/// @brief Reorders capture records coming from several sources into a single stream sorted by timestamp.
+/// Records are held for a reorder window after their timestamp, so that a record from a slower source
+/// can still be emitted before the younger records of a faster one. Records with equal timestamps keep their push order.
+class aapMerger
+{
+public:
+    typedef void (*recordHandler)(void *context, const aapCaptureRecord &record);
+
+private:
+    recordHandler _onRecord;
+    void *_context;
+    uint64_t _windowUs;
+
+    // Records are stored in fixed slots, the heap only moves slot indexes around
+    struct slot
+    {
+        aapCaptureRecord record;
+        uint32_t sequence;
+        uint8_t payload[AAP_CAPTURE_MAX_PAYLOAD];
+    };
+    slot _slots[AAP_MERGE_CAPACITY];
+    uint16_t _freeSlots[AAP_MERGE_CAPACITY];
+    uint16_t _freeCount = AAP_MERGE_CAPACITY;
+    uint16_t _heap[AAP_MERGE_CAPACITY];
+    uint16_t _depth = 0;
+    uint32_t _sequence = 0;
+    uint64_t _lastEmittedUs = 0;
+    aapMergerStats _stats;
+
+    bool _before(uint16_t a, uint16_t b) const;
+    void _siftUp(uint16_t pos);
+    void _siftDown(uint16_t pos);
+    void _emitOldest();
+
+public:
+    aapMerger(recordHandler onRecord, void *context, uint32_t windowUs);
+
+    bool push(const aapCaptureRecord &record);
+    uint32_t drain(uint64_t nowUs);
+    uint32_t flush();
+
+    uint32_t depth() const { return _depth; }
+    uint32_t windowUs() const { return (uint32_t)_windowUs; }
+    const aapMergerStats &stats() const { return _stats; }
+};
@@ -1,3 +1,6 @@
+#pragma once
+
+// Accessory requests
 #define L0x00_Identify 0x01
 #define L0x00_RequestExtendedInterfaceMode 0x03
 #define L0x00_EnterExtendedInterfaceMode 0x05
@@ -10,6 +13,17 @@
 #define L0x00_IdentifyDeviceLingoes 0x13
 #define L0x00_RetAccessoryInfo 0x28
 
+// iPod replies
+#define L0x00_RequestIdentify 0x00
+#define L0x00_iPodAck 0x02
+#define L0x00_ReturnExtendedInterfaceMode 0x04
+#define L0x00_ReturniPodName 0x08
+#define L0x00_ReturniPodSoftwareVersion 0x0A
+#define L0x00_ReturniPodSerialNum 0x0C
+#define L0x00_ReturniPodModelNum 0x0E
+#define L0x00_ReturnLingoProtocolVersion 0x10
+#define L0x00_GetAccessoryInfo 0x27
+
 // Possible values for L0x00 0x02 iPodAck
 #define iPodAck_OK 0x00
 #define iPodAck_CmdFailed 0x02
@@ -18,4 +32,4 @@
 #define iPodAck_CmdPending 0x06
 #define iPodAck_TimedOut 0x0F
 #define iPodAck_CmdUnavail 0x10
-#define iPodAck_LingoBusy 0x14
\ No newline at end of file
+#define iPodAck_LingoBusy 0x14
@@ -1,3 +1,6 @@
+#pragma once
+
+// Accessory requests
 #define L0x04_GetIndexedPlayingTrackInfo 0x0C
 #define L0x04_RequestProtocolVersion 0x12
 #define L0x04_ResetDBSelection 0x16
@@ -18,3 +21,19 @@
 #define L0x04_SetRepeat 0x31
 #define L0x04_GetNumPlayingTracks 0x35
 #define L0x04_SetCurrentPlayingTrack 0x37
+
+// iPod replies
+#define L0x04_iPodAck 0x01
+#define L0x04_ReturnIndexedPlayingTrackInfo 0x0D
+#define L0x04_ReturnProtocolVersion 0x13
+#define L0x04_ReturnNumberCategorizedDBRecords 0x19
+#define L0x04_ReturnCategorizedDatabaseRecord 0x1B
+#define L0x04_ReturnPlayStatus 0x1D
+#define L0x04_ReturnCurrentPlayingTrackIndex 0x1F
+#define L0x04_ReturnIndexedPlayingTrackTitle 0x21
+#define L0x04_ReturnIndexedPlayingTrackArtistName 0x23
+#define L0x04_ReturnIndexedPlayingTrackAlbumName 0x25
+#define L0x04_PlayStatusNotification 0x27
+#define L0x04_ReturnShuffle 0x2D
+#define L0x04_ReturnRepeat 0x30
+#define L0x04_ReturnNumPlayingTracks 0x36
@@ -0,0 +1,158 @@
+#include "aapCommands.h"
+#include <stdio.h>
+
+//-----------------------------------------------------------------------
+//|                           Local utilities                           |
+//-----------------------------------------------------------------------
+#pragma region Local utilities
+// iPod is Big-Endian
+static uint32_t readBE32(const uint8_t *bytes)
+{
+    return ((uint32_t)bytes[0] << 24) | ((uint32_t)bytes[1] << 16) | ((uint32_t)bytes[2] << 8) | bytes[3];
+}
+
+static const char *trackInfoTypeName(uint8_t type)
+{
+    switch (type)
+    {
+    case 0x00:
+        return "Duration";
+    case 0x01:
+        return "Title";
+    case 0x02:
+        return "Release date";
+    case 0x05:
+        return "Genre";
+    case 0x06:
+        return "Composer";
+    default:
+        return "Type not recognised!";
+    }
+}
+#pragma endregion
+
+//-----------------------------------------------------------------------
+//|                         Parameter decoders                          |
+//-----------------------------------------------------------------------
+#pragma region Parameter decoders
+int aapDecodeNone(const uint8_t *, uint32_t, char *out, size_t outSize)
+{
+    if (outSize > 0)
+        out[0] = '\0';
+    return 0;
+}
+
+int aapDecodeU8(const uint8_t *params, uint32_t, char *out, size_t outSize)
+{
+    return snprintf(out, outSize, " 0x%02x", params[0]);
+}
+
+int aapDecodeLingo(const uint8_t *params, uint32_t, char *out, size_t outSize)
+{
+    return snprintf(out, outSize, " for Lingo 0x%02x", params[0]);
+}
+
+int aapDecodeCategory(const uint8_t *params, uint32_t, char *out, size_t outSize)
+{
+    return snprintf(out, outSize, " category: 0x%02x", params[0]);
+}
+
+int aapDecodeIndex(const uint8_t *params, uint32_t, char *out, size_t outSize)
+{
+    return snprintf(out, outSize, " index %lu", (unsigned long)readBE32(params));
+}
+
+int aapDecodeTrackInfo(const uint8_t *params, uint32_t, char *out, size_t outSize)
+{
+    return snprintf(out, outSize, " 0x%02x for index %lu : %s", params[0], (unsigned long)readBE32(&params[1]),
+                    trackInfoTypeName(params[0]));
+}
+
+int aapDecodeDBRecords(const uint8_t *params, uint32_t, char *out, size_t outSize)
+{
+    return snprintf(out, outSize, " category: 0x%02x from %lu for %lu counts", params[0],
+                    (unsigned long)readBE32(&params[1]), (unsigned long)readBE32(&params[5]));
+}
+
+int aapDecodeAck0x00(const uint8_t *params, uint32_t len, char *out, size_t outSize)
+{
+    if (len >= 6) // Pending ack with delay
+        return snprintf(out, outSize, " 0x%02x to command 0x%02x Numfield: %lu", params[0], params[1],
+                        (unsigned long)readBE32(&params[2]));
+    return snprintf(out, outSize, " 0x%02x to command 0x%02x", params[0], params[1]);
+}
+
+int aapDecodeAck0x04(const uint8_t *params, uint32_t, char *out, size_t outSize)
+{
+    return snprintf(out, outSize, " 0x%02x to command 0x%02x%02x", params[0], params[1], params[2]);
+}
+
+int aapDecodeString(const uint8_t *params, uint32_t len, char *out, size_t outSize)
+{
+    // The string may or may not be null-terminated inside the packet
+    return snprintf(out, outSize, " \"%.*s\"", (int)len, (const char *)params);
+}
+
+int aapDecodeIndexString(const uint8_t *params, uint32_t len, char *out, size_t outSize)
+{
+    return snprintf(out, outSize, " index %lu : \"%.*s\"", (unsigned long)readBE32(params), (int)(len - 4),
+                    (const char *)&params[4]);
+}
+
+int aapDecodePlayStatus(const uint8_t *params, uint32_t, char *out, size_t outSize)
+{
+    return snprintf(out, outSize, " 0x%02x at pos. %lu / %lu ms", params[8], (unsigned long)readBE32(&params[4]),
+                    (unsigned long)readBE32(params));
+}
+
+int aapDecodeNotification(const uint8_t *params, uint32_t len, char *out, size_t outSize)
+{
+    if (len >= 5)
+        return snprintf(out, outSize, " 0x%02x Numfield: %lu", params[0], (unsigned long)readBE32(&params[1]));
+    return snprintf(out, outSize, " 0x%02x", params[0]);
+}
+
+int aapDecodeRaw(const uint8_t *params, uint32_t len, char *out, size_t outSize)
+{
+    int written = 0;
+    if (outSize > 0)
+        out[0] = '\0';
+    for (uint32_t i = 0; i < len && (size_t)written + 4 < outSize; i++)
+        written += snprintf(out + written, outSize - written, " %02x", params[i]);
+    return written;
+}
+#pragma endregion
+
+/// @brief Formats a command as "CMD 0x<ID> <Name><parameters>"
+/// @param command Descriptor of the command
+/// @param params Parameters following the command ID
+/// @param paramsLen Length of the parameters
+/// @param out Destination string
+/// @param outSize Size of the destination string
+/// @return snprintf-style length
+int aapFormatCommand(const aapCommandDescriptor *command, const uint8_t *params, uint32_t paramsLen, char *out, size_t outSize)
+{
+    int written = snprintf(out, outSize, "CMD 0x%02x %s", command->id, command->name);
+    if (written < 0 || (size_t)written >= outSize)
+        return written;
+    if (paramsLen < command->minParams)
+        return written + snprintf(out + written, outSize - written, " (truncated)");
+    return written + command->decode(params, paramsLen, out + written, outSize - written);
+}
+
+/// @brief Formats a validated packet using the command tables
+/// @param packet Packet starting at LingoID
+/// @param len Length of the packet
+/// @param out Destination string
+/// @param outSize Size of the destination string
+/// @return snprintf-style length, or -1 if the Lingo or command is unknown or the packet too short
+int aapDescribe(const uint8_t *packet, uint32_t len, char *out, size_t outSize)
+{
+    uint32_t idLen = (len > 0 && packet[0] == 0x04) ? 2 : 1; // Lingo 0x04 has two-byte command IDs
+    if (len < 1 + idLen)
+        return -1;
+    const aapCommandDescriptor *command = aapFindCommand(packet[0], packet[idLen]);
+    if (command == nullptr)
+        return -1;
+    return aapFormatCommand(command, packet + 1 + idLen, len - 1 - idLen, out, outSize);
+}
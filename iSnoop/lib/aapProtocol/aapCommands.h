@@ -0,0 +1,138 @@
+#pragma once
+#include <array>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "L0x00.h"
+#include "L0x04.h"
+
+#define AAP_NO_COMMAND 0xFF
+
+/// @brief Parameter decoder : formats the parameters following the command ID into out, snprintf style
+typedef int (*aapParamDecoder)(const uint8_t *params, uint32_t len, char *out, size_t outSize);
+
+/// @brief Static description of a command of a Lingo
+struct aapCommandDescriptor
+{
+    uint8_t id;
+    const char *name;
+    uint8_t minParams; // Parameter bytes required by the decoder
+    aapParamDecoder decode;
+    uint8_t reply; // Command answering this request of the accessory, the iPodAck of the Lingo if it is only
+                   // acknowledged, AAP_NO_COMMAND for what the iPod sends and for Identify, which gets no answer
+};
+
+#pragma region Parameter decoders
+int aapDecodeNone(const uint8_t *params, uint32_t len, char *out, size_t outSize);
+int aapDecodeU8(const uint8_t *params, uint32_t len, char *out, size_t outSize);
+int aapDecodeLingo(const uint8_t *params, uint32_t len, char *out, size_t outSize);
+int aapDecodeCategory(const uint8_t *params, uint32_t len, char *out, size_t outSize);
+int aapDecodeIndex(const uint8_t *params, uint32_t len, char *out, size_t outSize);
+int aapDecodeTrackInfo(const uint8_t *params, uint32_t len, char *out, size_t outSize);
+int aapDecodeDBRecords(const uint8_t *params, uint32_t len, char *out, size_t outSize);
+int aapDecodeAck0x00(const uint8_t *params, uint32_t len, char *out, size_t outSize);
+int aapDecodeAck0x04(const uint8_t *params, uint32_t len, char *out, size_t outSize);
+int aapDecodeString(const uint8_t *params, uint32_t len, char *out, size_t outSize);
+int aapDecodeIndexString(const uint8_t *params, uint32_t len, char *out, size_t outSize);
+int aapDecodePlayStatus(const uint8_t *params, uint32_t len, char *out, size_t outSize);
+int aapDecodeNotification(const uint8_t *params, uint32_t len, char *out, size_t outSize);
+int aapDecodeRaw(const uint8_t *params, uint32_t len, char *out, size_t outSize);
+#pragma endregion
+
+#pragma region Command tables
+inline constexpr aapCommandDescriptor aapLingo0x00Commands[] = {
+    {L0x00_RequestIdentify, "RequestIdentify", 0, aapDecodeNone, AAP_NO_COMMAND},
+    {L0x00_Identify, "Identify", 1, aapDecodeLingo, AAP_NO_COMMAND},
+    {L0x00_iPodAck, "iPodAck", 2, aapDecodeAck0x00, AAP_NO_COMMAND},
+    {L0x00_RequestExtendedInterfaceMode, "RequestExtendedInterfaceMode", 0, aapDecodeNone, L0x00_ReturnExtendedInterfaceMode},
+    {L0x00_ReturnExtendedInterfaceMode, "ReturnExtendedInterfaceMode", 1, aapDecodeU8, AAP_NO_COMMAND},
+    {L0x00_EnterExtendedInterfaceMode, "EnterExtendedInterfaceMode", 0, aapDecodeNone, L0x00_iPodAck},
+    {L0x00_ExitExtendedInterfaceMode, "ExitExtendedInterfaceMode", 0, aapDecodeNone, L0x00_iPodAck},
+    {L0x00_RequestiPodName, "RequestiPodName", 0, aapDecodeNone, L0x00_ReturniPodName},
+    {L0x00_ReturniPodName, "ReturniPodName", 0, aapDecodeString, AAP_NO_COMMAND},
+    {L0x00_RequestiPodSoftwareVersion, "RequestiPodSoftwareVersion", 0, aapDecodeNone, L0x00_ReturniPodSoftwareVersion},
+    {L0x00_ReturniPodSoftwareVersion, "ReturniPodSoftwareVersion", 0, aapDecodeRaw, AAP_NO_COMMAND},
+    {L0x00_RequestiPodSerialNum, "RequestiPodSerialNum", 0, aapDecodeNone, L0x00_ReturniPodSerialNum},
+    {L0x00_ReturniPodSerialNum, "ReturniPodSerialNum", 0, aapDecodeString, AAP_NO_COMMAND},
+    {L0x00_RequestiPodModelNum, "RequestiPodModelNum", 0, aapDecodeNone, L0x00_ReturniPodModelNum},
+    {L0x00_ReturniPodModelNum, "ReturniPodModelNum", 0, aapDecodeRaw, AAP_NO_COMMAND},
+    {L0x00_RequestLingoProtocolVersion, "RequestLingoProtocolVersion", 1, aapDecodeLingo, L0x00_ReturnLingoProtocolVersion},
+    {L0x00_ReturnLingoProtocolVersion, "ReturnLingoProtocolVersion", 0, aapDecodeRaw, AAP_NO_COMMAND},
+    {L0x00_IdentifyDeviceLingoes, "IdentifyDeviceLingoes", 0, aapDecodeRaw, L0x00_iPodAck},
+    {L0x00_GetAccessoryInfo, "GetAccessoryInfo", 1, aapDecodeU8, AAP_NO_COMMAND},
+    {L0x00_RetAccessoryInfo, "RetAccessoryInfo", 1, aapDecodeU8, AAP_NO_COMMAND},
+};
+
+inline constexpr aapCommandDescriptor aapLingo0x04Commands[] = {
+    {L0x04_iPodAck, "iPodAck", 3, aapDecodeAck0x04, AAP_NO_COMMAND},
+    {L0x04_GetIndexedPlayingTrackInfo, "GetIndexedPlayingTrackInfo", 5, aapDecodeTrackInfo, L0x04_ReturnIndexedPlayingTrackInfo},
+    {L0x04_ReturnIndexedPlayingTrackInfo, "ReturnIndexedPlayingTrackInfo", 0, aapDecodeRaw, AAP_NO_COMMAND},
+    {L0x04_RequestProtocolVersion, "RequestProtocolVersion", 0, aapDecodeNone, L0x04_ReturnProtocolVersion},
+    {L0x04_ReturnProtocolVersion, "ReturnProtocolVersion", 0, aapDecodeRaw, AAP_NO_COMMAND},
+    {L0x04_ResetDBSelection, "ResetDBSelection", 0, aapDecodeNone, L0x04_iPodAck},
+    {L0x04_SelectDBRecord, "SelectDBRecord", 0, aapDecodeRaw, L0x04_iPodAck},
+    {L0x04_GetNumberCategorizedDBRecords, "GetNumberCategorizedDBRecords", 1, aapDecodeCategory, L0x04_ReturnNumberCategorizedDBRecords},
+    {L0x04_ReturnNumberCategorizedDBRecords, "ReturnNumberCategorizedDBRecords", 4, aapDecodeIndex, AAP_NO_COMMAND},
+    {L0x04_RetrieveCategorizedDatabaseRecords, "RetrieveCategorizedDatabaseRecords", 9, aapDecodeDBRecords, L0x04_ReturnCategorizedDatabaseRecord},
+    {L0x04_ReturnCategorizedDatabaseRecord, "ReturnCategorizedDatabaseRecord", 4, aapDecodeIndexString, AAP_NO_COMMAND},
+    {L0x04_GetPlayStatus, "GetPlayStatus", 0, aapDecodeNone, L0x04_ReturnPlayStatus},
+    {L0x04_ReturnPlayStatus, "ReturnPlayStatus", 9, aapDecodePlayStatus, AAP_NO_COMMAND},
+    {L0x04_GetCurrentPlayingTrackIndex, "GetCurrentPlayingTrackIndex", 0, aapDecodeNone, L0x04_ReturnCurrentPlayingTrackIndex},
+    {L0x04_ReturnCurrentPlayingTrackIndex, "ReturnCurrentPlayingTrackIndex", 4, aapDecodeIndex, AAP_NO_COMMAND},
+    {L0x04_GetIndexedPlayingTrackTitle, "GetIndexedPlayingTrackTitle", 4, aapDecodeIndex, L0x04_ReturnIndexedPlayingTrackTitle},
+    {L0x04_ReturnIndexedPlayingTrackTitle, "ReturnIndexedPlayingTrackTitle", 0, aapDecodeString, AAP_NO_COMMAND},
+    {L0x04_GetIndexedPlayingTrackArtistName, "GetIndexedPlayingTrackArtistName", 4, aapDecodeIndex, L0x04_ReturnIndexedPlayingTrackArtistName},
+    {L0x04_ReturnIndexedPlayingTrackArtistName, "ReturnIndexedPlayingTrackArtistName", 0, aapDecodeString, AAP_NO_COMMAND},
+    {L0x04_GetIndexedPlayingTrackAlbumName, "GetIndexedPlayingTrackAlbumName", 4, aapDecodeIndex, L0x04_ReturnIndexedPlayingTrackAlbumName},
+    {L0x04_ReturnIndexedPlayingTrackAlbumName, "ReturnIndexedPlayingTrackAlbumName", 0, aapDecodeString, AAP_NO_COMMAND},
+    {L0x04_SetPlayStatusChangeNotification, "SetPlayStatusChangeNotification", 1, aapDecodeU8, L0x04_iPodAck},
+    {L0x04_PlayStatusNotification, "PlayStatusNotification", 1, aapDecodeNotification, AAP_NO_COMMAND},
+    {L0x04_PlayCurrentSelection, "PlayCurrentSelection", 4, aapDecodeIndex, L0x04_iPodAck},
+    {L0x04_PlayControl, "PlayControl", 1, aapDecodeU8, L0x04_iPodAck},
+    {L0x04_GetShuffle, "GetShuffle", 0, aapDecodeNone, L0x04_ReturnShuffle},
+    {L0x04_ReturnShuffle, "ReturnShuffle", 1, aapDecodeU8, AAP_NO_COMMAND},
+    {L0x04_SetShuffle, "SetShuffle", 1, aapDecodeU8, L0x04_iPodAck},
+    {L0x04_GetRepeat, "GetRepeat", 0, aapDecodeNone, L0x04_ReturnRepeat},
+    {L0x04_ReturnRepeat, "ReturnRepeat", 1, aapDecodeU8, AAP_NO_COMMAND},
+    {L0x04_SetRepeat, "SetRepeat", 1, aapDecodeU8, L0x04_iPodAck},
+    {L0x04_GetNumPlayingTracks, "GetNumPlayingTracks", 0, aapDecodeNone, L0x04_ReturnNumPlayingTracks},
+    {L0x04_ReturnNumPlayingTracks, "ReturnNumPlayingTracks", 4, aapDecodeIndex, AAP_NO_COMMAND},
+    {L0x04_SetCurrentPlayingTrack, "SetCurrentPlayingTrack", 4, aapDecodeIndex, L0x04_iPodAck},
+};
+
+/// @brief Builds the command ID -> table position index at compile time
+template <size_t N>
+constexpr std::array<uint8_t, 256> aapBuildIndex(const aapCommandDescriptor (&table)[N])
+{
+    static_assert(N < AAP_NO_COMMAND, "Command table too large for a byte index");
+    std::array<uint8_t, 256> index{};
+    for (size_t i = 0; i < index.size(); i++)
+        index[i] = AAP_NO_COMMAND;
+    for (size_t i = 0; i < N; i++)
+        index[table[i].id] = (uint8_t)i;
+    return index;
+}
+
+inline constexpr std::array<uint8_t, 256> aapLingo0x00Index = aapBuildIndex(aapLingo0x00Commands);
+inline constexpr std::array<uint8_t, 256> aapLingo0x04Index = aapBuildIndex(aapLingo0x04Commands);
+#pragma endregion
+
+/// @brief O(1) lookup of a command descriptor
+/// @param lingo Lingo ID, only 0x00 and 0x04 are described
+/// @param cmdID Command ID (last byte of the command for Lingo 0x04)
+/// @return The descriptor, or nullptr if the command is unknown
+inline const aapCommandDescriptor *aapFindCommand(uint8_t lingo, uint8_t cmdID)
+{
+    switch (lingo)
+    {
+    case 0x00:
+        return (aapLingo0x00Index[cmdID] == AAP_NO_COMMAND) ? nullptr : &aapLingo0x00Commands[aapLingo0x00Index[cmdID]];
+    case 0x04:
+        return (aapLingo0x04Index[cmdID] == AAP_NO_COMMAND) ? nullptr : &aapLingo0x04Commands[aapLingo0x04Index[cmdID]];
+    default:
+        return nullptr;
+    }
+}
+
+int aapFormatCommand(const aapCommandDescriptor *command, const uint8_t *params, uint32_t paramsLen, char *out, size_t outSize);
+int aapDescribe(const uint8_t *packet, uint32_t len, char *out, size_t outSize);
@@ -0,0 +1,34 @@
+#include "aapLogTokens.h"
+#include "aapCommands.h"
+#include <stdio.h>
+
+/// @brief Expands a tokenized log record back into text
+/// @param payload Record payload : Token (16 bits LE) followed by the arguments
+/// @param len Length of the payload
+/// @param out Destination string
+/// @param outSize Size of the destination string
+/// @return snprintf-style length, or -1 if the token is unknown
+int aapExpandLog(const uint8_t *payload, uint32_t len, char *out, size_t outSize)
+{
+    if (len < 2)
+        return -1;
+    uint16_t token = (uint16_t)(payload[0] | (payload[1] << 8));
+    const uint8_t *args = payload + 2;
+    uint32_t argsLen = len - 2;
+
+    if (token & 0x8000) // Decoded command, the arguments are the raw parameters
+    {
+        const aapCommandDescriptor *command = aapFindCommand((token >> 8) & 0x7F, token & 0xFF);
+        if (command == nullptr)
+            return -1;
+        return aapFormatCommand(command, args, argsLen, out, outSize);
+    }
+
+    if (token >= AAP_LOG_TOKEN_COUNT)
+        return -1;
+    unsigned int values[AAP_LOG_MAX_ARGS] = {0};
+    for (uint32_t i = 0; i < AAP_LOG_MAX_ARGS && (i + 1) * 4 <= argsLen; i++)
+        values[i] = (unsigned int)args[4 * i] | ((unsigned int)args[4 * i + 1] << 8) |
+                    ((unsigned int)args[4 * i + 2] << 16) | ((unsigned int)args[4 * i + 3] << 24);
+    return snprintf(out, outSize, aapLogFormats[token], values[0], values[1], values[2], values[3]);
+}
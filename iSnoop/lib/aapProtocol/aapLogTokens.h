@@ -0,0 +1,23 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+#define AAP_LOG_MAX_ARGS 4
+// Tokens with the top bit set are decoded commands : Lingo in bits 8-14, command ID in bits 0-7, raw parameters as arguments
+#define AAP_LOG_COMMAND_TOKEN(lingo, cmdID) ((uint16_t)(0x8000 | ((lingo) << 8) | (cmdID)))
+
+enum aapLogToken : uint16_t
+{
+#define AAP_LOG_TOKEN(name, format) AAP_##name,
+#include "aapLogTokens.def"
+#undef AAP_LOG_TOKEN
+    AAP_LOG_TOKEN_COUNT
+};
+
+inline constexpr const char *aapLogFormats[] = {
+#define AAP_LOG_TOKEN(name, format) format,
+#include "aapLogTokens.def"
+#undef AAP_LOG_TOKEN
+};
+
+int aapExpandLog(const uint8_t *payload, uint32_t len, char *out, size_t outSize);
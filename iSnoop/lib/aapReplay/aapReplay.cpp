@@ -0,0 +1,118 @@
+#include "aapReplay.h"
+#include "aapCommands.h"
+
+/// @brief Constructor for the replay engine
+/// @param replayOptions Speed, time base, clock and optional consumers
+/// @param interbyteTimeoutMs Decoder interbyte timeout, INTERBYTE_TIMEOUT on target
+aapReplay::aapReplay(const options &replayOptions, uint32_t interbyteTimeoutMs)
+    : _options(replayOptions), _reader(_onRecord, this), _decoder(_onFrame, _onDecodeError, this, interbyteTimeoutMs)
+{
+}
+
+/// @brief Replays a span of capture bytes. Paced replays return once the last complete record is due.
+/// @param data Capture bytes, may contain text logs between records
+/// @param len Number of bytes
+void aapReplay::feed(const uint8_t *data, size_t len)
+{
+    uint64_t start = _options.nowUs();
+    _reader.feed(data, len);
+    _stats.wallUs += _options.nowUs() - start;
+}
+
+/// @brief Capture reader callback, paces the record then rebuilds the wire frame and runs it through the decoder
+/// @param context aapReplay instance
+/// @param record Record read from the capture
+void aapReplay::_onRecord(void *context, const aapCaptureRecord &record)
+{
+    aapReplay *replay = static_cast<aapReplay *>(context);
+    replay->_stats.records++;
+    replay->_pace(record.timestampUs);
+    replay->_channel = record.channel;
+    replay->_timestampUs = record.timestampUs;
+
+    if (record.type != AAP_CAPTURE_FRAME)
+    {
+        if (replay->_options.analyzer != nullptr) // Still advances the analyzer clock
+            replay->_options.analyzer->observe(record);
+        return;
+    }
+
+    uint8_t frame[3 + AAP_CAPTURE_MAX_PAYLOAD + 1] = {0xFF, 0x55, (uint8_t)record.length};
+    for (uint32_t i = 0; i < record.length; i++)
+        frame[3 + i] = record.payload[i];
+    frame[3 + record.length] = aapDecoder::checksum(record.payload, record.length);
+
+    uint64_t elapsedUs = replay->_options.virtualTime ? record.timestampUs - replay->_firstCaptureUs
+                                                      : replay->_options.nowUs() - replay->_firstWallUs;
+    uint32_t nowMs = (uint32_t)(elapsedUs / 1000);
+    // The later stages run inside feed() and are accounted by _onFrame
+    uint64_t laterStagesUs = replay->_stats.processUs + replay->_stats.handlerUs;
+    uint64_t start = replay->_options.nowUs();
+    replay->_decoder.checkTimeout(nowMs);
+    replay->_decoder.feed(frame, 3 + record.length + 1, nowMs);
+    uint64_t elapsed = replay->_options.nowUs() - start;
+    replay->_stats.decodeUs += elapsed - (replay->_stats.processUs + replay->_stats.handlerUs - laterStagesUs);
+}
+
+/// @brief Decoder callback, runs the command tables (processLingo0x00/0x04 on target), the analyzer, then the frame handler
+void aapReplay::_onFrame(void *context, const uint8_t *payload, uint32_t len)
+{
+    aapReplay *replay = static_cast<aapReplay *>(context);
+    replay->_stats.frames++;
+
+    uint64_t start = replay->_options.nowUs();
+    char description[256];
+    if (aapDescribe(payload, len, description, sizeof(description)) >= 0)
+        replay->_stats.described++;
+    else
+        replay->_stats.unknown++;
+    if (replay->_options.analyzer != nullptr)
+    {
+        aapCaptureRecord record;
+        record.channel = replay->_channel;
+        record.timestampUs = replay->_timestampUs;
+        record.length = (uint16_t)len;
+        record.payload = payload;
+        replay->_options.analyzer->observe(record);
+    }
+    uint64_t processed = replay->_options.nowUs();
+    replay->_stats.processUs += processed - start;
+
+    if (replay->_options.onFrame != nullptr)
+    {
+        replay->_options.onFrame(replay->_options.context, replay->_channel, replay->_timestampUs, payload, len);
+        replay->_stats.handlerUs += replay->_options.nowUs() - processed;
+    }
+}
+
+/// @brief Counts decoding errors. The decoder keeps its own counts by kind.
+void aapReplay::_onDecodeError(void *context, aapDecoderError)
+{
+    static_cast<aapReplay *>(context)->_stats.decodeErrors++;
+}
+
+/// @brief Waits until a record is due at the requested speed. Records with a timestamp going backwards are not delayed.
+void aapReplay::_pace(uint64_t timestampUs)
+{
+    if (!_started)
+    {
+        _started = true;
+        _firstCaptureUs = timestampUs;
+        _firstWallUs = _options.nowUs();
+    }
+    if (timestampUs > _firstCaptureUs && timestampUs - _firstCaptureUs > _stats.captureSpanUs)
+        _stats.captureSpanUs = timestampUs - _firstCaptureUs;
+    if (_options.speed == 0 || timestampUs < _firstCaptureUs)
+        return;
+
+    uint64_t dueUs = _firstWallUs + (timestampUs - _firstCaptureUs) / _options.speed;
+    uint64_t now = _options.nowUs();
+    if (dueUs > now)
+    {
+        if (_options.sleepUs != nullptr)
+            _options.sleepUs(dueUs - now);
+        _stats.pacingUs += _options.nowUs() - now;
+    }
+    else if (now - dueUs > _stats.maxLagUs)
+        _stats.maxLagUs = (uint32_t)(now - dueUs);
+}
@@ -0,0 +1,73 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include "aapCapture.h"
+#include "aapDecoder.h"
+#include "aapLatency.h"
+
+struct aapReplayStats
+{
+    uint32_t records = 0;
+    uint32_t frames = 0;       // Frames that went through the decoder again
+    uint32_t described = 0;    // Frames known to the command tables
+    uint32_t unknown = 0;
+    uint32_t decodeErrors = 0;
+    uint64_t captureSpanUs = 0; // First to last record timestamp
+    uint64_t wallUs = 0;        // Time spent in feed(), pacing included
+    uint64_t pacingUs = 0;      // Time spent waiting for the next record at 1x/Nx
+    uint32_t maxLagUs = 0;      // Worst delay of a record behind its paced time
+    // Per-stage time, the read stage is whatever is left of wallUs
+    uint64_t decodeUs = 0;
+    uint64_t processUs = 0;
+    uint64_t handlerUs = 0;
+
+    uint64_t readUs() const { return wallUs - pacingUs - decodeUs - processUs - handlerUs; }
+    double framesPerSecond() const { return (wallUs > 0) ? frames * 1e6 / wallUs : 0.0; }
+};
+
+/// @brief Streams a recorded capture through the same path as the snooper : frame decoder, then command tables,
+/// then the latency analyzer. Records can be replayed as fast as possible, or paced at 1x or Nx the captured rate.
+/// In virtual time, decoder timeouts follow the capture timestamps and the result does not depend on the speed.
+/// In real time, they follow the wall clock, as on the bus.
+class aapReplay
+{
+public:
+    typedef void (*frameHandler)(void *context, uint8_t channel, uint64_t timestampUs, const uint8_t *payload, uint32_t len);
+
+    struct options
+    {
+        uint32_t speed = 0;       // 0 : as fast as possible, 1 : captured rate, N : N times faster
+        bool virtualTime = true;
+        uint64_t (*nowUs)() = nullptr;           // Wall clock, required
+        void (*sleepUs)(uint64_t us) = nullptr;  // Required for paced replays
+        aapLatencyAnalyzer *analyzer = nullptr;  // Optional
+        frameHandler onFrame = nullptr;          // Optional, called last for every decoded frame
+        void *context = nullptr;
+    };
+
+private:
+    options _options;
+    aapCaptureReader _reader;
+    aapDecoder _decoder;
+    aapReplayStats _stats;
+
+    bool _started = false;
+    uint64_t _firstCaptureUs = 0;
+    uint64_t _firstWallUs = 0;
+    // Record being replayed, for the decoder callbacks
+    uint8_t _channel = 0;
+    uint64_t _timestampUs = 0;
+
+    static void _onRecord(void *context, const aapCaptureRecord &record);
+    static void _onFrame(void *context, const uint8_t *payload, uint32_t len);
+    static void _onDecodeError(void *context, aapDecoderError error);
+    void _pace(uint64_t timestampUs);
+
+public:
+    aapReplay(const options &replayOptions, uint32_t interbyteTimeoutMs);
+
+    void feed(const uint8_t *data, size_t len);
+
+    const aapReplayStats &stats() const { return _stats; }
+    uint32_t skippedBytes() const { return _reader.skippedBytes(); }
+};
@@ -0,0 +1,129 @@
+#include "baudStress.h"
+
+static const uint32_t stressRates[] = {AUTOBAUD_CANDIDATES};
+
+/// @brief Constructor for the stress benchmark
+/// @param target Snooper under test
+/// @param channel Index of the channel under test, left hunting for the line rate
+/// @param sender Index of the channel that sends, its UART TX pin must be jumpered to the RX pin of the channel under test
+/// @param egress Console, for the dropped records counter
+baudStress::baudStress(snooper &target, uint8_t channel, uint8_t sender, consoleEgress &egress)
+    : _snooper(target), _channel(channel), _sender(sender), _egress(egress)
+{
+}
+
+/// @brief Stress task, sweeps the candidate rates once and reports, then restores the rate detection of the sender and deletes itself
+/// @param pvParameters baudStress instance
+void baudStress::_stressTask(void *pvParameters)
+{
+    baudStress *stressInstance = static_cast<baudStress *>(pvParameters);
+    snooper &target = stressInstance->_snooper;
+    const snoopChannel &channel = target.channel(stressInstance->_channel);
+
+    target.startAutobaud(channel.index); // Even if the build forces the rate, the sweep is about finding it
+    for (uint32_t baudRate : stressRates)
+    {
+        target.setBaudRate(stressInstance->_sender, baudRate);
+        vTaskDelay(pdMS_TO_TICKS(2 * RX_EVENT_TIMEOUT_MS)); // Let the RX task apply it
+
+        aapDecoderStats decoderBefore = channel.decoder.stats();
+        uint32_t overflowsBefore = channel.rxOverflows;
+        uint32_t switchesBefore = channel.baudHunter.switches();
+        uint32_t exhaustionsBefore = target.pool().exhaustions();
+        uint32_t consoleDropsBefore = stressInstance->_egress.droppedRecords();
+
+        relockStats relock;
+        uint32_t sent = stressInstance->_sendFor(STRESS_DURATION_MS, baudRate, relock);
+        vTaskDelay(pdMS_TO_TICKS(500)); // Let the pipeline drain
+
+        const aapDecoderStats &decoderAfter = channel.decoder.stats();
+        uint32_t decoded = decoderAfter.frames - decoderBefore.frames;
+        ESP_LOGI(channel.name, "%6lu baud : sent %lu, decoded %lu, dropped %ld, decode errors %lu, RX overflows %lu, pool exhaustions %lu, console drops %lu",
+                 baudRate, sent, decoded, (long)(sent - decoded),
+                 (decoderAfter.lengthErrors + decoderAfter.checksumErrors + decoderAfter.timeouts) -
+                     (decoderBefore.lengthErrors + decoderBefore.checksumErrors + decoderBefore.timeouts),
+                 channel.rxOverflows - overflowsBefore, target.pool().exhaustions() - exhaustionsBefore,
+                 stressInstance->_egress.droppedRecords() - consoleDropsBefore);
+        if (relock.relocked)
+            ESP_LOGI(channel.name, "%6lu baud : relocked in %lu ms after %lu rate switches, dropped %ld while relocking, %ld after",
+                     baudRate, relock.ms, channel.baudHunter.switches() - switchesBefore, (long)(relock.sent - relock.decoded),
+                     (long)((sent - relock.sent) - (decoded - relock.decoded)));
+        else
+            ESP_LOGW(channel.name, "%6lu baud : never relocked, %lu rate switches, now %s at %lu baud",
+                     baudRate, channel.baudHunter.switches() - switchesBefore,
+                     channel.baudHunter.locked() ? "locked" : "hunting", channel.baudHunter.baudRate());
+    }
+    target.startAutobaud(stressInstance->_sender);
+    ESP_LOGI(channel.name, "Stress benchmark done");
+    stressInstance->_stressTaskHandle = NULL;
+    vTaskDelete(NULL);
+}
+
+/// @brief Sends a mix of short, medium and long frames back-to-back on the UART of the sender, and notes when the
+/// channel under test locks on the rate of the sender
+/// @param durationMs How long to send for
+/// @param baudRate Rate of the sender
+/// @param relock Filled in at the lock, left as is if the channel under test never locks
+/// @return Number of frames sent
+uint32_t baudStress::_sendFor(uint32_t durationMs, uint32_t baudRate, relockStats &relock)
+{
+    static const byte getPlayStatus[] = {0x04, 0x00, 0x1C};
+    static const byte returnPlayStatus[] = {0x04, 0x00, 0x1D, 0x00, 0x00, 0x10, 0x00, 0x00, 0x03, 0x00, 0x00, 0x01};
+    byte returnTitle[3 + 64] = {0x04, 0x00, 0x21};
+    for (uint32_t i = 3; i < sizeof(returnTitle) - 1; i++)
+        returnTitle[i] = 'a' + (i % 26);
+    returnTitle[sizeof(returnTitle) - 1] = 0x00;
+    const byte *payloads[] = {getPlayStatus, returnPlayStatus, returnTitle};
+    const uint32_t lengths[] = {sizeof(getPlayStatus), sizeof(returnPlayStatus), sizeof(returnTitle)};
+
+    byte frame[3 + AAP_MAX_PAYLOAD + 1] = {0xFF, 0x55};
+    uart_port_t uartPort = _snooper.channel(_sender).uartPort;
+    const snoopChannel &channel = _snooper.channel(_channel);
+    uint32_t framesBefore = channel.decoder.stats().frames;
+    uint32_t sent = 0;
+    unsigned long start = millis();
+    while (millis() - start < durationMs)
+    {
+        const byte *payload = payloads[sent % 3];
+        uint32_t len = lengths[sent % 3];
+        frame[2] = (byte)len;
+        memcpy(&frame[3], payload, len);
+        frame[3 + len] = aapDecoder::checksum(payload, len);
+        // Without a TX ring buffer, this returns once the frame is in the hardware FIFO, so frames go out back-to-back
+        if (uart_write_bytes(uartPort, (const char *)frame, 3 + len + 1) > 0)
+            sent++;
+        // Read from another task, a frame late at worst
+        if (!relock.relocked && channel.baudHunter.locked() && channel.baudHunter.baudRate() == baudRate)
+        {
+            relock.relocked = true;
+            relock.ms = millis() - start;
+            relock.sent = sent;
+            relock.decoded = channel.decoder.stats().frames - framesBefore;
+        }
+    }
+    uart_wait_tx_done(uartPort, pdMS_TO_TICKS(1000));
+    return sent;
+}
+
+/// @brief Starts the sweep in the background
+/// @return ESP_OK if the stress task was created, ESP_FAIL otherwise, e.g. if a channel was never added
+esp_err_t baudStress::begin()
+{
+    if (_channel >= _snooper.channelCount() || _sender >= _snooper.channelCount())
+    {
+        ESP_LOGE(__func__, "No channel %u to stress from channel %u, %u added", _channel, _sender, _snooper.channelCount());
+        return ESP_FAIL;
+    }
+    if (_sender == _channel)
+    {
+        ESP_LOGE(__func__, "Channel %u cannot send to itself, its rate would not be detected", _channel);
+        return ESP_FAIL;
+    }
+    xTaskCreatePinnedToCore(_stressTask, "Stress Task", STRESS_TASK_STACK_SIZE, this, STRESS_TASK_PRIORITY, &_stressTaskHandle, 0);
+    if (_stressTaskHandle == NULL)
+    {
+        ESP_LOGE(__func__, "Could not create stress task");
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
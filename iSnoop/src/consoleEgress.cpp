@@ -0,0 +1,76 @@
+#include "consoleEgress.h"
+
+/// @brief Flush task, waits for data in the ring buffer and writes everything contiguous in one go
+/// @param pvParameters consoleEgress instance
+void consoleEgress::_flushTask(void *pvParameters)
+{
+    consoleEgress *egressInstance = static_cast<consoleEgress *>(pvParameters);
+    size_t itemSize = 0;
+
+    while (true)
+    {
+        // While Serial.write() blocks on the UART, the ring keeps filling up, so the next receive returns a bigger batch
+        byte *item = (byte *)xRingbufferReceiveUpTo(egressInstance->_ring, &itemSize, portMAX_DELAY, CONSOLE_FLUSH_MAX_BYTES);
+        if (item != nullptr)
+        {
+            uint32_t backlog = egressInstance->backlog();
+            if (backlog > egressInstance->_peakBacklog)
+                egressInstance->_peakBacklog = backlog;
+            Serial.write(item, itemSize);
+            vRingbufferReturnItem(egressInstance->_ring, item);
+            egressInstance->_writes++;
+            egressInstance->_bytesWritten += itemSize;
+        }
+    }
+}
+
+/// @brief Starts the console at the requested baud rate, creates the ring buffer and the flush task
+/// @param baudRate Console baud rate, the CP2102 handles up to 921600 and the CP2102N up to 3 Mbaud
+/// @return ESP_OK if the ring buffer and the task were created, ESP_FAIL otherwise
+esp_err_t consoleEgress::begin(uint32_t baudRate)
+{
+    Serial.setTxBufferSize(CONSOLE_TX_BUFFER_SIZE);
+    Serial.begin(baudRate);
+
+    _ring = xRingbufferCreate(CONSOLE_RING_SIZE, RINGBUF_TYPE_BYTEBUF);
+    if (_ring == NULL)
+    {
+        ESP_LOGE(__func__, "Could not create console ring buffer");
+        return ESP_FAIL;
+    }
+    xTaskCreatePinnedToCore(_flushTask, "Console Task", CONSOLE_TASK_STACK_SIZE, this, CONSOLE_TASK_PRIORITY, &_flushTaskHandle, 1);
+    if (_flushTaskHandle == NULL)
+    {
+        ESP_LOGE(__func__, "Could not create console task");
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+/// @brief Appends a complete record to the ring buffer without blocking. Records are never split.
+/// @param data Record to append
+/// @param len Length of the record
+/// @return true if the record was buffered, false if it was dropped
+bool consoleEgress::push(const byte *data, size_t len)
+{
+    if (_ring != NULL && xRingbufferSend(_ring, data, len, 0) == pdTRUE)
+        return true;
+    _droppedBytes += len;
+    _droppedRecords++;
+    return false;
+}
+
+/// @brief Number of bytes waiting in the ring buffer
+uint32_t consoleEgress::backlog() const
+{
+    if (_ring == NULL)
+        return 0;
+    return CONSOLE_RING_SIZE - xRingbufferGetCurFreeSize(_ring);
+}
+
+/// @brief Logs the backlog and drop counters of the console
+void consoleEgress::logStats()
+{
+    ESP_LOGI("CONSOLE", "Backlog %lu B (peak %lu/%d B), %lu writes, %llu B written, dropped %lu records / %lu B",
+             backlog(), _peakBacklog, CONSOLE_RING_SIZE, _writes, _bytesWritten, _droppedRecords, _droppedBytes);
+}
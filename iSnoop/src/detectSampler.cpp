@@ -0,0 +1,97 @@
+#include "detectSampler.h"
+
+detectSampler *detectSampler::_instance = nullptr;
+
+/// @brief Constructor for the detect line sampler
+/// @param merger Output stage receiving the voltage timeline records
+detectSampler::detectSampler(streamMerger &merger)
+    : _merger(merger)
+{
+}
+
+/// @brief ADC continuous mode callback, runs in ISR context once per DETECT_CONVERSIONS_PER_PIN conversions
+void ARDUINO_ISR_ATTR detectSampler::_onConversionDone()
+{
+    BaseType_t higherPriorityTaskWoken = pdFALSE;
+    if (_instance != nullptr && _instance->_sampleTaskHandle != NULL)
+        vTaskNotifyGiveFromISR(_instance->_sampleTaskHandle, &higherPriorityTaskWoken);
+    portYIELD_FROM_ISR(higherPriorityTaskWoken);
+}
+
+/// @brief Sample task, collects the averaged ADC frames (or polls the pin) and emits the min/max windows
+/// @param pvParameters detectSampler instance
+void detectSampler::_sampleTask(void *pvParameters)
+{
+    detectSampler *samplerInstance = static_cast<detectSampler *>(pvParameters);
+    adc_continuous_data_t *result = nullptr;
+    unsigned long lastWindow = millis();
+
+    while (true)
+    {
+        if (samplerInstance->_continuous)
+        {
+            if (ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(DETECT_RECORD_INTERVAL_MS)) > 0 && analogContinuousRead(&result, 0))
+                samplerInstance->_record(result[0].avg_read_mvolts);
+        }
+        else
+        {
+            vTaskDelay(pdMS_TO_TICKS(DETECT_POLL_INTERVAL_MS));
+            samplerInstance->_record(analogReadMilliVolts(samplerInstance->_pin));
+        }
+
+        if (DETECT_RECORD_INTERVAL_MS > 0 && millis() - lastWindow >= DETECT_RECORD_INTERVAL_MS)
+        {
+            lastWindow = millis();
+            samplerInstance->_emitWindow();
+        }
+    }
+}
+
+/// @brief Starts sampling the detect pin in the background
+/// @param pin GPIO of the detect line
+/// @return ESP_OK if the sample task was created, ESP_FAIL otherwise
+esp_err_t detectSampler::begin(uint8_t pin)
+{
+    _pin = pin;
+    _instance = this;
+
+    // Continuous mode is only available on ADC1 pins. Conversions completed before the task exists are simply ignored.
+    const uint8_t pins[] = {pin};
+    _continuous = analogContinuous(pins, 1, DETECT_CONVERSIONS_PER_PIN, DETECT_SAMPLING_FREQ_HZ, &_onConversionDone) &&
+                  analogContinuousStart();
+    ESP_LOGI(__func__, "Detect pin %d sampled in %s mode", pin, _continuous ? "continuous" : "one-shot");
+
+    xTaskCreatePinnedToCore(_sampleTask, "Detect Task", DETECT_TASK_STACK_SIZE, this, DETECT_TASK_PRIORITY, &_sampleTaskHandle, 1);
+    if (_sampleTaskHandle == NULL)
+    {
+        ESP_LOGE(__func__, "Could not create detect task");
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+void detectSampler::_record(uint16_t milliVolts)
+{
+    _latestMilliVolts = milliVolts;
+    if (milliVolts < _windowMin)
+        _windowMin = milliVolts;
+    if (milliVolts > _windowMax)
+        _windowMax = milliVolts;
+}
+
+/// @brief Pushes the min/max of the window that just closed to the console, then opens a new one
+void detectSampler::_emitWindow()
+{
+    if (_windowMin > _windowMax) // No sample in this window
+        return;
+    byte payload[4] = {(byte)_windowMin, (byte)(_windowMin >> 8), (byte)_windowMax, (byte)(_windowMax >> 8)};
+    aapCaptureRecord captureRecord;
+    captureRecord.type = AAP_CAPTURE_DETECT;
+    captureRecord.timestampUs = (uint64_t)esp_timer_get_time();
+    captureRecord.detectMilliVolts = _latestMilliVolts;
+    captureRecord.length = sizeof(payload);
+    captureRecord.payload = payload;
+    _merger.push(captureRecord);
+    _windowMin = UINT16_MAX;
+    _windowMax = 0;
+}
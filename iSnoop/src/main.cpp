@@ -1,9 +1,10 @@
 #include <Arduino.h>
 
 #include "snooper.h"
-
-HardwareSerial RXUart_1(1);
-HardwareSerial RXUart_2(2);
+#include "telemetry.h"
+#ifdef BAUD_STRESS_TEST
+#include "baudStress.h"
+#endif
 
 #ifndef UART1_RX
 #define UART1_RX 18
@@ -22,8 +23,14 @@ HardwareSerial RXUart_2(2);
 #endif
 
 // snooper espod(ipodSerial);
-snooper UART1(RXUart_1, "UART1");
-snooper UART2(RXUart_2, "UART2");
+consoleEgress console;
+streamMerger merged(console);
+detectSampler ipodDetect(merged);
+snooper snoop("Snoop", merged);
+telemetry budget;
+#ifdef BAUD_STRESS_TEST
+baudStress UART2Stress(snoop, 1, 0, console); // UART1 sends, UART2 has to follow its rate
+#endif
 
 #ifndef IPOD_DETECT
 #define IPOD_DETECT 4
@@ -39,26 +46,57 @@ void initializeSerial();
 void setup()
 {
 	initializeSerial();
-	UART1.detectPin = IPOD_DETECT;
-	UART2.detectPin = IPOD_DETECT;
+	if (ipodDetect.begin(IPOD_DETECT) != ESP_OK)
+		ESP_LOGE("SETUP", "Detect sampler could not start");
+	snoop.detector = &ipodDetect;
+#ifdef ENABLE_TELEMETRY
+	if (budget.begin() != ESP_OK)
+		ESP_LOGE("SETUP", "Telemetry could not start");
+#endif
+#ifdef BAUD_STRESS_TEST
+	if (UART2Stress.begin() != ESP_OK)
+		ESP_LOGE("SETUP", "UART2 stress benchmark could not start");
+#endif
 	ESP_LOGI("SETUP", "Setup finished");
 }
 
 void loop()
 {
+	// Console commands : 'l' dumps the request->response latencies, 'r' resets them, 's' dumps the pipeline stats,
+	// 't' dumps the stack/heap budget
+	while (Serial.available() > 0)
+	{
+		switch (Serial.read())
+		{
+		case 'l':
+			merged.logLatency();
+			break;
+		case 'r':
+			merged.resetLatency();
+			break;
+		case 's':
+			snoop.logStats();
+			break;
+		case 't':
+			budget.report();
+			break;
+		}
+	}
+	vTaskDelay(pdMS_TO_TICKS(50));
 }
 
 
-/// @brief Sets up and starts the appropriate Serial interface
+/// @brief Sets up and starts the console, the merged output stage and the event-driven snooper with one channel per UART
 void initializeSerial()
 {
-	Serial.begin(115200);
-	RXUart_1.setPins(UART1_RX, UART1_TX);
-	RXUart_2.setPins(UART2_RX, UART2_TX);
-	RXUart_1.setRxBufferSize(1024);
-	RXUart_1.setTxBufferSize(1024);
-	RXUart_2.setRxBufferSize(1024);
-	RXUart_2.setTxBufferSize(1024);
-	RXUart_1.begin(19200);
-	RXUart_2.begin(19200);
+	if (console.begin(CONSOLE_BAUDRATE) != ESP_OK)
+		ESP_LOGE("SETUP", "Console egress could not start");
+	if (merged.begin() != ESP_OK)
+		ESP_LOGE("SETUP", "Merged output could not start");
+	if (snoop.addChannel(UART_NUM_1, "UART1", 19200, UART1_RX, UART1_TX) != ESP_OK)
+		ESP_LOGE("SETUP", "UART1 channel could not be added");
+	if (snoop.addChannel(UART_NUM_2, "UART2", 19200, UART2_RX, UART2_TX) != ESP_OK)
+		ESP_LOGE("SETUP", "UART2 channel could not be added");
+	if (snoop.begin() != ESP_OK)
+		ESP_LOGE("SETUP", "Snooper could not start");
 }
@@ -0,0 +1,47 @@
+#include "packetPool.h"
+
+/// @brief Constructor, marks every slab as free
+packetPool::packetPool()
+{
+    for (uint16_t i = 0; i < PACKET_POOL_SIZE; i++)
+    {
+        _freeStack[i] = i;
+    }
+}
+
+/// @brief Takes a slab from the free stack in O(1). Safe to call from any task.
+/// @return Pointer to a PACKET_SLAB_SIZE bytes slab, or nullptr if the pool is exhausted
+byte *packetPool::acquire()
+{
+    byte *slab = nullptr;
+    portENTER_CRITICAL(&_lock);
+    if (_freeCount > 0)
+    {
+        slab = _slabs[_freeStack[--_freeCount]];
+        if (PACKET_POOL_SIZE - _freeCount > _peakInUse)
+            _peakInUse = PACKET_POOL_SIZE - _freeCount;
+    }
+    else
+    {
+        _exhaustions++;
+    }
+    portEXIT_CRITICAL(&_lock);
+    return slab;
+}
+
+/// @brief Returns a slab to the free stack in O(1). Safe to call from any task.
+/// @param slab Pointer previously obtained from acquire(). nullptr is ignored.
+void packetPool::release(byte *slab)
+{
+    if (slab == nullptr)
+        return;
+    uint32_t index = (slab - &_slabs[0][0]) / PACKET_SLAB_SIZE;
+    if (index >= PACKET_POOL_SIZE)
+    {
+        ESP_LOGE(__func__, "Slab %p does not belong to this pool", slab);
+        return;
+    }
+    portENTER_CRITICAL(&_lock);
+    _freeStack[_freeCount++] = (uint16_t)index;
+    portEXIT_CRITICAL(&_lock);
+}
@@ -4,6 +4,10 @@
 //|                           Local utilities                           |
 //-----------------------------------------------------------------------
 #pragma region Local utilities
+static_assert(PACKET_SLAB_SIZE >= AAP_MAX_PAYLOAD, "A pool slab must hold the largest decoded payload");
+
+static const uint32_t autobaudCandidates[] = {AUTOBAUD_CANDIDATES};
+
 // ESP32 is Little-Endian, iPod is Big-Endian
 template <typename T>
 T swap_endian(T u)
@@ -30,122 +34,30 @@ T swap_endian(T u)
 //|                      Cardinal tasks and Timers                      |
 //-----------------------------------------------------------------------
 #pragma region Tasks and Timers
-/// @brief RX Task, sifts through the incoming serial data and compiles packets that pass the checksum and passes them to the processing Queue _cmdQueue. Also handles timeouts and can trigger state resets.
-/// @param pvParameters Unused
+/// @brief RX Task, waits on the UART driver event queues of every channel through the queue set and feeds the incoming serial data in bulk to the frame decoder of the channel, which passes the packets that pass the checksum to the shared processing Queue _cmdQueue. Also handles timeouts, line rate switches and reports FIFO/buffer overflows.
+/// @param pvParameters snooper instance
 void snooper::_rxTask(void *pvParameters)
 {
     snooper *snooperInstance = static_cast<snooper *>(pvParameters);
-
-    byte prevByte = 0x00;
-    byte incByte = 0x00;
-    byte buf[MAX_PACKET_SIZE] = {0x00};
-    uint32_t expLength = 0;
-    uint32_t cursor = 0;
-
-    unsigned long lastByteRX = millis();   // Last time a byte was RXed in a packet
-    unsigned long lastActivity = millis(); // Last time any RX activity was detected
-
-    aapCommand cmd;
+    uart_event_t event;
 
     while (true)
     {
+        // Block on the UART driver events of all channels, wake up periodically to check the timeouts
+        QueueSetMemberHandle_t member = xQueueSelectFromSet(snooperInstance->_uartEventSet, pdMS_TO_TICKS(RX_EVENT_TIMEOUT_MS));
+        if (member != NULL)
         {
-            // Use of while instead of if()
-            while (snooperInstance->_targetSerial.available())
-            {
-                // Timestamping the last activity on RX
-                lastActivity = millis();
-                incByte = snooperInstance->_targetSerial.read();
-                // If we are not in the middle of a RX, and we receive a 0xFF 0x55, start sequence, reset expected length and position cursor
-                if (prevByte == 0xFF && incByte == 0x55 && !snooperInstance->_rxIncomplete)
-                {
-                    lastByteRX = millis();
-                    snooperInstance->_rxIncomplete = true;
-                    expLength = 0;
-                    cursor = 0;
-                }
-                else if (snooperInstance->_rxIncomplete)
-                {
-                    // Timestamping the last byte received
-                    lastByteRX = millis();
-                    // Expected length has not been received yet
-                    if (expLength == 0 && cursor == 0)
-                    {
-                        expLength = incByte; // First byte after 0xFF 0x55
-                        if (expLength > MAX_PACKET_SIZE)
-                        {
-                            ESP_LOGW(__func__, "Expected length is too long, discarding packet");
-                            snooperInstance->_rxIncomplete = false;
-                            // TODO: Send a NACK to the Accessory
-                        }
-                        else if (expLength == 0)
-                        {
-                            ESP_LOGW(__func__, "Expected length is 0, discarding packet");
-                            snooperInstance->_rxIncomplete = false;
-                            // TODO: Send a NACK to the Accessory
-                        }
-                    }
-                    else // Length is already received
-                    {
-                        buf[cursor++] = incByte;
-                        if (cursor == expLength + 1)
-                        {
-                            // We have received the expected length + checksum
-                            snooperInstance->_rxIncomplete = false;
-                            // Check the checksum
-                            byte calcChecksum = snooper::_checksum(buf, expLength);
-                            if (calcChecksum == incByte)
-                            {
-                                // Checksum is correct, send the packet to the processing queue
-                                // Allocate memory for the payload so it doesn't become out of scope
-                                cmd.payload = new byte[expLength];
-                                cmd.length = expLength;
-                                memcpy(cmd.payload, buf, expLength);
-                                if (xQueueSend(snooperInstance->_cmdQueue, &cmd, pdMS_TO_TICKS(5)) == pdTRUE)
-                                {
-                                    ESP_LOGD(__func__, "Packet received and sent to processing queue");
-                                }
-                                else
-                                {
-                                    ESP_LOGW(__func__, "Packet received but could not be sent to processing queue. Discarding");
-                                    delete[] cmd.payload;
-                                    cmd.payload = nullptr;
-                                    cmd.length = 0;
-                                }
-                            }
-                            else // Checksum mismatch
-                            {
-                                ESP_LOGW(__func__, "Checksum mismatch, discarding packet");
-                                // TODO: Send a NACK to the Accessory
-                            }
-                        }
-                    }
-                }
-                // Always update the previous byte
-                prevByte = incByte;
-            }
-            if (snooperInstance->_rxIncomplete && millis() - lastByteRX > INTERBYTE_TIMEOUT) // If we are in the middle of a packet and we haven't received a byte in 1s, discard the packet
-            {
-                ESP_LOGW(__func__, "Packet incomplete, discarding");
-                snooperInstance->_rxIncomplete = false;
-                // cmd.payload = nullptr;
-                // cmd.length = 0;
-                // TODO: Send a NACK to the Accessory
-            }
-            if (millis() - lastActivity > SERIAL_TIMEOUT) // If we haven't received any byte in 30s, reset the RX state
-            {
-                ESP_LOGW(__func__, "No activity in %lu ms, resetting RX state", SERIAL_TIMEOUT);
-                // Reset the timestamp for next Serial timeout
-                lastActivity = millis();
-                snooperInstance->resetState();
-            }
-            vTaskDelay(pdMS_TO_TICKS(RX_TASK_INTERVAL_MS));
+            snoopChannel *channel = snooperInstance->_channelOf(member);
+            if (channel != nullptr && xQueueReceive(member, &event, 0) == pdTRUE)
+                snooperInstance->_handleUartEvent(*channel, event);
         }
+        for (uint8_t i = 0; i < snooperInstance->_channelCount; i++)
+            snooperInstance->_serviceChannel(*snooperInstance->_channels[i]);
     }
 }
 
-/// @brief Processor task retrieving from the cmdQueue and processing the commands
-/// @param pvParameters
+/// @brief Processor task, blocks on the cmdQueue and processes the commands of every channel as soon as they arrive
+/// @param pvParameters snooper instance
 void snooper::_processTask(void *pvParameters)
 {
     snooper *snooperInstance = static_cast<snooper *>(pvParameters);
@@ -154,127 +66,249 @@ void snooper::_processTask(void *pvParameters)
 
     while (true)
     {
-
-
-        if (xQueueReceive(snooperInstance->_cmdQueue, &incCmd, 0) == pdTRUE) // Non blocking receive
+        if (xQueueReceive(snooperInstance->_cmdQueue, &incCmd, portMAX_DELAY) == pdTRUE) // Blocking receive
         {
-            // Process the command
-            snooperInstance->_processPacket(incCmd.payload, incCmd.length);
-            // Free the memory allocated for the payload
-            delete[] incCmd.payload;
+            snoopChannel &channel = *snooperInstance->_channels[incCmd.channel];
+            channel.processLatency.record(esp_timer_get_time() - incCmd.timestamp);
+            // Process the command, the timestamp is carried over to the merged output
+            snooperInstance->_processPacket(channel, incCmd.payload, incCmd.length, incCmd.timestamp);
+            // Return the payload slab to the pool
+            snooperInstance->_pool.release(incCmd.payload);
             incCmd.payload = nullptr;
             incCmd.length = 0;
         }
-        vTaskDelay(pdMS_TO_TICKS(PROCESS_INTERVAL_MS));
     }
 }
 
-/// @brief Transmit task, retrieves from the txQueue and sends the packets over Serial at high priority but wider timing
-/// @param pvParameters
-void snooper::_txTask(void *pvParameters)
-{
-    snooper *snooperInstance = static_cast<snooper *>(pvParameters);
-    aapCommand txCmd;
-
+#pragma endregion
 
-    while (true)
+//-----------------------------------------------------------------------
+//|                               RX path                               |
+//-----------------------------------------------------------------------
+#pragma region RX path
+/// @brief Finds the channel owning a UART event queue
+/// @param member Queue returned by the queue set
+/// @return The channel, or nullptr if the queue is not one of ours
+snoopChannel *snooper::_channelOf(QueueSetMemberHandle_t member)
+{
+    for (uint8_t i = 0; i < _channelCount; i++)
     {
+        if (_channels[i]->uartEventQueue == member)
+            return _channels[i];
+    }
+    return nullptr;
+}
 
-        if (!snooperInstance->_rxIncomplete) //_rxTask is not in the middle of a packet
-        {
-            // Retrieve from the queue and send the packet
-            if (xQueueReceive(snooperInstance->_txQueue, &txCmd, 0) == pdTRUE)
-            {
-                // vTaskDelay(pdMS_TO_TICKS(TX_INTERVAL_MS));
-                // Send the packet
-                snooperInstance->_sendPacket(txCmd.payload, txCmd.length);
-                // Free the memory allocated for the payload
-                delete[] txCmd.payload;
-                txCmd.payload = nullptr;
-                txCmd.length = 0;
-            }
-            vTaskDelay(pdMS_TO_TICKS(TX_INTERVAL_MS));
-        }
-        else
+/// @brief Handles one UART driver event of a channel
+/// @param channel Channel the event was posted for
+/// @param event UART driver event
+void snooper::_handleUartEvent(snoopChannel &channel, const uart_event_t &event)
+{
+    switch (event.type)
+    {
+    case UART_DATA: // Data or FIFO-timeout event, drain everything buffered in chunks
+    {
+        int rxLen = 0;
+        while ((rxLen = uart_read_bytes(channel.uartPort, _rxChunk, sizeof(_rxChunk), 0)) > 0)
         {
-            vTaskDelay(pdMS_TO_TICKS(RX_TASK_INTERVAL_MS));
+            // Timestamping the last activity on RX
+            channel.lastActivity = millis();
+            channel.baudSwitchPending |= channel.baudHunter.onBytes(rxLen);
+            channel.decoder.feed(_rxChunk, rxLen, channel.lastActivity);
+            if (channel.baudSwitchPending) // The rest of the buffer was received at the wrong rate
+                break;
         }
     }
+    break;
+
+    case UART_FIFO_OVF:    // Hardware FIFO overrun, bytes were lost before reaching the driver
+    case UART_BUFFER_FULL: // Driver ring buffer full, bytes were lost
+    {
+        channel.rxOverflows++;
+        ESP_LOGW(channel.name, "RX overflow (%s), %lu so far. Flushing input",
+                 (event.type == UART_FIFO_OVF) ? "FIFO" : "ring buffer", channel.rxOverflows);
+        // The partial packet cannot be trusted anymore. The events still queued for the flushed bytes read nothing.
+        channel.decoder.reset();
+        uart_flush_input(channel.uartPort);
+    }
+    break;
+
+    case UART_FRAME_ERR:
+    case UART_PARITY_ERR:
+    {
+        // Expected while hunting for the line rate
+        if (channel.baudHunter.locked())
+            ESP_LOGW(channel.name, "RX line error (%s)", (event.type == UART_FRAME_ERR) ? "frame" : "parity");
+        channel.baudSwitchPending |= channel.baudHunter.onError();
+    }
+    break;
+
+    default:
+        break;
+    }
 }
 
+/// @brief Periodic work of a channel : requested and detected rate switches, interbyte and serial timeouts
+/// @param channel Channel to service
+void snooper::_serviceChannel(snoopChannel &channel)
+{
+    if (channel.requestedBaudRate != 0)
+    {
+        channel.baudHunter.fix(channel.requestedBaudRate);
+        channel.requestedBaudRate = 0;
+        channel.baudSwitchPending = true;
+    }
+    if (channel.autobaudRequested)
+    {
+        channel.baudHunter.start(channel.baudHunter.baudRate());
+        channel.autobaudRequested = false;
+        channel.baudSwitchPending = true;
+    }
+    if (channel.baudSwitchPending)
+        _applyBaudRate(channel);
+    // If we are in the middle of a packet and we haven't received a byte in INTERBYTE_TIMEOUT, discard the packet
+    channel.decoder.checkTimeout(millis());
+    if (millis() - channel.lastActivity > SERIAL_TIMEOUT) // If we haven't received any byte in SERIAL_TIMEOUT, reset the channel
+    {
+        ESP_LOGW(channel.name, "No activity in %lu ms, resetting RX state", SERIAL_TIMEOUT);
+        // Reset the timestamp for next Serial timeout
+        channel.lastActivity = millis();
+        _resetChannel(channel);
+    }
+}
+
+/// @brief Applies the rate selected by the baud hunter. Whatever was received at the previous rate is discarded.
+/// @param channel Channel to switch
+void snooper::_applyBaudRate(snoopChannel &channel)
+{
+    channel.baudSwitchPending = false;
+    uart_set_baudrate(channel.uartPort, channel.baudHunter.baudRate());
+    channel.decoder.reset();
+    uart_flush_input(channel.uartPort);
+    ESP_LOGD(channel.name, "Listening at %lu baud", channel.baudHunter.baudRate());
+}
+
+/// @brief Restarts a silent channel : partial packet dropped and, unless the rate was forced, line rate detection started
+/// over from the last rate, as the next accessory may not use the same one. The other channels are left untouched.
+/// @param channel Channel to reset
+void snooper::_resetChannel(snoopChannel &channel)
+{
+    channel.decoder.reset();
+    if (channel.baudHunter.enabled()) // Same rate, nothing to apply on the UART
+        channel.baudHunter.start(channel.baudHunter.baudRate());
+}
 #pragma endregion
 
 //-----------------------------------------------------------------------
 //|                          Packet management                          |
 //-----------------------------------------------------------------------
 #pragma region Packet management
-/// @brief //Calculates the checksum of a packet that starts from i=0 ->Lingo to i=len -> Checksum
-/// @param byteArray Array from Lingo byte to Checksum byte
-/// @param len Length of array (Lingo byte to Checksum byte)
-/// @return Calculated checksum for comparison
-byte snooper::_checksum(const byte *byteArray, uint32_t len)
+/// @brief Decoder callback, copies a checksum-validated packet into a pool slab and sends it to the processing queue
+/// @param context Channel the packet was received on
+/// @param payload Validated packet starting at LingoID, only valid during the call
+/// @param len Length of the packet
+void snooper::_onFrame(void *context, const uint8_t *payload, uint32_t len)
 {
-    uint32_t tempChecksum = len;
-    for (int i = 0; i < len; i++)
+    snoopChannel *channel = static_cast<snoopChannel *>(context);
+    snooper *snooperInstance = channel->engine;
+    aapCommand cmd;
+
+    bool wasLocked = channel->baudHunter.locked();
+    channel->baudHunter.onFrame();
+    if (!wasLocked && channel->baudHunter.locked())
+        ESP_LOGI(channel->name, "Line rate locked at %lu baud", channel->baudHunter.baudRate());
+
+    // Copy the payload into a pool slab so it doesn't become out of scope
+    cmd.payload = snooperInstance->_pool.acquire();
+    if (cmd.payload == nullptr)
+    {
+        snooperInstance->_logWarning(*channel, AAP_LOG_POOL_EXHAUSTED);
+        return;
+    }
+    cmd.length = len;
+    cmd.timestamp = esp_timer_get_time();
+    cmd.channel = channel->index;
+    memcpy(cmd.payload, payload, len);
+    if (xQueueSend(snooperInstance->_cmdQueue, &cmd, pdMS_TO_TICKS(5)) == pdTRUE)
+    {
+        ESP_LOGD(__func__, "Packet received and sent to processing queue");
+    }
+    else
     {
-        tempChecksum += byteArray[i];
+        snooperInstance->_logWarning(*channel, AAP_LOG_CMD_QUEUE_FULL);
+        snooperInstance->_pool.release(cmd.payload);
     }
-    tempChecksum = 0x100 - (tempChecksum & 0xFF);
-    return (byte)tempChecksum;
 }
 
-/// @brief Composes and sends a packet over to the console
-/// @param byteArray Byte array to send to the console
-/// @param len Length of the array to send
-void snooper::_sendPacket(const byte *byteArray, uint32_t len)
+/// @brief Decoder callback for discarded frames
+/// @param context Channel the frame was received on
+/// @param error Reason for discarding the frame
+void snooper::_onDecodeError(void *context, aapDecoderError error)
 {
-    Serial.printf("%s \t %d \t | ", snooperName, analogReadMilliVolts(detectPin));
-    Serial.write(byteArray, len);
-    Serial.println();
+    snoopChannel *channel = static_cast<snoopChannel *>(context);
+    snooper *snooperInstance = channel->engine;
+    channel->baudSwitchPending |= channel->baudHunter.onError();
+    switch (error)
+    {
+    case AAP_ERR_LENGTH:
+        snooperInstance->_logWarning(*channel, AAP_LOG_LENGTH_ZERO);
+        break;
+    case AAP_ERR_CHECKSUM:
+        snooperInstance->_logWarning(*channel, AAP_LOG_CHECKSUM_MISMATCH);
+        break;
+    case AAP_ERR_TIMEOUT:
+        snooperInstance->_logWarning(*channel, AAP_LOG_PACKET_INCOMPLETE);
+        break;
+    }
+    // TODO: Send a NACK to the Accessory
 }
 
-/// @brief Adds a packet to the transmit queue
-/// @param byteArray Array of bytes to add to the queue
-/// @param len Length of data in the array
-void snooper::_queuePacket(const byte *byteArray, uint32_t len)
+/// @brief Composes a capture record and hands it over to the merged output stage, which copies it
+/// @param channel Channel the packet was received on
+/// @param byteArray Packet to send to the console, starting at LingoID
+/// @param len Length of the packet
+/// @param timestamp esp_timer time at which the packet was received, in us. This is the merge order.
+void snooper::_sendPacket(snoopChannel &channel, const byte *byteArray, uint32_t len, int64_t timestamp)
 {
-    aapCommand cmdToQueue;
-    cmdToQueue.payload = new byte[len];
-    cmdToQueue.length = len;
-    memcpy(cmdToQueue.payload, byteArray, len);
-    if (xQueueSend(_txQueue, &cmdToQueue, pdMS_TO_TICKS(5)) != pdTRUE)
-    {
-        ESP_LOGW(__func__, "Could not queue packet");
-        delete[] cmdToQueue.payload;
-        cmdToQueue.payload = nullptr;
-        cmdToQueue.length = 0;
-    }
+    aapCaptureRecord captureRecord;
+    captureRecord.channel = (uint8_t)channel.uartPort;
+    captureRecord.timestampUs = (uint64_t)timestamp;
+    captureRecord.detectMilliVolts = (detector != nullptr) ? detector->latestMilliVolts() : 0;
+    captureRecord.length = len;
+    captureRecord.payload = byteArray;
+    if (!_merger.push(captureRecord))
+        ESP_LOGD(channel.name, "Record rejected by the merger");
+    channel.mergeLatency.record(esp_timer_get_time() - timestamp);
 }
 
 
 
 /// @brief Processes a valid packet and calls the relevant Lingo processor
+/// @param channel Channel the packet was received on
 /// @param byteArray Checksum-validated packet starting at LingoID
 /// @param len Length of valid data in the packet
-void snooper::_processPacket(const byte *byteArray, uint32_t len)
+/// @param timestamp esp_timer time at which the packet was received, in us
+void snooper::_processPacket(snoopChannel &channel, const byte *byteArray, uint32_t len, int64_t timestamp)
 {
     byte rxLingoID = byteArray[0];
     const byte *subPayload = byteArray + 1; // Squeeze the Lingo out
     uint32_t subPayloadLen = len - 1;
+    // Every valid packet is captured to the console, whatever its Lingo
+    _sendPacket(channel, byteArray, len, timestamp);
     switch (rxLingoID) // 0x00 is general Lingo and 0x04 is extended Lingo. Nothing else is expected from the Mini
     {
     case 0x00: // General Lingo
-        ESP_LOGD(snooperName,"Lingo 0x00 Packet in processor,payload length: %d", subPayloadLen);
-        processLingo0x00(subPayload, subPayloadLen);
+        ESP_LOGD(channel.name,"Lingo 0x00 Packet in processor,payload length: %d", subPayloadLen);
+        processLingo0x00(channel, subPayload, subPayloadLen);
         break;
 
     case 0x04: // Extended Interface Lingo
-        ESP_LOGD(snooperName,"Lingo 0x04 Packet in processor,payload length: %d", subPayloadLen);
-        processLingo0x04(subPayload, subPayloadLen);
+        ESP_LOGD(channel.name,"Lingo 0x04 Packet in processor,payload length: %d", subPayloadLen);
+        processLingo0x04(channel, subPayload, subPayloadLen);
         break;
 
     default:
-        ESP_LOGW(snooperName,"Unknown Lingo packet : L0x%x", rxLingoID);
+        _logWarning(channel, AAP_LOG_UNKNOWN_LINGO, {rxLingoID});
         break;
     }
 }
@@ -283,87 +317,180 @@ void snooper::_processPacket(const byte *byteArray, uint32_t len)
 //-----------------------------------------------------------------------
 //|         Constructor, reset, attachCallback for PB control           |
 //-----------------------------------------------------------------------
-#pragma region Constructor, destructor, reset and external PB Contoller attach
+#pragma region Constructor, destructor, channels and stats
+/// @brief Constructor for the per-channel state
+/// @param engine Snooper servicing the channel
+/// @param index Index of the channel in the snooper
+/// @param uartPort UART peripheral of the channel
+/// @param name Name of the channel, used as a logging tag
+snoopChannel::snoopChannel(snooper *engine, uint8_t index, uart_port_t uartPort, const char *name)
+    : engine(engine), index(index), name(name), uartPort(uartPort),
+      decoder(snooper::_onFrame, snooper::_onDecodeError, this, INTERBYTE_TIMEOUT),
+      baudHunter(autobaudCandidates, sizeof(autobaudCandidates) / sizeof(autobaudCandidates[0]))
+{
+}
+
 /// @brief Constructor for the snooper class
-/// @param targetSerial (Serial) stream on which the snooper will be communicating
-snooper::snooper(Stream &targetSerial, const char *name)
-    : _targetSerial(targetSerial), snooperName(name)
+/// @param name Name of the snooper, used as a logging tag for what is not specific to a channel
+/// @param merger Time-ordered output stage, shared with the detect sampler
+snooper::snooper(const char *name, streamMerger &merger)
+    : snooperName(name), _merger(merger)
 {
-    // Create queues with pointer structures to byte arrays
+    // Create the processing queue with pointer structures to byte arrays
     _cmdQueue = xQueueCreate(CMD_QUEUE_SIZE, sizeof(aapCommand));
-    _txQueue = xQueueCreate(TX_QUEUE_SIZE, sizeof(aapCommand));
 
 
-    if (_cmdQueue == NULL || _txQueue == NULL ) // Add _timerQueue check
+    if (_cmdQueue == NULL)
     {
         ESP_LOGE(snooperName,"Could not create queues");
     }
+}
 
-    // Create FreeRTOS tasks for compiling incoming commands, processing commands and transmitting commands
-    if (_cmdQueue != NULL && _txQueue != NULL ) // Add _timerQueue check
+/// @brief Installs the UART driver of a new channel. Channels must all be added before begin().
+/// @param uartPort UART peripheral to listen to
+/// @param name Name of the channel, used as a logging tag and in the task names
+/// @param baudRate Line rate of the snooped link. With AUTOBAUD, this is only the first rate tried.
+/// @param rxPin GPIO used as RX
+/// @param txPin GPIO used as TX (unused by the snooper, but reserved for the peripheral)
+/// @return ESP_OK if the channel was added, ESP_ERR_INVALID_STATE once started or full, ESP_FAIL if the driver could not be installed
+esp_err_t snooper::addChannel(uart_port_t uartPort, const char *name, uint32_t baudRate, int rxPin, int txPin)
+{
+    if (_rxTaskHandle != NULL || _channelCount == SNOOPER_MAX_CHANNELS)
     {
-        xTaskCreatePinnedToCore(_rxTask, "RX Task", RX_TASK_STACK_SIZE, this, RX_TASK_PRIORITY, &_rxTaskHandle, 1);
-        xTaskCreatePinnedToCore(_processTask, "Processor Task", PROCESS_TASK_STACK_SIZE, this, PROCESS_TASK_PRIORITY, &_processTaskHandle, 1);
-        xTaskCreatePinnedToCore(_txTask, "Transmit Task", TX_TASK_STACK_SIZE, this, TX_TASK_PRIORITY, &_txTaskHandle, 1);
-
-        if (_rxTaskHandle == NULL || _processTaskHandle == NULL || _txTaskHandle == NULL)
-        {
-            ESP_LOGE(snooperName,"Could not create tasks");
-        }
+        ESP_LOGE(name,"Channel cannot be added, snooper started or SNOOPER_MAX_CHANNELS reached");
+        return ESP_ERR_INVALID_STATE;
     }
-    else
+    // Allocated once at startup, never freed
+    snoopChannel *channel = new (std::nothrow) snoopChannel(this, _channelCount, uartPort, name);
+    if (channel == nullptr)
     {
-        ESP_LOGE(snooperName,"Could not create tasks, queues not created");
+        ESP_LOGE(name,"Could not allocate channel");
+        return ESP_FAIL;
     }
+#if AUTOBAUD
+    baudRate = channel->baudHunter.start(baudRate);
+#else
+    channel->baudHunter.fix(baudRate);
+#endif
+    uart_config_t uartConfig = {};
+    uartConfig.baud_rate = (int)baudRate;
+    uartConfig.data_bits = UART_DATA_8_BITS;
+    uartConfig.parity = UART_PARITY_DISABLE;
+    uartConfig.stop_bits = UART_STOP_BITS_1;
+    uartConfig.flow_ctrl = UART_HW_FLOWCTRL_DISABLE;
+    uartConfig.source_clk = UART_SCLK_DEFAULT;
+
+    if (uart_driver_install(uartPort, RX_BUFFER_SIZE, 0, UART_EVENT_QUEUE_SIZE, &channel->uartEventQueue, 0) != ESP_OK ||
+        uart_param_config(uartPort, &uartConfig) != ESP_OK ||
+        uart_set_pin(uartPort, txPin, rxPin, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE) != ESP_OK)
+    {
+        ESP_LOGE(name,"Could not install UART driver");
+        delete channel;
+        return ESP_FAIL;
+    }
+    channel->lastActivity = millis();
+    _channels[_channelCount++] = channel;
+    return ESP_OK;
 }
 
-/// @brief Destructor for the snooper class. Normally not used.
-snooper::~snooper()
+/// @brief Puts the UART event queues of all channels in a queue set and starts the shared RX and processing tasks
+/// @return ESP_OK if the tasks were started, ESP_FAIL otherwise
+esp_err_t snooper::begin()
 {
-    aapCommand tempCmd;
-    vTaskDelete(_rxTaskHandle);
-    vTaskDelete(_processTaskHandle);
-    vTaskDelete(_txTaskHandle);
-    // Remember to deallocate memory
-    while (xQueueReceive(_cmdQueue, &tempCmd, 0) == pdTRUE)
+    if (_cmdQueue == NULL || _channelCount == 0)
     {
-        delete[] tempCmd.payload;
-        tempCmd.payload = nullptr;
-        tempCmd.length = 0;
+        ESP_LOGE(snooperName,"Could not create tasks, queues not created or no channel added");
+        return ESP_FAIL;
     }
-    while (xQueueReceive(_txQueue, &tempCmd, 0) == pdTRUE)
+
+    // The set must be able to hold every event of every channel
+    _uartEventSet = xQueueCreateSet(_channelCount * UART_EVENT_QUEUE_SIZE);
+    if (_uartEventSet == NULL)
     {
-        delete[] tempCmd.payload;
-        tempCmd.payload = nullptr;
-        tempCmd.length = 0;
+        ESP_LOGE(snooperName,"Could not create the UART event set");
+        return ESP_FAIL;
     }
-    vQueueDelete(_cmdQueue);
-    vQueueDelete(_txQueue);
+    for (uint8_t i = 0; i < _channelCount; i++)
+    {
+        // Only empty queues can join a set, the bytes behind the dropped events are read on the next event
+        do
+        {
+            xQueueReset(_channels[i]->uartEventQueue);
+        } while (xQueueAddToSet(_channels[i]->uartEventQueue, _uartEventSet) != pdPASS);
+    }
+
+    // Create FreeRTOS tasks for compiling incoming commands and processing commands, shared by all the channels
+    char taskName[configMAX_TASK_NAME_LEN];
+    snprintf(taskName, sizeof(taskName), "%s RX", snooperName);
+    xTaskCreatePinnedToCore(_rxTask, taskName, RX_TASK_STACK_SIZE, this, RX_TASK_PRIORITY, &_rxTaskHandle, 1);
+    snprintf(taskName, sizeof(taskName), "%s Process", snooperName);
+    xTaskCreatePinnedToCore(_processTask, taskName, PROCESS_TASK_STACK_SIZE, this, PROCESS_TASK_PRIORITY, &_processTaskHandle, 1);
+
+    if (_rxTaskHandle == NULL || _processTaskHandle == NULL)
+    {
+        ESP_LOGE(snooperName,"Could not create tasks");
+        return ESP_FAIL;
+    }
+    return ESP_OK;
 }
 
-void snooper::resetState()
+/// @brief Forces the line rate of a channel and disables its detection. Applied by the RX task within RX_EVENT_TIMEOUT_MS.
+/// @param index Index of the channel
+/// @param baudRate New line rate
+void snooper::setBaudRate(uint8_t index, uint32_t baudRate)
 {
+    if (index < _channelCount)
+        _channels[index]->requestedBaudRate = baudRate;
+}
 
-    ESP_LOGW(snooperName,"snooper resetState called");
+/// @brief Starts the line rate detection of a channel over, from its current rate. Applied by the RX task within RX_EVENT_TIMEOUT_MS.
+/// @param index Index of the channel
+void snooper::startAutobaud(uint8_t index)
+{
+    if (index < _channelCount)
+        _channels[index]->autobaudRequested = true;
+}
 
-    // Reset the queues
+/// @brief Destructor for the snooper class. Normally not used.
+snooper::~snooper()
+{
     aapCommand tempCmd;
-
-    // Remember to deallocate memory
+    if (_rxTaskHandle != NULL)
+        vTaskDelete(_rxTaskHandle);
+    if (_processTaskHandle != NULL)
+        vTaskDelete(_processTaskHandle);
+    // Remember to return the slabs to the pool
     while (xQueueReceive(_cmdQueue, &tempCmd, 0) == pdTRUE)
     {
-        delete[] tempCmd.payload;
+        _pool.release(tempCmd.payload);
         tempCmd.payload = nullptr;
         tempCmd.length = 0;
     }
-    while (xQueueReceive(_txQueue, &tempCmd, 0) == pdTRUE)
+    vQueueDelete(_cmdQueue);
+    for (uint8_t i = 0; i < _channelCount; i++)
     {
-        delete[] tempCmd.payload;
-        tempCmd.payload = nullptr;
-        tempCmd.length = 0;
+        if (_uartEventSet != NULL)
+            xQueueRemoveFromSet(_channels[i]->uartEventQueue, _uartEventSet);
+        uart_driver_delete(_channels[i]->uartPort);
+        delete _channels[i];
+    }
+    if (_uartEventSet != NULL)
+        vQueueDelete(_uartEventSet);
+}
+
+/// @brief Logs the line rate, overflows and per-stage latencies of every channel, then the shared pool and merger
+void snooper::logStats()
+{
+    for (uint8_t i = 0; i < _channelCount; i++)
+    {
+        const snoopChannel &channel = *_channels[i];
+        ESP_LOGI(channel.name,"Line rate %lu baud (%s), %lu rate switches, %lu RX overflows", channel.baudHunter.baudRate(),
+                 channel.baudHunter.locked() ? "locked" : "hunting", channel.baudHunter.switches(), channel.rxOverflows);
+        ESP_LOGI(channel.name,"RX->Process latency avg %lu us max %lu us over %lu packets", channel.processLatency.averageUs(), channel.processLatency.maxUs, channel.processLatency.count);
+        ESP_LOGI(channel.name,"RX->Merge latency avg %lu us max %lu us over %lu packets", channel.mergeLatency.averageUs(), channel.mergeLatency.maxUs, channel.mergeLatency.count);
     }
-    xQueueReset(_cmdQueue);
-    xQueueReset(_txQueue);
+    ESP_LOGI(snooperName,"Packet pool peak %lu/%lu slabs, %lu exhaustions", _pool.peakInUse(), _pool.capacity(), _pool.exhaustions());
+    _merger.logStats();
 }
 
 #pragma endregion
@@ -373,90 +500,25 @@ void snooper::resetState()
 //-----------------------------------------------------------------------
 #pragma region 0x00 Processor
 
-/// @brief This function processes a shortened byteArray packet identified as a valid Lingo 0x00 request
+/// @brief This function processes a shortened byteArray packet identified as a valid Lingo 0x00 request, through the command table
+/// @param channel Channel the packet was received on
 /// @param byteArray Shortened packet, with byteArray[0] being the Lingo 0x00 command ID byte
 /// @param len Length of valid data in the byteArray
-void snooper::processLingo0x00(const byte *byteArray, uint32_t len)
+void snooper::processLingo0x00(const snoopChannel &channel, const byte *byteArray, uint32_t len)
 {
-    byte cmdID = byteArray[0];
-    // Switch through expected commandIDs
-    switch (cmdID)
-    {
-    case L0x00_Identify: // Deprecated command observed on Audi by @BluCobalt
-    {
-        ESP_LOGI(snooperName,"CMD: 0x%02x Identify with Lingo 0x%02x", cmdID, byteArray[1]);
-    }
-    break;
-
-    case L0x00_RequestExtendedInterfaceMode: // Mini requests extended interface mode status
-    {
-        ESP_LOGI(snooperName,"CMD: 0x%02x RequestExtendedInterfaceMode", cmdID);
-    }
-    break;
-
-    case L0x00_EnterExtendedInterfaceMode: // Mini forces extended interface mode
-    {
-        ESP_LOGI(snooperName,"CMD: 0x%02x EnterExtendedInterfaceMode", cmdID);
-    }
-    break;
-
-    case L0x00_ExitExtendedInterfaceMode: // Mini exits extended interface mode
-    {
-        ESP_LOGI(snooperName,"CMD: 0x%02x ExitExtendedInterfaceMode", cmdID);
-    }
-    break;
-
-    case L0x00_RequestiPodName: // Mini requests ipod name
-    {
-        ESP_LOGI(snooperName,"CMD: 0x%02x RequestiPodName", cmdID);
-    }
-    break;
-
-    case L0x00_RequestiPodSoftwareVersion: // Mini requests ipod software version
+    if (len < 1)
     {
-        ESP_LOGI(snooperName,"CMD: 0x%02x RequestiPodSoftwareVersion", cmdID);
+        _logWarning(channel, AAP_LOG_PACKET_TOO_SHORT, {0x00});
+        return;
     }
-    break;
-
-    case L0x00_RequestiPodSerialNum: // Mini requests ipod Serial Num
-    {
-        ESP_LOGI(snooperName,"CMD: 0x%02x RequestiPodSerialNum", cmdID);
-    }
-    break;
-
-    case L0x00_RequestiPodModelNum: // Mini requests ipod Model Num
-    {
-        ESP_LOGI(snooperName,"CMD: 0x%02x RequestiPodModelNum", cmdID);
-    }
-    break;
-
-    case L0x00_RequestLingoProtocolVersion: // Mini requestsLingo Protocol Version
-    {
-        ESP_LOGI(snooperName,"CMD: 0x%02x RequestLingoProtocolVersion for Lingo 0x%02x", cmdID, byteArray[1]);
-    }
-    break;
-
-    case L0x00_IdentifyDeviceLingoes: // Mini identifies its lingoes, used as an ice-breaker
-    {
-        ESP_LOGI(snooperName,"CMD: 0x%02x IdentifyDeviceLingoes", cmdID);
-    }
-    break;
-
-    case L0x00_RetAccessoryInfo: // Mini returns info after L0x00_0x27
-    {
-        ESP_LOGI(snooperName,"CMD: 0x%02x RetAccessoryInfo: 0x%02x", cmdID, byteArray[1]);
-    }
-    break;
-
-    default: // In case the command is not known
+    byte cmdID = byteArray[0];
+    const aapCommandDescriptor *command = aapFindCommand(0x00, cmdID);
+    if (command == nullptr) // In case the command is not known
     {
-        ESP_LOGW(snooperName,"CMD 0x%02x not recognized.", cmdID);
-    }
-    break;
+        _logWarning(channel, AAP_LOG_CMD_NOT_RECOGNIZED, {0x00, cmdID});
+        return;
     }
-
-    //Queue the packet anyways
-    _queuePacket(byteArray, len);
+    _logCommand(channel, 0x00, command, byteArray + 1, len - 1);
 }
 #pragma endregion
 
@@ -465,172 +527,107 @@ void snooper::processLingo0x00(const byte *byteArray, uint32_t len)
 //-----------------------------------------------------------------------
 #pragma region 0x04 Processor
 
-/// @brief This function processes a shortened byteArray packet identified as a valid Lingo 0x04 request
+/// @brief This function processes a shortened byteArray packet identified as a valid Lingo 0x04 request, through the command table
+/// @param channel Channel the packet was received on
 /// @param byteArray Shortened packet, with byteArray[1] being the last byte of the Lingo 0x04 command
 /// @param len Length of valid data in the byteArray
-void snooper::processLingo0x04(const byte *byteArray, uint32_t len)
+void snooper::processLingo0x04(const snoopChannel &channel, const byte *byteArray, uint32_t len)
 {
-    byte cmdID = byteArray[1];
-    // Initialising handlers to understand what is happening in some parts of the switch. They cannot be initialised in the switch-case scope
-    byte category;
-    uint32_t startIndex, counts, tempTrackIndex;
+    if (len < 2)
     {
-        switch (cmdID) // Reminder : we are technically switching on byteArray[1] now
-        {
-        case L0x04_GetIndexedPlayingTrackInfo:
-        {
-            tempTrackIndex = swap_endian<uint32_t>(*((uint32_t *)&byteArray[3]));
-            switch (byteArray[2]) // Switch on the type of track info requested (careful with overloads)
-            {
-            case 0x00: // General track Capabilities and Information
-                ESP_LOGI(snooperName,"CMD 0x%04x GetIndexedPlayingTrackInfo 0x%02x for index %d : Duration", cmdID, byteArray[2], tempTrackIndex);
-                break;
-            case 0x02: // Track Release Date (fictional)
-                ESP_LOGI(snooperName,"CMD 0x%04x GetIndexedPlayingTrackInfo 0x%02x for index %d : Release date", cmdID, byteArray[2], tempTrackIndex);
-                break;
-            case 0x01: // Track Title
-                ESP_LOGI(snooperName,"CMD 0x%04x GetIndexedPlayingTrackInfo 0x%02x for index %d : Title", cmdID, byteArray[2], tempTrackIndex);
-                break;
-            case 0x05: // Track Genre
-                ESP_LOGI(snooperName,"CMD 0x%04x GetIndexedPlayingTrackInfo 0x%02x for index %d : Genre", cmdID, byteArray[2], tempTrackIndex);
-                break;
-            case 0x06: // Track Composer
-                ESP_LOGI(snooperName,"CMD 0x%04x GetIndexedPlayingTrackInfo 0x%02x for index %d : Composer", cmdID, byteArray[2], tempTrackIndex);
-                break;
-            default: // In case the request is beyond the track capabilities
-                ESP_LOGW(snooperName,"CMD 0x%04x GetIndexedPlayingTrackInfo 0x%02x for index %d : Type not recognised!", cmdID, byteArray[2], tempTrackIndex);
-                break;
-            }
-        }
-        break;
-
-        case L0x04_RequestProtocolVersion: // Hardcoded return for L0x04
-        {
-            ESP_LOGI(snooperName,"CMD 0x%04x RequestProtocolVersion", cmdID);
-        }
-        break;
-
-        case L0x04_ResetDBSelection: // Not sure what to do here. Reset Current Track Index ?
-        {
-            ESP_LOGI(snooperName,"CMD 0x%04x ResetDBSelection", cmdID);
-        }
-        break;
-
-        case L0x04_SelectDBRecord: // Used for browsing ?
-        {
-            ESP_LOGI(snooperName,"CMD 0x%04x SelectDBRecord", cmdID);
-        }
-        break;
-
-        case L0x04_GetNumberCategorizedDBRecords: // Mini requests the number of records for a specific DB_CAT
-        {
-            category = byteArray[2];
-            ESP_LOGI(snooperName,"CMD 0x%04x GetNumberCategorizedDBRecords category: 0x%02x", cmdID, category);
-        }
-        break;
-
-        case L0x04_RetrieveCategorizedDatabaseRecords: // Loops through the desired records for a given DB_CAT
-        {
-            category = byteArray[2]; // DBCat
-            startIndex = swap_endian<uint32_t>(*(uint32_t *)&byteArray[3]);
-            counts = swap_endian<uint32_t>(*(uint32_t *)&byteArray[7]);
-
-            ESP_LOGI(snooperName,"CMD 0x%04x RetrieveCategorizedDatabaseRecords category: 0x%02x from %d for %d counts", cmdID, category, startIndex, counts);
-        }
-        break;
-
-        case L0x04_GetPlayStatus: // Returns the current playStatus and the position/duration of the current track
-        {
-            ESP_LOGI(snooperName,"CMD 0x%04x GetPlayStatus", cmdID);
-        }
-        break;
-
-        case L0x04_GetCurrentPlayingTrackIndex: // Get the uint32 index of the currently playing song
-        {
-            ESP_LOGI(snooperName,"CMD 0x%04x GetCurrentPlayingTrackIndex", cmdID);
-        }
-        break;
-
-        case L0x04_GetIndexedPlayingTrackTitle:
-        {
-            tempTrackIndex = swap_endian<uint32_t>(*((uint32_t *)&byteArray[2]));
-            ESP_LOGI(snooperName,"CMD 0x%04x GetIndexedPlayingTrackTitle for index %d", cmdID, tempTrackIndex);
-
-        }
-        break;
-
-        case L0x04_GetIndexedPlayingTrackArtistName:
-        {
-            tempTrackIndex = swap_endian<uint32_t>(*((uint32_t *)&byteArray[2]));
-
-            ESP_LOGI(snooperName,"CMD 0x%04x GetIndexedPlayingTrackArtistName for index %d", cmdID, tempTrackIndex);
-        }
-        break;
-
-        case L0x04_GetIndexedPlayingTrackAlbumName:
-        {
-            tempTrackIndex = swap_endian<uint32_t>(*((uint32_t *)&byteArray[2]));
-            ESP_LOGI(snooperName,"CMD 0x%04x GetIndexedPlayingTrackAlbumName for index %d", cmdID, tempTrackIndex);
-        }
-        break;
-
-        case L0x04_SetPlayStatusChangeNotification: // Turns on basic notifications
-        {
-            ESP_LOGI(snooperName,"CMD 0x%04x SetPlayStatusChangeNotification 0x%02x", cmdID, byteArray[2]);
-        }
-        break;
-
-        case L0x04_PlayCurrentSelection: // Used to play a specific index, usually for "next" commands, but may be used to actually jump anywhere
-        {
-            tempTrackIndex = swap_endian<uint32_t>(*((uint32_t *)&byteArray[2]));
-            ESP_LOGI(snooperName,"CMD 0x%04x PlayCurrentSelection index %d", cmdID, tempTrackIndex);
-        }
-        break;
-
-        case L0x04_PlayControl: // Basic play control. Used for Prev, pause and play
-        {
-            ESP_LOGI(snooperName,"CMD 0x%04x PlayControl req: 0x%02x", cmdID, byteArray[2]);
-        }
-        break;
-
-        case L0x04_GetShuffle: // Get Shuffle state from the PB Engine
-        {
-            ESP_LOGI(snooperName,"CMD 0x%04x GetShuffle", cmdID);
-        }
-        break;
-
-        case L0x04_SetShuffle: // Set Shuffle state
-        {
-            ESP_LOGI(snooperName,"CMD 0x%04x SetShuffle req: 0x%02x", cmdID, byteArray[2]);
-        }
-        break;
-
-        case L0x04_GetRepeat: // Get Repeat state
-        {
-            ESP_LOGI(snooperName,"CMD 0x%04x GetRepeat", cmdID);
-        }
-        break;
-
-        case L0x04_SetRepeat: // Set Repeat state
-        {
-            ESP_LOGI(snooperName,"CMD 0x%04x SetRepeat req: 0x%02x", cmdID, byteArray[2]);
-        }
-        break;
+        _logWarning(channel, AAP_LOG_PACKET_TOO_SHORT, {0x04});
+        return;
+    }
+    byte cmdID = byteArray[1]; // Reminder : the first byte of the command ID is always 0x00
+    const aapCommandDescriptor *command = aapFindCommand(0x04, cmdID);
+    if (command == nullptr)
+    {
+        _logWarning(channel, AAP_LOG_CMD_NOT_RECOGNIZED, {0x04, cmdID});
+        return;
+    }
+    _logCommand(channel, 0x04, command, byteArray + 2, len - 2);
+}
+#pragma endregion
 
-        case L0x04_GetNumPlayingTracks: // Systematically return TOTAL_NUM_TRACKS
-        {
-            ESP_LOGI(snooperName,"CMD 0x%04x GetNumPlayingTracks", cmdID);
-        }
-        break;
+//-----------------------------------------------------------------------
+//|                               Logging                               |
+//-----------------------------------------------------------------------
+#pragma region Logging
+/// @brief Logs a decoded command. Formatting is skipped altogether when INFO logs are compiled out.
+/// With TOKENIZED_LOG, only the command token and the raw parameters are sent, the host tool does the formatting.
+/// @param channel Channel the command was received on, used as the logging tag
+/// @param lingo Lingo of the command
+/// @param command Descriptor of the command
+/// @param params Parameters following the command ID
+/// @param paramsLen Length of the parameters
+void snooper::_logCommand(const snoopChannel &channel, byte lingo, const aapCommandDescriptor *command, const byte *params, uint32_t paramsLen)
+{
+#if CORE_DEBUG_LEVEL >= ARDUHAL_LOG_LEVEL_INFO
+#ifdef TOKENIZED_LOG
+    _sendLogRecord(channel, AAP_LOG_COMMAND_TOKEN(lingo, command->id), params, paramsLen);
+#else
+    char description[COMMAND_DESCRIPTION_SIZE];
+    aapFormatCommand(command, params, paramsLen, description, sizeof(description));
+    ESP_LOGI(channel.name, "%s", description);
+#endif
+#endif
+}
 
-        case L0x04_SetCurrentPlayingTrack: // Basically identical to PlayCurrentSelection
-        {
-            tempTrackIndex = swap_endian<uint32_t>(*((uint32_t *)&byteArray[2]));
-            ESP_LOGI(snooperName,"CMD 0x%04x SetCurrentPlayingTrack index %d", cmdID, tempTrackIndex);
-        }
-        break;
-        }
+/// @brief Logs a warning from the token table, either as a tokenized record or formatted on the spot
+/// @param channel Channel the warning relates to, used as the logging tag
+/// @param token Format of the warning in aapLogTokens.def
+/// @param args Integer arguments of the format, at most AAP_LOG_MAX_ARGS
+void snooper::_logWarning(const snoopChannel &channel, aapLogToken token, std::initializer_list<uint32_t> args)
+{
+#if CORE_DEBUG_LEVEL >= ARDUHAL_LOG_LEVEL_WARN
+    uint32_t values[AAP_LOG_MAX_ARGS] = {0};
+    uint32_t argCount = 0;
+    for (uint32_t arg : args)
+    {
+        if (argCount == AAP_LOG_MAX_ARGS)
+            break;
+        values[argCount++] = arg;
+    }
+#ifdef TOKENIZED_LOG
+    byte packedArgs[4 * AAP_LOG_MAX_ARGS];
+    for (uint32_t i = 0; i < argCount; i++)
+    {
+        packedArgs[4 * i] = (byte)values[i];
+        packedArgs[4 * i + 1] = (byte)(values[i] >> 8);
+        packedArgs[4 * i + 2] = (byte)(values[i] >> 16);
+        packedArgs[4 * i + 3] = (byte)(values[i] >> 24);
     }
+    _sendLogRecord(channel, token, packedArgs, 4 * argCount);
+#else
+    char description[COMMAND_DESCRIPTION_SIZE];
+    snprintf(description, sizeof(description), aapLogFormats[token], (unsigned int)values[0], (unsigned int)values[1],
+             (unsigned int)values[2], (unsigned int)values[3]);
+    ESP_LOGW(channel.name, "%s", description);
+#endif
+#endif
+}
+
+/// @brief Sends a tokenized log record to the merged output stage
+/// @param channel Channel the record relates to
+/// @param token Log token, see aapLogTokens.h
+/// @param args Arguments following the token
+/// @param argsLen Length of the arguments, truncated to fit in a record
+void snooper::_sendLogRecord(const snoopChannel &channel, uint16_t token, const byte *args, uint32_t argsLen)
+{
+    byte payload[AAP_CAPTURE_MAX_PAYLOAD];
+    if (argsLen > sizeof(payload) - 2)
+        argsLen = sizeof(payload) - 2;
+    payload[0] = (byte)token;
+    payload[1] = (byte)(token >> 8);
+    memcpy(&payload[2], args, argsLen);
+
+    aapCaptureRecord captureRecord;
+    captureRecord.type = AAP_CAPTURE_LOG;
+    captureRecord.channel = (uint8_t)channel.uartPort;
+    captureRecord.timestampUs = (uint64_t)esp_timer_get_time();
+    captureRecord.length = argsLen + 2;
+    captureRecord.payload = payload;
+    _merger.push(captureRecord);
 }
 #pragma endregion
 /*
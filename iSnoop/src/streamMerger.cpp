@@ -0,0 +1,127 @@
+#include "streamMerger.h"
+
+/// @brief Constructor for the merged output stage
+/// @param egress Console output stage receiving the ordered records
+streamMerger::streamMerger(consoleEgress &egress)
+    : _egress(egress), _merger(_onRecord, this, MERGE_WINDOW_US)
+{
+}
+
+/// @brief Merge task, periodically releases the records whose reorder window has closed
+/// @param pvParameters streamMerger instance
+void streamMerger::_mergeTask(void *pvParameters)
+{
+    streamMerger *mergerInstance = static_cast<streamMerger *>(pvParameters);
+    TickType_t lastWake = xTaskGetTickCount();
+
+    while (true)
+    {
+        xSemaphoreTake(mergerInstance->_lock, portMAX_DELAY);
+        mergerInstance->_merger.drain((uint64_t)esp_timer_get_time());
+        xSemaphoreGive(mergerInstance->_lock);
+        vTaskDelayUntil(&lastWake, pdMS_TO_TICKS(MERGE_INTERVAL_MS));
+    }
+}
+
+/// @brief Merger callback, encodes an ordered record and hands it over to the console
+/// @param context streamMerger instance
+/// @param record Record to encode, only valid during the call
+void streamMerger::_onRecord(void *context, const aapCaptureRecord &record)
+{
+    streamMerger *mergerInstance = static_cast<streamMerger *>(context);
+    mergerInstance->_latency.observe(record);
+    byte encoded[AAP_CAPTURE_MAX_RECORD];
+    size_t encodedLen = aapCaptureEncode(record, encoded, sizeof(encoded));
+    if (encodedLen > 0 && !mergerInstance->_egress.push(encoded, encodedLen))
+        ESP_LOGD("MERGE", "Console ring buffer full, record dropped");
+}
+
+/// @brief Creates the lock and the merge task
+/// @return ESP_OK if both were created, ESP_FAIL otherwise
+esp_err_t streamMerger::begin()
+{
+    _lock = xSemaphoreCreateMutex();
+    if (_lock == NULL)
+    {
+        ESP_LOGE(__func__, "Could not create merger lock");
+        return ESP_FAIL;
+    }
+    xTaskCreatePinnedToCore(_mergeTask, "Merge Task", MERGE_TASK_STACK_SIZE, this, MERGE_TASK_PRIORITY, &_mergeTaskHandle, 1);
+    if (_mergeTaskHandle == NULL)
+    {
+        ESP_LOGE(__func__, "Could not create merge task");
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+/// @brief Copies a record into the merger. Records pushed before begin() are dropped.
+/// @param record Record to merge, its timestamp must come from esp_timer_get_time()
+/// @return true if the record was accepted
+bool streamMerger::push(const aapCaptureRecord &record)
+{
+    if (_lock == NULL)
+        return false;
+    xSemaphoreTake(_lock, portMAX_DELAY);
+    bool accepted = _merger.push(record);
+    xSemaphoreGive(_lock);
+    return accepted;
+}
+
+/// @brief Logs the reorder counters, then the console counters
+void streamMerger::logStats()
+{
+    const aapMergerStats &stats = _merger.stats();
+    ESP_LOGI("MERGE", "Window %lu us, depth %lu (peak %lu/%d), %lu merged, %lu late, %lu forced out",
+             _merger.windowUs(), _merger.depth(), stats.peakDepth, AAP_MERGE_CAPACITY, stats.emitted, stats.late, stats.forced);
+    _egress.logStats();
+}
+
+/// @brief Logs the request->response latency of every command seen so far.
+/// Commands whose worst case reaches LATENCY_WARN_MS are flagged, as they get close to the head unit timeouts.
+/// The figures are copied under the lock and logged after releasing it, so that the RX tasks never wait on the console.
+/// Console task only, the copy is static.
+void streamMerger::logLatency()
+{
+    if (_lock == NULL)
+        return;
+    static latencySummary summaries[AAP_LATENCY_MAX_COMMANDS];
+    xSemaphoreTake(_lock, portMAX_DELAY);
+    uint32_t commandCount = _latency.commandCount();
+    uint32_t untracked = _latency.untracked();
+    for (uint32_t i = 0; i < commandCount; i++)
+    {
+        const aapLatencyStats &stats = _latency.command(i);
+        latencySummary &summary = summaries[i];
+        summary.lingo = stats.lingo;
+        summary.cmdID = stats.cmdID;
+        summary.count = stats.count;
+        summary.p50Us = aapLatencyAnalyzer::percentileUs(stats, 50);
+        summary.p99Us = aapLatencyAnalyzer::percentileUs(stats, 99);
+        summary.maxUs = stats.maxUs;
+        summary.retries = stats.retries;
+        summary.unanswered = stats.unanswered;
+    }
+    xSemaphoreGive(_lock);
+
+    ESP_LOGI("LATENCY", "%lu commands, %lu replies not tracked (table full)", commandCount, untracked);
+    for (uint32_t i = 0; i < commandCount; i++)
+    {
+        const latencySummary &summary = summaries[i];
+        const aapCommandDescriptor *command = aapFindCommand(summary.lingo, summary.cmdID);
+        ESP_LOGI("LATENCY", "L0x%02x 0x%02x %-36s n=%lu p50 %lu us p99 %lu us max %lu us, %lu retries, %lu unanswered%s",
+                 summary.lingo, summary.cmdID, (command != nullptr) ? command->name : "?", summary.count,
+                 summary.p50Us, summary.p99Us, summary.maxUs, summary.retries, summary.unanswered,
+                 (summary.maxUs >= LATENCY_WARN_MS * 1000UL) ? " <- SLOW" : "");
+    }
+}
+
+/// @brief Clears the latency histograms, e.g. before a new test run
+void streamMerger::resetLatency()
+{
+    if (_lock == NULL)
+        return;
+    xSemaphoreTake(_lock, portMAX_DELAY);
+    _latency.reset();
+    xSemaphoreGive(_lock);
+}
@@ -0,0 +1,175 @@
+#include <unity.h>
+#include <math.h>
+#include <vector>
+
+#include "aapBaudHunter.h"
+#include "aapDecoder.h"
+
+#pragma region Helpers
+static const uint32_t candidates[] = {19200, 57600, 38400, 115200, 9600};
+
+/// @brief Line level at the transmitter rate, one entry per bit time, idle high
+static std::vector<uint8_t> buildLine(uint32_t frames)
+{
+    const uint8_t getPlayStatus[] = {0x04, 0x00, 0x1C};
+    const uint8_t returnPlayStatus[] = {0x04, 0x00, 0x1D, 0x00, 0x00, 0x10, 0x00, 0x00, 0x03, 0x00, 0x00, 0x01};
+    std::vector<uint8_t> bits;
+    auto sendByte = [&bits](uint8_t value) {
+        bits.push_back(0);
+        for (int i = 0; i < 8; i++)
+            bits.push_back((value >> i) & 0x01);
+        bits.push_back(1);
+    };
+    for (uint32_t f = 0; f < frames; f++)
+    {
+        const uint8_t *payload = (f & 1) ? returnPlayStatus : getPlayStatus;
+        uint8_t len = (f & 1) ? sizeof(returnPlayStatus) : sizeof(getPlayStatus);
+        sendByte(0xFF);
+        sendByte(0x55);
+        sendByte(len);
+        for (uint8_t i = 0; i < len; i++)
+            sendByte(payload[i]);
+        sendByte(aapDecoder::checksum(payload, len));
+        for (int i = 0; i < 20; i++) // Idle between frames
+            bits.push_back(1);
+    }
+    return bits;
+}
+
+/// @brief UART receiver sampling the line at its own rate, as the peripheral does
+struct lineReceiver
+{
+    const std::vector<uint8_t> &bits;
+    double txBaud;
+    double t = 0; // Seconds
+
+    int level(double at) const
+    {
+        size_t index = (size_t)(at * txBaud);
+        return (index < bits.size()) ? bits[index] : 1;
+    }
+    bool done() const { return (size_t)(t * txBaud) >= bits.size(); }
+
+    /// @brief Receives the next byte at rxBaud
+    /// @return false at the end of the line
+    bool next(double rxBaud, uint8_t &value, bool &frameError)
+    {
+        // Hunt for the start bit edge
+        const double step = 1.0 / (16 * rxBaud);
+        while (level(t) == 1)
+        {
+            if (done())
+                return false;
+            t += step;
+        }
+        value = 0;
+        for (int i = 0; i < 8; i++)
+            value |= level(t + (i + 1.5) / rxBaud) << i;
+        frameError = level(t + 9.5 / rxBaud) == 0;
+        t += 9.5 / rxBaud;
+        return true;
+    }
+};
+
+struct huntContext
+{
+    aapBaudHunter *hunter;
+    bool switchPending = false;
+};
+
+static void onFrame(void *context, const uint8_t *, uint32_t)
+{
+    huntContext *hunt = static_cast<huntContext *>(context);
+    hunt->switchPending |= hunt->hunter->onFrame();
+}
+
+static void onError(void *context, aapDecoderError)
+{
+    huntContext *hunt = static_cast<huntContext *>(context);
+    hunt->switchPending |= hunt->hunter->onError();
+}
+
+/// @brief Listens to a line sent at txBaud, starting from 19200, until the hunter locks or the line ends
+static aapBaudHunter runHunt(uint32_t txBaud)
+{
+    std::vector<uint8_t> line = buildLine(400);
+    aapBaudHunter hunter(candidates, sizeof(candidates) / sizeof(candidates[0]));
+    huntContext hunt = {&hunter};
+    aapDecoder decoder(onFrame, onError, &hunt, 500);
+    lineReceiver receiver = {line, (double)txBaud};
+    uint32_t rxBaud = hunter.start(19200);
+
+    uint8_t value;
+    bool frameError;
+    while (!hunter.locked() && receiver.next(rxBaud, value, frameError))
+    {
+        hunt.switchPending |= hunter.onBytes(1);
+        if (frameError)
+            hunt.switchPending |= hunter.onError();
+        decoder.feed(&value, 1, (uint32_t)(receiver.t * 1000));
+        if (hunt.switchPending) // Same sequence as the snooper : new rate, decoder restarted
+        {
+            hunt.switchPending = false;
+            rxBaud = hunter.baudRate();
+            decoder.reset();
+        }
+    }
+    return hunter;
+}
+#pragma endregion
+
+#pragma region Tests
+void setUp() {}
+void tearDown() {}
+
+void test_locks_on_every_candidate_rate()
+{
+    for (uint32_t txBaud : candidates)
+    {
+        aapBaudHunter hunter = runHunt(txBaud);
+        TEST_ASSERT_TRUE(hunter.locked());
+        TEST_ASSERT_EQUAL_UINT32(txBaud, hunter.baudRate());
+    }
+}
+
+void test_correct_rate_never_switches()
+{
+    aapBaudHunter hunter = runHunt(19200);
+    TEST_ASSERT_EQUAL_UINT32(0, hunter.switches());
+}
+
+void test_locked_rate_is_dropped_after_errors()
+{
+    aapBaudHunter hunter(candidates, sizeof(candidates) / sizeof(candidates[0]));
+    hunter.start(57600);
+    for (int i = 0; i < AAP_BAUD_LOCK_FRAMES; i++)
+        hunter.onFrame();
+    TEST_ASSERT_TRUE(hunter.locked());
+    bool switched = false;
+    for (int i = 0; i < AAP_BAUD_UNLOCK_ERRORS; i++)
+        switched |= hunter.onError();
+    TEST_ASSERT_TRUE(switched);
+    TEST_ASSERT_FALSE(hunter.locked());
+    TEST_ASSERT_EQUAL_UINT32(38400, hunter.baudRate());
+}
+
+void test_fixed_rate_ignores_errors()
+{
+    aapBaudHunter hunter(candidates, sizeof(candidates) / sizeof(candidates[0]));
+    hunter.fix(230400);
+    for (int i = 0; i < 100; i++)
+        TEST_ASSERT_FALSE(hunter.onError());
+    TEST_ASSERT_FALSE(hunter.onBytes(100000));
+    TEST_ASSERT_EQUAL_UINT32(230400, hunter.baudRate());
+}
+#pragma endregion
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_locks_on_every_candidate_rate);
+    RUN_TEST(test_correct_rate_never_switches);
+    RUN_TEST(test_locked_rate_is_dropped_after_errors);
+    RUN_TEST(test_fixed_rate_ignores_errors);
+    return UNITY_END();
+}
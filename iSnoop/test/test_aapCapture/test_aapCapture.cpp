@@ -0,0 +1,94 @@
+#include <unity.h>
+#include <string.h>
+#include <vector>
+
+#include "aapCapture.h"
+
+#pragma region Helpers
+struct readLog
+{
+    uint32_t records = 0;
+    aapCaptureRecord last;
+    uint8_t lastPayload[AAP_CAPTURE_MAX_PAYLOAD] = {0};
+};
+
+static void onRecord(void *context, const aapCaptureRecord &record)
+{
+    readLog *log = static_cast<readLog *>(context);
+    log->records++;
+    log->last = record;
+    memcpy(log->lastPayload, record.payload, record.length);
+    log->last.payload = log->lastPayload;
+}
+
+static const uint8_t samplePayload[] = {0x04, 0x00, 0x1C};
+#pragma endregion
+
+#pragma region Tests
+void setUp() {}
+void tearDown() {}
+
+void test_round_trip_keeps_every_field()
+{
+    aapCaptureRecord record;
+    record.channel = 2;
+    record.timestampUs = 0x0000123456789ABCULL;
+    record.detectMilliVolts = 3297;
+    record.length = sizeof(samplePayload);
+    record.payload = samplePayload;
+    uint8_t buf[AAP_CAPTURE_MAX_RECORD];
+    size_t len = aapCaptureEncode(record, buf, sizeof(buf));
+    TEST_ASSERT_EQUAL_UINT32(AAP_CAPTURE_OVERHEAD + sizeof(samplePayload), len);
+
+    readLog log;
+    aapCaptureReader reader(onRecord, &log);
+    reader.feed(buf, len);
+
+    TEST_ASSERT_EQUAL_UINT32(1, log.records);
+    TEST_ASSERT_EQUAL_UINT8(AAP_CAPTURE_FRAME, log.last.type);
+    TEST_ASSERT_EQUAL_UINT8(2, log.last.channel);
+    TEST_ASSERT_TRUE(log.last.timestampUs == record.timestampUs);
+    TEST_ASSERT_EQUAL_UINT16(3297, log.last.detectMilliVolts);
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(samplePayload, log.lastPayload, sizeof(samplePayload));
+}
+
+void test_text_logs_between_records_are_skipped()
+{
+    aapCaptureRecord record;
+    record.length = sizeof(samplePayload);
+    record.payload = samplePayload;
+    uint8_t buf[AAP_CAPTURE_MAX_RECORD];
+    size_t len = aapCaptureEncode(record, buf, sizeof(buf));
+
+    const char *logLine = "W (1234) UART1: Checksum mismatch \xA5\x5A discarding packet\n";
+    std::vector<uint8_t> stream(logLine, logLine + strlen(logLine));
+    stream.insert(stream.end(), buf, buf + len);
+    stream.insert(stream.end(), logLine, logLine + strlen(logLine));
+    stream.insert(stream.end(), buf, buf + len);
+
+    readLog log;
+    aapCaptureReader reader(onRecord, &log);
+    reader.feed(stream.data(), stream.size());
+
+    TEST_ASSERT_EQUAL_UINT32(2, log.records);
+    TEST_ASSERT_EQUAL_UINT32(2 * strlen(logLine), reader.skippedBytes());
+}
+
+void test_oversized_record_is_refused()
+{
+    aapCaptureRecord record;
+    uint8_t buf[AAP_CAPTURE_OVERHEAD + 2];
+    record.length = 3;
+    record.payload = samplePayload;
+    TEST_ASSERT_EQUAL_UINT32(0, aapCaptureEncode(record, buf, sizeof(buf)));
+}
+#pragma endregion
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_round_trip_keeps_every_field);
+    RUN_TEST(test_text_logs_between_records_are_skipped);
+    RUN_TEST(test_oversized_record_is_refused);
+    return UNITY_END();
+}
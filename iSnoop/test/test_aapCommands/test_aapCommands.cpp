@@ -0,0 +1,100 @@
+#include <unity.h>
+#include <string.h>
+
+#include "aapCommands.h"
+#include "aapLogTokens.h"
+
+#pragma region Tests
+void setUp() {}
+void tearDown() {}
+
+void test_every_table_entry_is_reachable()
+{
+    for (const aapCommandDescriptor &command : aapLingo0x00Commands)
+        TEST_ASSERT_TRUE(aapFindCommand(0x00, command.id) == &command);
+    for (const aapCommandDescriptor &command : aapLingo0x04Commands)
+        TEST_ASSERT_TRUE(aapFindCommand(0x04, command.id) == &command);
+}
+
+void test_unknown_commands_and_lingoes()
+{
+    TEST_ASSERT_NULL(aapFindCommand(0x00, 0x7F));
+    TEST_ASSERT_NULL(aapFindCommand(0x03, L0x00_Identify));
+}
+
+void test_describe_indexed_track_info()
+{
+    // L0x04 GetIndexedPlayingTrackInfo, Title for index 258
+    const uint8_t packet[] = {0x04, 0x00, 0x0C, 0x01, 0x00, 0x00, 0x01, 0x02};
+    char out[128];
+    TEST_ASSERT_TRUE(aapDescribe(packet, sizeof(packet), out, sizeof(out)) > 0);
+    TEST_ASSERT_EQUAL_STRING("CMD 0x0c GetIndexedPlayingTrackInfo 0x01 for index 258 : Title", out);
+}
+
+void test_describe_database_records()
+{
+    const uint8_t packet[] = {0x04, 0x00, 0x1A, 0x05, 0x00, 0x00, 0x00, 0x0A, 0x00, 0x00, 0x00, 0x14};
+    char out[128];
+    aapDescribe(packet, sizeof(packet), out, sizeof(out));
+    TEST_ASSERT_EQUAL_STRING("CMD 0x1a RetrieveCategorizedDatabaseRecords category: 0x05 from 10 for 20 counts", out);
+}
+
+void test_describe_truncated_packet()
+{
+    const uint8_t packet[] = {0x04, 0x00, 0x20, 0x00};
+    char out[128];
+    aapDescribe(packet, sizeof(packet), out, sizeof(out));
+    TEST_ASSERT_EQUAL_STRING("CMD 0x20 GetIndexedPlayingTrackTitle (truncated)", out);
+}
+
+void test_describe_string_reply()
+{
+    const uint8_t packet[] = {0x04, 0x00, 0x21, 'a', 'b', 'c', 0x00};
+    char out[128];
+    aapDescribe(packet, sizeof(packet), out, sizeof(out));
+    TEST_ASSERT_EQUAL_STRING("CMD 0x21 ReturnIndexedPlayingTrackTitle \"abc\"", out);
+}
+
+void test_expand_log_token_with_arguments()
+{
+    const uint8_t payload[] = {AAP_LOG_CMD_NOT_RECOGNIZED, 0x00, 0x04, 0x00, 0x00, 0x00, 0x7F, 0x00, 0x00, 0x00};
+    char out[128];
+    TEST_ASSERT_TRUE(aapExpandLog(payload, sizeof(payload), out, sizeof(out)) > 0);
+    TEST_ASSERT_EQUAL_STRING("L0x04 CMD 0x7f not recognized.", out);
+}
+
+void test_expand_command_token_matches_describe()
+{
+    const uint8_t packet[] = {0x04, 0x00, 0x0C, 0x01, 0x00, 0x00, 0x01, 0x02};
+    uint16_t token = AAP_LOG_COMMAND_TOKEN(0x04, 0x0C);
+    uint8_t payload[2 + 5] = {(uint8_t)token, (uint8_t)(token >> 8)};
+    memcpy(&payload[2], &packet[3], 5);
+    char expanded[128];
+    char described[128];
+    aapExpandLog(payload, sizeof(payload), expanded, sizeof(expanded));
+    aapDescribe(packet, sizeof(packet), described, sizeof(described));
+    TEST_ASSERT_EQUAL_STRING(described, expanded);
+}
+
+void test_expand_unknown_token()
+{
+    const uint8_t payload[] = {0xFF, 0x7F};
+    char out[128];
+    TEST_ASSERT_EQUAL_INT(-1, aapExpandLog(payload, sizeof(payload), out, sizeof(out)));
+}
+#pragma endregion
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_every_table_entry_is_reachable);
+    RUN_TEST(test_unknown_commands_and_lingoes);
+    RUN_TEST(test_describe_indexed_track_info);
+    RUN_TEST(test_describe_database_records);
+    RUN_TEST(test_describe_truncated_packet);
+    RUN_TEST(test_describe_string_reply);
+    RUN_TEST(test_expand_log_token_with_arguments);
+    RUN_TEST(test_expand_command_token_matches_describe);
+    RUN_TEST(test_expand_unknown_token);
+    return UNITY_END();
+}
@@ -0,0 +1,197 @@
+#include <unity.h>
+#include <chrono>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+#include "aapDecoder.h"
+
+#pragma region Helpers
+struct decodeLog
+{
+    uint32_t frames = 0;
+    uint32_t errors = 0;
+    aapDecoderError lastError = AAP_ERR_LENGTH;
+    uint8_t lastPayload[AAP_MAX_PAYLOAD] = {0};
+    uint32_t lastLen = 0;
+};
+
+static void onFrame(void *context, const uint8_t *payload, uint32_t len)
+{
+    decodeLog *log = static_cast<decodeLog *>(context);
+    log->frames++;
+    memcpy(log->lastPayload, payload, len);
+    log->lastLen = len;
+}
+
+static void onError(void *context, aapDecoderError error)
+{
+    decodeLog *log = static_cast<decodeLog *>(context);
+    log->errors++;
+    log->lastError = error;
+}
+
+/// @brief Appends a complete 0xFF 0x55 frame around a payload
+static void appendFrame(std::vector<uint8_t> &stream, const uint8_t *payload, uint8_t len)
+{
+    stream.push_back(0xFF);
+    stream.push_back(0x55);
+    stream.push_back(len);
+    stream.insert(stream.end(), payload, payload + len);
+    stream.push_back(aapDecoder::checksum(payload, len));
+}
+
+// L0x04 GetIndexedPlayingTrackTitle for index 42
+static const uint8_t samplePayload[] = {0x04, 0x00, 0x20, 0x00, 0x00, 0x00, 0x2A};
+#pragma endregion
+
+#pragma region Tests
+void setUp() {}
+void tearDown() {}
+
+void test_checksum_matches_protocol()
+{
+    // L0x00 RequestExtendedInterfaceMode : FF 55 02 00 03 FB
+    const uint8_t payload[] = {0x00, 0x03};
+    TEST_ASSERT_EQUAL_HEX8(0xFB, aapDecoder::checksum(payload, sizeof(payload)));
+}
+
+void test_single_frame_in_one_span()
+{
+    decodeLog log;
+    aapDecoder decoder(onFrame, onError, &log, 500);
+    std::vector<uint8_t> stream;
+    appendFrame(stream, samplePayload, sizeof(samplePayload));
+
+    decoder.feed(stream.data(), stream.size(), 0);
+
+    TEST_ASSERT_EQUAL_UINT32(1, log.frames);
+    TEST_ASSERT_EQUAL_UINT32(0, log.errors);
+    TEST_ASSERT_EQUAL_UINT32(sizeof(samplePayload), log.lastLen);
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(samplePayload, log.lastPayload, sizeof(samplePayload));
+}
+
+void test_frame_split_byte_by_byte()
+{
+    decodeLog log;
+    aapDecoder decoder(onFrame, onError, &log, 500);
+    std::vector<uint8_t> stream;
+    appendFrame(stream, samplePayload, sizeof(samplePayload));
+
+    for (size_t i = 0; i < stream.size(); i++)
+        decoder.feed(&stream[i], 1, i);
+
+    TEST_ASSERT_EQUAL_UINT32(1, log.frames);
+    TEST_ASSERT_FALSE(decoder.inFrame());
+}
+
+void test_garbage_between_frames_is_skipped()
+{
+    decodeLog log;
+    aapDecoder decoder(onFrame, onError, &log, 500);
+    std::vector<uint8_t> stream = {0x12, 0xFF, 0x00, 0x55};
+    appendFrame(stream, samplePayload, sizeof(samplePayload));
+    stream.push_back(0xAB);
+    appendFrame(stream, samplePayload, sizeof(samplePayload));
+
+    decoder.feed(stream.data(), stream.size(), 0);
+
+    TEST_ASSERT_EQUAL_UINT32(2, log.frames);
+    TEST_ASSERT_EQUAL_UINT32(0, log.errors);
+}
+
+void test_checksum_mismatch_is_reported()
+{
+    decodeLog log;
+    aapDecoder decoder(onFrame, onError, &log, 500);
+    std::vector<uint8_t> stream;
+    appendFrame(stream, samplePayload, sizeof(samplePayload));
+    stream.back() ^= 0x01;
+
+    decoder.feed(stream.data(), stream.size(), 0);
+
+    TEST_ASSERT_EQUAL_UINT32(0, log.frames);
+    TEST_ASSERT_EQUAL_UINT32(AAP_ERR_CHECKSUM, log.lastError);
+    TEST_ASSERT_EQUAL_UINT32(1, decoder.stats().checksumErrors);
+}
+
+void test_zero_length_is_rejected()
+{
+    decodeLog log;
+    aapDecoder decoder(onFrame, onError, &log, 500);
+    const uint8_t stream[] = {0xFF, 0x55, 0x00, 0x00, 0x04};
+
+    decoder.feed(stream, sizeof(stream), 0);
+
+    TEST_ASSERT_EQUAL_UINT32(0, log.frames);
+    TEST_ASSERT_EQUAL_UINT32(AAP_ERR_LENGTH, log.lastError);
+    TEST_ASSERT_FALSE(decoder.inFrame());
+}
+
+void test_interbyte_timeout_discards_partial_frame()
+{
+    decodeLog log;
+    aapDecoder decoder(onFrame, onError, &log, 500);
+    std::vector<uint8_t> stream;
+    appendFrame(stream, samplePayload, sizeof(samplePayload));
+
+    decoder.feed(stream.data(), 5, 1000);
+    TEST_ASSERT_FALSE(decoder.checkTimeout(1500));
+    TEST_ASSERT_TRUE(decoder.checkTimeout(1501));
+    TEST_ASSERT_EQUAL_UINT32(AAP_ERR_TIMEOUT, log.lastError);
+
+    // A fresh frame decodes normally afterwards
+    decoder.feed(stream.data(), stream.size(), 1600);
+    TEST_ASSERT_EQUAL_UINT32(1, log.frames);
+}
+
+void test_benchmark_throughput()
+{
+    decodeLog log;
+    aapDecoder decoder(onFrame, nullptr, &log, 500);
+
+    // Mix of short control frames and long database records
+    uint8_t longPayload[AAP_MAX_PAYLOAD];
+    for (uint32_t i = 0; i < sizeof(longPayload); i++)
+        longPayload[i] = (uint8_t)(i * 7);
+    std::vector<uint8_t> stream;
+    while (stream.size() < 1024 * 1024)
+    {
+        appendFrame(stream, samplePayload, sizeof(samplePayload));
+        appendFrame(stream, longPayload, 64);
+        appendFrame(stream, longPayload, sizeof(longPayload));
+    }
+    const int passes = 32;
+    const size_t chunk = 128; // Same as RX_CHUNK_SIZE on target
+
+    auto start = std::chrono::steady_clock::now();
+    for (int p = 0; p < passes; p++)
+        for (size_t offset = 0; offset < stream.size(); offset += chunk)
+            decoder.feed(&stream[offset], (stream.size() - offset < chunk) ? stream.size() - offset : chunk, 0);
+    auto stop = std::chrono::steady_clock::now();
+
+    double seconds = std::chrono::duration<double>(stop - start).count();
+    double megaBytes = (double)stream.size() * passes / (1024.0 * 1024.0);
+    char message[128];
+    snprintf(message, sizeof(message), "aapDecoder throughput: %.1f MB/s, %.2f Mframes/s", megaBytes / seconds,
+             log.frames / seconds / 1e6);
+    TEST_MESSAGE(message);
+
+    TEST_ASSERT_EQUAL_UINT32(0, decoder.stats().checksumErrors);
+    TEST_ASSERT_TRUE(log.frames > 0);
+}
+#pragma endregion
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_checksum_matches_protocol);
+    RUN_TEST(test_single_frame_in_one_span);
+    RUN_TEST(test_frame_split_byte_by_byte);
+    RUN_TEST(test_garbage_between_frames_is_skipped);
+    RUN_TEST(test_checksum_mismatch_is_reported);
+    RUN_TEST(test_zero_length_is_rejected);
+    RUN_TEST(test_interbyte_timeout_discards_partial_frame);
+    RUN_TEST(test_benchmark_throughput);
+    return UNITY_END();
+}
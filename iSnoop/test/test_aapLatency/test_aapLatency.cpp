@@ -0,0 +1,150 @@
+#include <unity.h>
+#include <string.h>
+
+#include "aapLatency.h"
+
+#pragma region Helpers
+static void observeFrame(aapLatencyAnalyzer &analyzer, uint8_t channel, uint64_t timestampUs, const uint8_t *payload, uint16_t len)
+{
+    aapCaptureRecord record;
+    record.channel = channel;
+    record.timestampUs = timestampUs;
+    record.length = len;
+    record.payload = payload;
+    analyzer.observe(record);
+}
+
+static const aapLatencyStats *findStats(const aapLatencyAnalyzer &analyzer, uint8_t lingo, uint8_t cmdID)
+{
+    for (uint32_t i = 0; i < analyzer.commandCount(); i++)
+        if (analyzer.command(i).lingo == lingo && analyzer.command(i).cmdID == cmdID)
+            return &analyzer.command(i);
+    return nullptr;
+}
+
+static const uint8_t getPlayStatus[] = {0x04, 0x00, 0x1C};
+static const uint8_t returnPlayStatus[] = {0x04, 0x00, 0x1D, 0, 0, 0, 1, 0, 0, 0, 2, 0x01};
+#pragma endregion
+
+#pragma region Tests
+void setUp() {}
+void tearDown() {}
+
+void test_return_pairs_with_request_on_other_channel()
+{
+    aapLatencyAnalyzer analyzer;
+    observeFrame(analyzer, 1, 1000, getPlayStatus, sizeof(getPlayStatus));
+    observeFrame(analyzer, 2, 4000, returnPlayStatus, sizeof(returnPlayStatus));
+    const aapLatencyStats *stats = findStats(analyzer, 0x04, 0x1C);
+    TEST_ASSERT_NOT_NULL(stats);
+    TEST_ASSERT_EQUAL_UINT32(1, stats->count);
+    TEST_ASSERT_EQUAL_UINT32(3000, stats->maxUs);
+}
+
+void test_reply_on_same_channel_is_not_paired()
+{
+    aapLatencyAnalyzer analyzer;
+    observeFrame(analyzer, 1, 1000, getPlayStatus, sizeof(getPlayStatus));
+    observeFrame(analyzer, 1, 4000, returnPlayStatus, sizeof(returnPlayStatus));
+    const aapLatencyStats *stats = findStats(analyzer, 0x04, 0x1C);
+    TEST_ASSERT_TRUE(stats == nullptr || stats->count == 0);
+}
+
+void test_ack_pairs_and_pending_ack_keeps_waiting()
+{
+    aapLatencyAnalyzer analyzer;
+    const uint8_t setShuffle[] = {0x04, 0x00, 0x2E, 0x01};
+    const uint8_t ackPending[] = {0x04, 0x00, 0x01, 0x06, 0x00, 0x2E};
+    const uint8_t ackOK[] = {0x04, 0x00, 0x01, 0x00, 0x00, 0x2E};
+    observeFrame(analyzer, 2, 0, setShuffle, sizeof(setShuffle));
+    observeFrame(analyzer, 1, 500, ackPending, sizeof(ackPending));
+    observeFrame(analyzer, 1, 900000, ackOK, sizeof(ackOK));
+    const aapLatencyStats *stats = findStats(analyzer, 0x04, 0x2E);
+    TEST_ASSERT_NOT_NULL(stats);
+    TEST_ASSERT_EQUAL_UINT32(1, stats->count);
+    TEST_ASSERT_EQUAL_UINT32(900000, stats->maxUs);
+}
+
+void test_ipod_frames_are_not_requests()
+{
+    aapLatencyAnalyzer analyzer;
+    const uint8_t notification[] = {0x04, 0x00, 0x27, 0x01, 0, 0, 0, 3};
+    const uint8_t playCurrentSelection[] = {0x04, 0x00, 0x28, 0, 0, 0, 3};
+    const uint8_t ackOK[] = {0x04, 0x00, 0x01, 0x00, 0x00, 0x28};
+    observeFrame(analyzer, 2, 0, notification, sizeof(notification));
+    observeFrame(analyzer, 1, 2000, playCurrentSelection, sizeof(playCurrentSelection));
+    observeFrame(analyzer, 2, 5000, ackOK, sizeof(ackOK));
+    observeFrame(analyzer, 2, AAP_LATENCY_TIMEOUT_US + 1, getPlayStatus, sizeof(getPlayStatus));
+    TEST_ASSERT_NULL(findStats(analyzer, 0x04, 0x27));
+    const aapLatencyStats *stats = findStats(analyzer, 0x04, 0x28);
+    TEST_ASSERT_NOT_NULL(stats);
+    TEST_ASSERT_EQUAL_UINT32(1, stats->count);
+    TEST_ASSERT_EQUAL_UINT32(3000, stats->maxUs);
+}
+
+void test_only_the_described_reply_pairs()
+{
+    aapLatencyAnalyzer analyzer;
+    const uint8_t setShuffle[] = {0x04, 0x00, 0x2E, 0x01};
+    const uint8_t getRepeat[] = {0x04, 0x00, 0x2F};
+    observeFrame(analyzer, 1, 0, setShuffle, sizeof(setShuffle));
+    observeFrame(analyzer, 2, 1000, getRepeat, sizeof(getRepeat));
+    const aapLatencyStats *stats = findStats(analyzer, 0x04, 0x2E);
+    TEST_ASSERT_TRUE(stats == nullptr || stats->count == 0);
+}
+
+void test_unanswered_request_expires()
+{
+    aapLatencyAnalyzer analyzer;
+    const uint8_t requestName[] = {0x00, 0x07};
+    observeFrame(analyzer, 1, 0, requestName, sizeof(requestName));
+    observeFrame(analyzer, 1, 1000, requestName, sizeof(requestName));
+    observeFrame(analyzer, 2, AAP_LATENCY_TIMEOUT_US + 1, getPlayStatus, sizeof(getPlayStatus));
+    const aapLatencyStats *stats = findStats(analyzer, 0x00, 0x07);
+    TEST_ASSERT_NOT_NULL(stats);
+    TEST_ASSERT_EQUAL_UINT32(1, stats->retries);
+    TEST_ASSERT_EQUAL_UINT32(1, stats->unanswered);
+    TEST_ASSERT_EQUAL_UINT32(0, stats->count);
+}
+
+void test_buckets_are_contiguous()
+{
+    uint32_t previousUpper = 0;
+    for (uint32_t bucket = 1; bucket < AAP_LATENCY_BUCKETS; bucket++)
+    {
+        uint32_t upper = aapLatencyAnalyzer::bucketUpperUs(bucket);
+        TEST_ASSERT_EQUAL_UINT32(bucket, aapLatencyAnalyzer::bucketOf(previousUpper + 1));
+        TEST_ASSERT_EQUAL_UINT32(bucket, aapLatencyAnalyzer::bucketOf(upper));
+        previousUpper = upper;
+    }
+}
+
+void test_percentiles()
+{
+    aapLatencyStats stats;
+    for (uint32_t i = 1; i <= 100; i++)
+    {
+        uint32_t latencyUs = i * 1000;
+        stats.count++;
+        stats.maxUs = latencyUs;
+        stats.histogram[aapLatencyAnalyzer::bucketOf(latencyUs)]++;
+    }
+    uint32_t p50 = aapLatencyAnalyzer::percentileUs(stats, 50);
+    TEST_ASSERT_TRUE(p50 >= 50000 && p50 <= 50000 * 5 / 4);
+    TEST_ASSERT_EQUAL_UINT32(100000, aapLatencyAnalyzer::percentileUs(stats, 100));
+}
+#pragma endregion
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_return_pairs_with_request_on_other_channel);
+    RUN_TEST(test_reply_on_same_channel_is_not_paired);
+    RUN_TEST(test_ack_pairs_and_pending_ack_keeps_waiting);
+    RUN_TEST(test_ipod_frames_are_not_requests);
+    RUN_TEST(test_only_the_described_reply_pairs);
+    RUN_TEST(test_unanswered_request_expires);
+    RUN_TEST(test_buckets_are_contiguous);
+    RUN_TEST(test_percentiles);
+    return UNITY_END();
+}
@@ -0,0 +1,113 @@
+#include <unity.h>
+#include <string.h>
+#include <vector>
+
+#include "aapMerger.h"
+
+#pragma region Helpers
+struct mergeLog
+{
+    std::vector<uint64_t> timestamps;
+    std::vector<uint8_t> channels;
+    std::vector<uint8_t> firstBytes;
+};
+
+static void onRecord(void *context, const aapCaptureRecord &record)
+{
+    mergeLog *log = static_cast<mergeLog *>(context);
+    log->timestamps.push_back(record.timestampUs);
+    log->channels.push_back(record.channel);
+    log->firstBytes.push_back(record.length > 0 ? record.payload[0] : 0);
+}
+
+static void pushFrame(aapMerger &merger, uint8_t channel, uint64_t timestampUs, uint8_t firstByte = 0x04)
+{
+    uint8_t payload[3] = {firstByte, 0x00, 0x1C};
+    aapCaptureRecord record;
+    record.channel = channel;
+    record.timestampUs = timestampUs;
+    record.length = sizeof(payload);
+    record.payload = payload;
+    TEST_ASSERT_TRUE(merger.push(record));
+}
+#pragma endregion
+
+#pragma region Tests
+void setUp() {}
+void tearDown() {}
+
+void test_interleaves_two_channels_by_timestamp()
+{
+    mergeLog log;
+    aapMerger merger(onRecord, &log, 1000);
+    // Channel 2 is drained late, its records arrive after the younger ones of channel 1
+    pushFrame(merger, 1, 100);
+    pushFrame(merger, 1, 500);
+    pushFrame(merger, 2, 300);
+    pushFrame(merger, 2, 700);
+    TEST_ASSERT_EQUAL_UINT32(4, merger.drain(2000));
+    const uint64_t expected[] = {100, 300, 500, 700};
+    TEST_ASSERT_EQUAL_UINT32(4, log.timestamps.size());
+    for (int i = 0; i < 4; i++)
+        TEST_ASSERT_EQUAL_UINT64(expected[i], log.timestamps[i]);
+    TEST_ASSERT_EQUAL_UINT32(0, merger.stats().late);
+}
+
+void test_holds_records_until_window_closes()
+{
+    mergeLog log;
+    aapMerger merger(onRecord, &log, 1000);
+    pushFrame(merger, 1, 100);
+    pushFrame(merger, 2, 900);
+    TEST_ASSERT_EQUAL_UINT32(0, merger.drain(1099));
+    TEST_ASSERT_EQUAL_UINT32(1, merger.drain(1100));
+    TEST_ASSERT_EQUAL_UINT32(1, merger.depth());
+    TEST_ASSERT_EQUAL_UINT32(1, merger.flush());
+}
+
+void test_equal_timestamps_keep_push_order()
+{
+    mergeLog log;
+    aapMerger merger(onRecord, &log, 0);
+    for (uint8_t i = 0; i < 10; i++)
+        pushFrame(merger, i & 1, 42, i);
+    merger.flush();
+    for (uint8_t i = 0; i < 10; i++)
+        TEST_ASSERT_EQUAL_UINT8(i, log.firstBytes[i]);
+}
+
+void test_late_record_is_counted()
+{
+    mergeLog log;
+    aapMerger merger(onRecord, &log, 100);
+    pushFrame(merger, 1, 1000);
+    merger.drain(2000);
+    pushFrame(merger, 2, 500);
+    merger.drain(2000);
+    TEST_ASSERT_EQUAL_UINT32(1, merger.stats().late);
+    TEST_ASSERT_EQUAL_UINT32(2, merger.stats().emitted);
+}
+
+void test_full_merger_forces_oldest_out()
+{
+    mergeLog log;
+    aapMerger merger(onRecord, &log, 1000000);
+    for (uint32_t i = 0; i < AAP_MERGE_CAPACITY + 5; i++)
+        pushFrame(merger, 1, AAP_MERGE_CAPACITY + 5 - i); // Youngest first
+    TEST_ASSERT_EQUAL_UINT32(5, merger.stats().forced);
+    TEST_ASSERT_EQUAL_UINT32(AAP_MERGE_CAPACITY, merger.depth());
+    merger.flush();
+    TEST_ASSERT_EQUAL_UINT32(AAP_MERGE_CAPACITY + 5, log.timestamps.size());
+}
+#pragma endregion
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_interleaves_two_channels_by_timestamp);
+    RUN_TEST(test_holds_records_until_window_closes);
+    RUN_TEST(test_equal_timestamps_keep_push_order);
+    RUN_TEST(test_late_record_is_counted);
+    RUN_TEST(test_full_merger_forces_oldest_out);
+    return UNITY_END();
+}
@@ -0,0 +1,144 @@
+#include <unity.h>
+#include <chrono>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+#include "aapReplay.h"
+
+#pragma region Helpers
+static uint64_t wallClockUs()
+{
+    return (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+// Simulated clock for the paced replays, sleeping only moves it forward
+static uint64_t fakeNowUs = 0;
+static uint64_t fakeClockUs() { return fakeNowUs; }
+static void fakeSleepUs(uint64_t us) { fakeNowUs += us; }
+
+static void appendRecord(std::vector<uint8_t> &capture, uint8_t channel, uint64_t timestampUs, const uint8_t *payload, uint16_t len)
+{
+    aapCaptureRecord record;
+    record.channel = channel;
+    record.timestampUs = timestampUs;
+    record.length = len;
+    record.payload = payload;
+    uint8_t encoded[AAP_CAPTURE_MAX_RECORD];
+    size_t encodedLen = aapCaptureEncode(record, encoded, sizeof(encoded));
+    capture.insert(capture.end(), encoded, encoded + encodedLen);
+}
+
+/// @brief Typical polling session : GetPlayStatus from the accessory every 500 ms, answered by the iPod 8 ms later
+static std::vector<uint8_t> buildSession(uint32_t exchanges)
+{
+    const uint8_t getPlayStatus[] = {0x04, 0x00, 0x1C};
+    const uint8_t returnPlayStatus[] = {0x04, 0x00, 0x1D, 0x00, 0x00, 0x10, 0x00, 0x00, 0x03, 0x00, 0x00, 0x01};
+    std::vector<uint8_t> capture;
+    for (uint32_t i = 0; i < exchanges; i++)
+    {
+        appendRecord(capture, 1, 500000ULL * i, getPlayStatus, sizeof(getPlayStatus));
+        appendRecord(capture, 2, 500000ULL * i + 8000, returnPlayStatus, sizeof(returnPlayStatus));
+    }
+    return capture;
+}
+#pragma endregion
+
+#pragma region Tests
+void setUp() {}
+void tearDown() {}
+
+void test_replay_runs_every_stage()
+{
+    std::vector<uint8_t> capture = buildSession(10);
+    aapLatencyAnalyzer analyzer;
+    aapReplay::options options;
+    options.nowUs = wallClockUs;
+    options.analyzer = &analyzer;
+    aapReplay replay(options, 500);
+    replay.feed(capture.data(), capture.size());
+
+    TEST_ASSERT_EQUAL_UINT32(20, replay.stats().records);
+    TEST_ASSERT_EQUAL_UINT32(20, replay.stats().frames);
+    TEST_ASSERT_EQUAL_UINT32(20, replay.stats().described);
+    TEST_ASSERT_EQUAL_UINT32(0, replay.stats().decodeErrors);
+    TEST_ASSERT_EQUAL_UINT32(1, analyzer.commandCount());
+    TEST_ASSERT_EQUAL_UINT32(10, analyzer.command(0).count);
+    TEST_ASSERT_EQUAL_UINT32(8000, analyzer.command(0).maxUs);
+}
+
+/// @brief Frames holding the Lingo and nothing or part of the command ID, as a truncated frame on the wire decodes
+void test_lingo_only_frames_are_counted_unknown()
+{
+    const uint8_t lingo0x00Only[] = {0x00};
+    const uint8_t lingo0x04Only[] = {0x04};
+    const uint8_t lingo0x04Half[] = {0x04, 0x00};
+    std::vector<uint8_t> capture = buildSession(2);
+    appendRecord(capture, 1, 1100000, lingo0x00Only, sizeof(lingo0x00Only));
+    appendRecord(capture, 1, 1200000, lingo0x04Only, sizeof(lingo0x04Only));
+    appendRecord(capture, 2, 1300000, lingo0x04Half, sizeof(lingo0x04Half));
+    aapLatencyAnalyzer analyzer;
+    aapReplay::options options;
+    options.nowUs = wallClockUs;
+    options.analyzer = &analyzer;
+    aapReplay replay(options, 500);
+    replay.feed(capture.data(), capture.size());
+
+    TEST_ASSERT_EQUAL_UINT32(7, replay.stats().frames);
+    TEST_ASSERT_EQUAL_UINT32(4, replay.stats().described);
+    TEST_ASSERT_EQUAL_UINT32(3, replay.stats().unknown);
+    TEST_ASSERT_EQUAL_UINT32(0, replay.stats().decodeErrors);
+    TEST_ASSERT_EQUAL_UINT32(1, analyzer.commandCount());
+    TEST_ASSERT_EQUAL_UINT32(2, analyzer.command(0).count);
+}
+
+void test_paced_replay_follows_speed()
+{
+    std::vector<uint8_t> capture = buildSession(5); // Spans 2.008 s
+    fakeNowUs = 0;
+    aapReplay::options options;
+    options.speed = 4;
+    options.nowUs = fakeClockUs;
+    options.sleepUs = fakeSleepUs;
+    aapReplay replay(options, 500);
+    replay.feed(capture.data(), capture.size());
+
+    TEST_ASSERT_EQUAL_UINT64(2008000, replay.stats().captureSpanUs);
+    TEST_ASSERT_EQUAL_UINT64(2008000 / 4, replay.stats().wallUs);
+    TEST_ASSERT_EQUAL_UINT64(2008000 / 4, replay.stats().pacingUs);
+}
+
+void test_benchmark_max_speed()
+{
+    std::vector<uint8_t> capture = buildSession(50000);
+    aapLatencyAnalyzer analyzer;
+    aapReplay::options options;
+    options.nowUs = wallClockUs;
+    options.analyzer = &analyzer;
+    aapReplay replay(options, 500);
+    const size_t chunk = 4096;
+    for (size_t offset = 0; offset < capture.size(); offset += chunk)
+        replay.feed(&capture[offset], (capture.size() - offset < chunk) ? capture.size() - offset : chunk);
+
+    const aapReplayStats &stats = replay.stats();
+    char message[192];
+    snprintf(message, sizeof(message),
+             "aapReplay: %.0f frames/s, %.0fx real time. Per stage : read %llu us, decode %llu us, process %llu us",
+             stats.framesPerSecond(), (double)stats.captureSpanUs / stats.wallUs, (unsigned long long)stats.readUs(),
+             (unsigned long long)stats.decodeUs, (unsigned long long)stats.processUs);
+    TEST_MESSAGE(message);
+    TEST_ASSERT_EQUAL_UINT32(100000, stats.frames);
+}
+#pragma endregion
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_replay_runs_every_stage);
+    RUN_TEST(test_lingo_only_frames_are_counted_unknown);
+    RUN_TEST(test_paced_replay_follows_speed);
+    RUN_TEST(test_benchmark_max_speed);
+    return UNITY_END();
+}
@@ -0,0 +1,161 @@
+// Host-side converter for the iSnoop binary console capture.
+//
+// Record a capture with the serial port in raw mode, e.g.
+//   stty -F /dev/ttyUSB0 921600 raw && cat /dev/ttyUSB0 > capture.bin
+// Build and run from the iSnoop folder :
+//   g++ -std=c++17 -O2 -Ilib/aapCapture -Ilib/aapProtocol -o captureConvert
+//       tools/captureConvert.cpp lib/aapCapture/aapCapture.cpp lib/aapProtocol/aapCommands.cpp
+//       lib/aapProtocol/aapLogTokens.cpp
+//   ./captureConvert capture.bin capture.pcap   (or capture.csv)
+//
+// The pcap output uses LINKTYPE_USER0 (147). Each packet holds Channel (1) | Detect mV (2, BE) followed by the
+// complete AAP frame (0xFF 0x55 | Length | Payload | Checksum), so a Wireshark dissector can be attached to DLT 147.
+// The CSV output decodes the frames with the same command tables as the firmware, and expands the tokenized logs
+// of a TOKENIZED_LOG build with the same format table.
+
+#include <stdio.h>
+#include <string.h>
+
+#include "aapCapture.h"
+#include "aapCommands.h"
+#include "aapLogTokens.h"
+
+#pragma region Output writers
+struct converter
+{
+    FILE *out = nullptr;
+    bool pcap = false;
+    uint32_t frames = 0;
+};
+
+static void writeLE32(FILE *f, uint32_t value)
+{
+    uint8_t bytes[4] = {(uint8_t)value, (uint8_t)(value >> 8), (uint8_t)(value >> 16), (uint8_t)(value >> 24)};
+    fwrite(bytes, 1, sizeof(bytes), f);
+}
+
+static void writeLE16(FILE *f, uint16_t value)
+{
+    uint8_t bytes[2] = {(uint8_t)value, (uint8_t)(value >> 8)};
+    fwrite(bytes, 1, sizeof(bytes), f);
+}
+
+static void writePcapHeader(FILE *f)
+{
+    writeLE32(f, 0xA1B2C3D4); // Microsecond timestamps
+    writeLE16(f, 2);
+    writeLE16(f, 4);
+    writeLE32(f, 0);   // GMT offset
+    writeLE32(f, 0);   // Accuracy
+    writeLE32(f, 65535);
+    writeLE32(f, 147); // LINKTYPE_USER0
+}
+
+static void writePcapFrame(FILE *f, const aapCaptureRecord &record)
+{
+    uint8_t packet[3 + 3 + AAP_CAPTURE_MAX_PAYLOAD + 1];
+    uint32_t len = 0;
+    packet[len++] = record.channel;
+    packet[len++] = (uint8_t)(record.detectMilliVolts >> 8);
+    packet[len++] = (uint8_t)record.detectMilliVolts;
+    packet[len++] = 0xFF;
+    packet[len++] = 0x55;
+    packet[len++] = (uint8_t)record.length;
+    memcpy(&packet[len], record.payload, record.length);
+    len += record.length;
+    uint32_t checksum = record.length;
+    for (uint32_t i = 0; i < record.length; i++)
+        checksum += record.payload[i];
+    packet[len++] = (uint8_t)(0x100 - (checksum & 0xFF));
+
+    writeLE32(f, (uint32_t)(record.timestampUs / 1000000));
+    writeLE32(f, (uint32_t)(record.timestampUs % 1000000));
+    writeLE32(f, len);
+    writeLE32(f, len);
+    fwrite(packet, 1, len, f);
+}
+
+static const char *recordTypeName(uint8_t type)
+{
+    switch (type)
+    {
+    case AAP_CAPTURE_FRAME:
+        return "frame";
+    case AAP_CAPTURE_DETECT:
+        return "detect";
+    case AAP_CAPTURE_LOG:
+        return "log";
+    default:
+        return "unknown";
+    }
+}
+
+static void writeCsvRecord(FILE *f, const aapCaptureRecord &record)
+{
+    fprintf(f, "%llu,%s,%u,%u,%u,", (unsigned long long)record.timestampUs,
+            recordTypeName(record.type), record.channel, record.detectMilliVolts, record.length);
+    for (uint32_t i = 0; i < record.length; i++)
+        fprintf(f, "%02X", record.payload[i]);
+    char description[512] = "";
+    if (record.type == AAP_CAPTURE_FRAME)
+        aapDescribe(record.payload, record.length, description, sizeof(description));
+    else if (record.type == AAP_CAPTURE_LOG && aapExpandLog(record.payload, record.length, description, sizeof(description)) < 0)
+        snprintf(description, sizeof(description), "Unknown log token");
+    // Quotes inside the decoded strings are doubled for CSV
+    fprintf(f, ",\"");
+    for (const char *c = description; *c != '\0'; c++)
+        fprintf(f, (*c == '"') ? "\"\"" : "%c", *c);
+    fprintf(f, "\"\n");
+}
+
+static void onRecord(void *context, const aapCaptureRecord &record)
+{
+    converter *conv = static_cast<converter *>(context);
+    if (record.type == AAP_CAPTURE_FRAME)
+        conv->frames++;
+    if (!conv->pcap)
+        writeCsvRecord(conv->out, record);
+    else if (record.type == AAP_CAPTURE_FRAME) // Detect line windows and logs only go to the CSV
+        writePcapFrame(conv->out, record);
+}
+#pragma endregion
+
+int main(int argc, char **argv)
+{
+    if (argc != 3)
+    {
+        fprintf(stderr, "Usage: %s <capture.bin> <output.pcap|output.csv>\n", argv[0]);
+        return 1;
+    }
+    FILE *in = fopen(argv[1], "rb");
+    if (in == nullptr)
+    {
+        fprintf(stderr, "Cannot open %s\n", argv[1]);
+        return 1;
+    }
+    converter conv;
+    size_t outNameLen = strlen(argv[2]);
+    conv.pcap = outNameLen > 5 && strcmp(argv[2] + outNameLen - 5, ".pcap") == 0;
+    conv.out = fopen(argv[2], "wb");
+    if (conv.out == nullptr)
+    {
+        fprintf(stderr, "Cannot open %s\n", argv[2]);
+        fclose(in);
+        return 1;
+    }
+    if (conv.pcap)
+        writePcapHeader(conv.out);
+    else
+        fprintf(conv.out, "timestamp_us,type,channel,detect_mv,length,payload,decoded\n");
+
+    aapCaptureReader reader(onRecord, &conv);
+    uint8_t chunk[4096];
+    size_t len;
+    while ((len = fread(chunk, 1, sizeof(chunk), in)) > 0)
+        reader.feed(chunk, len);
+
+    fprintf(stderr, "%u frames converted, %u bytes skipped\n", conv.frames, reader.skippedBytes());
+    fclose(in);
+    fclose(conv.out);
+    return 0;
+}
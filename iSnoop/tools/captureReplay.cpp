@@ -0,0 +1,86 @@
+// Host-side replay of an iSnoop binary console capture through the decoder, the command tables and the latency analyzer.
+//
+// Build and run from the iSnoop folder :
+//   g++ -std=c++17 -O2 -Ilib/aapCapture -Ilib/aapDecoder -Ilib/aapProtocol -Ilib/aapLatency -Ilib/aapReplay
+//       -o captureReplay tools/captureReplay.cpp lib/aapReplay/aapReplay.cpp lib/aapLatency/aapLatency.cpp
+//       lib/aapDecoder/aapDecoder.cpp lib/aapCapture/aapCapture.cpp lib/aapProtocol/aapCommands.cpp
+//   ./captureReplay capture.bin [max|1|N] [--wall]
+//
+// "max" (default) replays as fast as possible, 1 at the captured rate, N at N times the captured rate.
+// --wall drives the decoder timeouts from the wall clock instead of the capture timestamps.
+
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+
+#include "aapCommands.h"
+#include "aapReplay.h"
+
+static uint64_t wallClockUs()
+{
+    return (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+static void sleepUs(uint64_t us)
+{
+    std::this_thread::sleep_for(std::chrono::microseconds(us));
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        fprintf(stderr, "Usage: %s <capture.bin> [max|1|N] [--wall]\n", argv[0]);
+        return 1;
+    }
+    aapLatencyAnalyzer analyzer;
+    aapReplay::options options;
+    options.nowUs = wallClockUs;
+    options.sleepUs = sleepUs;
+    options.analyzer = &analyzer;
+    for (int i = 2; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--wall") == 0)
+            options.virtualTime = false;
+        else if (strcmp(argv[i], "max") != 0)
+            options.speed = (uint32_t)strtoul(argv[i], nullptr, 10);
+    }
+
+    FILE *in = fopen(argv[1], "rb");
+    if (in == nullptr)
+    {
+        fprintf(stderr, "Cannot open %s\n", argv[1]);
+        return 1;
+    }
+    aapReplay replay(options, 500); // INTERBYTE_TIMEOUT
+    uint8_t buf[4096];
+    size_t len;
+    while ((len = fread(buf, 1, sizeof(buf), in)) > 0)
+        replay.feed(buf, len);
+    fclose(in);
+
+    const aapReplayStats &stats = replay.stats();
+    printf("%u records, %u frames (%u known, %u unknown), %u decode errors, %u bytes skipped\n", stats.records,
+           stats.frames, stats.described, stats.unknown, stats.decodeErrors, replay.skippedBytes());
+    printf("Captured %.3f s, replayed in %.3f s : %.0f frames/s, max lag %u us\n", stats.captureSpanUs / 1e6,
+           stats.wallUs / 1e6, stats.framesPerSecond(), stats.maxLagUs);
+    printf("Per stage : read %llu us, decode %llu us, process %llu us, pacing %llu us\n",
+           (unsigned long long)stats.readUs(), (unsigned long long)stats.decodeUs, (unsigned long long)stats.processUs,
+           (unsigned long long)stats.pacingUs);
+
+    printf("\nLingo  Cmd   %-36s %8s %10s %10s %10s %8s %10s\n", "Command", "Replies", "p50 us", "p99 us", "max us",
+           "Retries", "Unanswered");
+    for (uint32_t i = 0; i < analyzer.commandCount(); i++)
+    {
+        const aapLatencyStats &command = analyzer.command(i);
+        const aapCommandDescriptor *descriptor = aapFindCommand(command.lingo, command.cmdID);
+        printf("0x%02x   0x%02x  %-36s %8u %10u %10u %10u %8u %10u\n", command.lingo, command.cmdID,
+               (descriptor != nullptr) ? descriptor->name : "?", command.count, aapLatencyAnalyzer::percentileUs(command, 50),
+               aapLatencyAnalyzer::percentileUs(command, 99), command.maxUs, command.retries, command.unanswered);
+    }
+    return 0;
+}
@@ -0,0 +1,70 @@
+#include "bufferProfile.h"
+#include <string.h>
+
+// The I2S output starts with the first write, so the prefill is the delay, split between the DMA and the ring once
+// playing. The DMA must stay under the prefill minus one A2DP packet, and the prefill leaves at least half the ring
+// free for bursts.
+// The packet sets the floor : no prefill goes under one packet plus the DMA, over 23 ms, and the smallest ring that
+// holds twice that is 16 kB. Low-latency sits next to that floor with tiny DMA buffers, balanced fills the 16 kB ring
+// of boards without PSRAM, robust needs PSRAM.
+static constexpr bufferProfile profiles[BUFFER_PROFILE_COUNT] = {
+    {"low-latency", 3, 64, 16384, 5120}, // Target 30 ms : 29 ms at 44.1 kHz, DMA 4.4 ms
+    {"balanced", 6, 128, 16384, 8192},   // Target 50 ms : 46 ms, DMA 17.4 ms
+    {"robust", 8, 256, 65536, 32768},    // Target 200 ms : 186 ms, DMA 46.4 ms. The ring is clamped to 16 kB without PSRAM.
+};
+
+/// @brief Whether a profile is consistent as written, before any clamping to the ring storage
+static constexpr bool profileFits(const bufferProfile &profile)
+{
+    return profile.ringPrefill <= profile.ringSize / 2 &&
+           dmaFitsPrefill(profile.i2sBufferCount * profile.i2sBufferFrames * PCM_FRAME_BYTES, profile.ringPrefill);
+}
+static_assert(profileFits(profiles[BUFFER_PROFILE_LOW_LATENCY]), "Low-latency profile out of its own rules");
+static_assert(profileFits(profiles[BUFFER_PROFILE_BALANCED]), "Balanced profile out of its own rules");
+static_assert(profileFits(profiles[BUFFER_PROFILE_ROBUST]), "Robust profile out of its own rules");
+
+/// @brief Looks up a profile
+/// @param id Profile, out of range ids fall back to the balanced one
+/// @return The profile settings
+const bufferProfile &getBufferProfile(bufferProfileId id)
+{
+    return profiles[(id < BUFFER_PROFILE_COUNT) ? id : BUFFER_PROFILE_BALANCED];
+}
+
+/// @brief Looks up a profile by name
+/// @param name Name of the profile, e.g. "robust"
+/// @param id Set to the profile found
+/// @return false if no profile has that name
+bool findBufferProfile(const char *name, bufferProfileId &id)
+{
+    for (uint8_t i = 0; i < BUFFER_PROFILE_COUNT; i++)
+    {
+        if (strcmp(name, profiles[i].name) == 0)
+        {
+            id = (bufferProfileId)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+/// @brief Fits the ring of a profile in the storage behind it, and keeps the prefill to half the ring
+/// @param storageSize Bytes of ring storage, power of two
+/// @param ringSize Ring size asked for, clamped to the storage
+/// @param prefill Prefill asked for, clamped to half the ring
+/// @return true if either had to be clamped, the delay and the dropout margin are then not the profile ones
+bool clampRingSettings(uint32_t storageSize, uint32_t &ringSize, uint32_t &prefill)
+{
+    bool clamped = false;
+    if (ringSize > storageSize)
+    {
+        ringSize = storageSize;
+        clamped = true;
+    }
+    if (prefill > ringSize / 2)
+    {
+        prefill = ringSize / 2;
+        clamped = true;
+    }
+    return clamped;
+}
@@ -0,0 +1,43 @@
+#pragma once
+#include <stdint.h>
+#include "pcmRing.h"
+
+// Bytes of one A2DP packet as the stack hands it over, 1024 frames or about 23 ms at 44.1 kHz
+#define A2DP_PACKET_BYTES 4096
+
+/// @brief Named trade-offs between delay and dropout resistance of the audio path
+enum bufferProfileId : uint8_t
+{
+    BUFFER_PROFILE_LOW_LATENCY = 0, // Short delay, e.g. for navigation prompts, needs a clean RF link
+    BUFFER_PROFILE_BALANCED,        // Default
+    BUFFER_PROFILE_ROBUST,          // Rides through long RF stalls, at the cost of a noticeable delay
+    BUFFER_PROFILE_COUNT
+};
+
+/// @brief Sizes of the buffers between the A2DP stack and the DAC. The I2S DMA buffer size is in frames, as
+/// arduino-audio-tools hands it to the ESP32 driver, and stays under the 4092 bytes of a DMA descriptor.
+struct bufferProfile
+{
+    const char *name;
+    uint16_t i2sBufferCount;  // DMA buffers
+    uint16_t i2sBufferFrames; // Frames per DMA buffer
+    uint32_t ringSize;        // PCM ring, bytes, power of two. Clamped to the ring storage.
+    uint32_t ringPrefill;     // Level the writer waits for, bytes, sets the delay. At most half the ring.
+};
+
+const bufferProfile &getBufferProfile(bufferProfileId id);
+bool findBufferProfile(const char *name, bufferProfileId &id);
+bool clampRingSettings(uint32_t storageSize, uint32_t &ringSize, uint32_t &prefill);
+
+/// @brief Whether the DMA buffers stay under the prefill minus one A2DP packet. Past that, the writer empties the ring
+/// into the DMA between two packets, and the ring primes again while the DMA runs dry.
+constexpr bool dmaFitsPrefill(uint32_t dmaBytes, uint32_t prefill)
+{
+    return prefill > A2DP_PACKET_BYTES && dmaBytes < prefill - A2DP_PACKET_BYTES;
+}
+
+/// @brief Converts bytes of stereo 16-bit PCM to milliseconds of audio
+inline uint32_t pcmBytesToMs(uint32_t bytes, uint32_t sampleRate)
+{
+    return sampleRate ? (uint32_t)((uint64_t)bytes * 1000 / ((uint64_t)sampleRate * PCM_FRAME_BYTES)) : 0;
+}
@@ -0,0 +1,76 @@
+#include "metadataRing.h"
+#include <string.h>
+
+/// @brief Copies an attribute in the next slot. Producer side, never blocks nor allocates.
+/// @param id Metadata attribute ID : ESP_AVRC_MD_ATTR_xxx
+/// @param text Null-terminated text of the attribute
+/// @return false if the oldest entry had to be overwritten to make room
+bool metadataRing::push(uint8_t id, const char *text)
+{
+    bool overwrite = false;
+    uint32_t head = _head.load(std::memory_order_relaxed);
+    uint32_t tail = _tail.load(std::memory_order_acquire);
+    if (head - tail == METADATA_RING_SIZE)
+    {
+        // Full : take the oldest slot back, unless the consumer has just freed it
+        if (_tail.compare_exchange_strong(tail, tail + 1, std::memory_order_acq_rel))
+        {
+            overwrite = true;
+            _overwritten.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    metadataEntry &slot = _slots[head & (METADATA_RING_SIZE - 1)];
+    size_t length = strnlen(text, METADATA_TEXT_SIZE);
+    if (length == METADATA_TEXT_SIZE)
+    {
+        // Cut before the character that does not fit, not in the middle of it
+        length = METADATA_TEXT_SIZE - 1;
+        while (length > 0 && ((uint8_t)text[length] & 0xC0) == 0x80)
+            length--;
+        _truncated.fetch_add(1, std::memory_order_relaxed);
+    }
+    slot.id = id;
+    slot.length = (uint16_t)length;
+    memcpy(slot.text, text, length);
+    slot.text[length] = '\0';
+
+    _head.store(head + 1, std::memory_order_release);
+    _pushed.fetch_add(1, std::memory_order_relaxed);
+    return !overwrite;
+}
+
+/// @brief Copies the oldest entry out of the ring. Consumer side, never blocks.
+/// @param entry Filled with the oldest entry
+/// @return false if the ring is empty
+bool metadataRing::pop(metadataEntry &entry)
+{
+    uint32_t tail = _tail.load(std::memory_order_acquire);
+    while (tail != _head.load(std::memory_order_acquire))
+    {
+        const metadataEntry &slot = _slots[tail & (METADATA_RING_SIZE - 1)];
+        entry.id = slot.id;
+        entry.length = slot.length < METADATA_TEXT_SIZE ? slot.length : METADATA_TEXT_SIZE - 1;
+        memcpy(entry.text, slot.text, entry.length);
+        entry.text[entry.length] = '\0';
+        // If the producer took this slot back meanwhile, the copy may be torn : drop it and read the new oldest
+        if (_tail.compare_exchange_strong(tail, tail + 1, std::memory_order_acq_rel))
+        {
+            _popped.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+    return false;
+}
+
+/// @brief Snapshot of the counters
+/// @return Counters since startup
+metadataRingStats metadataRing::stats() const
+{
+    metadataRingStats snapshot;
+    snapshot.pushed = _pushed.load(std::memory_order_relaxed);
+    snapshot.popped = _popped.load(std::memory_order_relaxed);
+    snapshot.overwritten = _overwritten.load(std::memory_order_relaxed);
+    snapshot.truncated = _truncated.load(std::memory_order_relaxed);
+    return snapshot;
+}
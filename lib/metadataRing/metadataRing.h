@@ -0,0 +1,58 @@
+#pragma once
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+// Number of slots, must be a power of two
+#ifndef METADATA_RING_SIZE
+#define METADATA_RING_SIZE 16
+#endif
+// Longest attribute kept, terminator included. Longer texts are cut on a UTF-8 character boundary.
+#ifndef METADATA_TEXT_SIZE
+#define METADATA_TEXT_SIZE 128
+#endif
+
+static_assert((METADATA_RING_SIZE & (METADATA_RING_SIZE - 1)) == 0, "METADATA_RING_SIZE must be a power of two");
+
+/// @brief One AVRC metadata attribute, with its text stored inline
+struct metadataEntry
+{
+    uint8_t id = 0;      // ESP_AVRC_MD_ATTR_xxx
+    uint16_t length = 0; // Length of text, without the terminator
+    char text[METADATA_TEXT_SIZE] = {0};
+};
+
+/// @brief Traffic through the metadata ring since boot. What is still queued is pushed - popped - overwritten.
+struct metadataRingStats
+{
+    uint32_t pushed = 0;      // Entries written by the producer
+    uint32_t popped = 0;      // Entries handed to the consumer
+    uint32_t overwritten = 0; // Oldest entries dropped to make room for a newer one
+    uint32_t truncated = 0;   // Texts cut to METADATA_TEXT_SIZE
+};
+
+/// @brief Lock-free single-producer/single-consumer ring of preallocated metadata slots, so that the AVRC callback
+/// never touches the heap. When full, the oldest entry is overwritten : the latest metadata is what the head unit
+/// must see. The producer takes the oldest slot back by moving the tail itself, and a consumer that was copying that
+/// slot notices it on its own tail update and discards the copy.
+class metadataRing
+{
+private:
+    metadataEntry _slots[METADATA_RING_SIZE];
+    std::atomic<uint32_t> _head{0}; // Next slot written, producer only
+    std::atomic<uint32_t> _tail{0}; // Next slot read, consumer, or producer when full
+
+    // Statistics : the producer counts pushes, overwrites and truncations, the consumer counts pops
+    std::atomic<uint32_t> _pushed{0};
+    std::atomic<uint32_t> _popped{0};
+    std::atomic<uint32_t> _overwritten{0};
+    std::atomic<uint32_t> _truncated{0};
+
+public:
+    bool push(uint8_t id, const char *text);
+    bool pop(metadataEntry &entry);
+
+    uint32_t capacity() const { return METADATA_RING_SIZE; }
+    uint32_t size() const { return _head.load(std::memory_order_acquire) - _tail.load(std::memory_order_acquire); }
+    metadataRingStats stats() const;
+};
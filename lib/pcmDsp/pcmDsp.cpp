@@ -0,0 +1,378 @@
+#include "pcmDsp.h"
+#include <math.h>
+
+//-----------------------------------------------------------------------
+//|                          Reference kernels                          |
+//-----------------------------------------------------------------------
+#pragma region Reference kernels
+/// @brief Clamps to the int16_t range
+static int16_t saturateRef(int32_t value)
+{
+    if (value > 32767)
+        return 32767;
+    if (value < -32768)
+        return -32768;
+    return (int16_t)value;
+}
+
+/// @brief Multiplies every sample by a Q12 gain, rounded to nearest and saturated
+/// @param samples Samples, processed in place
+/// @param count Number of samples, all channels included
+/// @param gainQ12 Gain, DSP_UNITY_GAIN is 0 dB
+void dspGainRef(int16_t *samples, uint32_t count, int32_t gainQ12)
+{
+    for (uint32_t i = 0; i < count; i++)
+        samples[i] = saturateRef(((int32_t)samples[i] * gainQ12 + (1 << (DSP_GAIN_SHIFT - 1))) >> DSP_GAIN_SHIFT);
+}
+
+/// @brief Direct Form I biquad on interleaved stereo, 64-bit accumulator, output rounded down with the dropped fraction
+/// fed into the next output, then saturated
+/// @param samples Interleaved stereo samples, processed in place
+/// @param frames Number of frames
+/// @param coeffs Q28 coefficients
+/// @param state History of the left and right channels
+void dspBiquadRef(int16_t *samples, uint32_t frames, const dspBiquadCoeffs &coeffs, dspBiquadState state[2])
+{
+    for (uint32_t frame = 0; frame < frames; frame++)
+    {
+        for (uint32_t channel = 0; channel < 2; channel++)
+        {
+            dspBiquadState &history = state[channel];
+            int32_t x = samples[2 * frame + channel];
+            int64_t acc = (int64_t)coeffs.b0 * x + (int64_t)coeffs.b1 * history.x1 + (int64_t)coeffs.b2 * history.x2 -
+                          (int64_t)coeffs.a1 * history.y1 - (int64_t)coeffs.a2 * history.y2 + history.error;
+            int64_t rounded = acc >> DSP_BIQUAD_SHIFT;
+            history.error = (int32_t)(acc - (rounded << DSP_BIQUAD_SHIFT));
+            int32_t y = saturateRef((int32_t)rounded);
+            history.x2 = history.x1;
+            history.x1 = x;
+            history.y2 = history.y1;
+            history.y1 = y;
+            samples[2 * frame + channel] = (int16_t)y;
+        }
+    }
+}
+
+/// @brief Peak limiter on one block : the gain target is what brings the block peak to the threshold, or else the gain
+/// raised by a fraction of the gap to unity. The gain ramps linearly from the previous target to the new one over the
+/// block, is applied rounded toward zero, and the result is clipped to the threshold.
+/// @param samples Interleaved stereo samples, processed in place
+/// @param frames Number of frames in the block
+/// @param limiter Settings and gain carried over from the previous block
+void dspLimiterRef(int16_t *samples, uint32_t frames, dspLimiterState &limiter)
+{
+    if (frames == 0)
+        return;
+    int32_t peak = 0;
+    for (uint32_t i = 0; i < 2 * frames; i++)
+    {
+        int32_t magnitude = samples[i] < 0 ? -(int32_t)samples[i] : samples[i];
+        if (magnitude > peak)
+            peak = magnitude;
+    }
+    int32_t target = DSP_LIMITER_UNITY;
+    if (peak > limiter.thresholdQ15)
+        target = (int32_t)(((int64_t)limiter.thresholdQ15 << DSP_LIMITER_SHIFT) / peak);
+    int32_t from = limiter.gainQ15;
+    if (target < limiter.gainQ15)
+        limiter.gainQ15 = target;
+    else
+        limiter.gainQ15 += ((target - limiter.gainQ15) * limiter.releaseQ15) >> DSP_LIMITER_SHIFT;
+
+    // Ramp in Q30, so that short steps are not lost
+    int64_t step = ((int64_t)(limiter.gainQ15 - from) << DSP_LIMITER_SHIFT) / frames;
+    int64_t ramp = (int64_t)from << DSP_LIMITER_SHIFT;
+    for (uint32_t frame = 0; frame < frames; frame++)
+    {
+        ramp += step;
+        int32_t gain = (int32_t)(ramp >> DSP_LIMITER_SHIFT);
+        for (uint32_t channel = 0; channel < 2; channel++)
+        {
+            int32_t value = ((int32_t)samples[2 * frame + channel] * gain) / DSP_LIMITER_UNITY;
+            if (value > limiter.thresholdQ15)
+                value = limiter.thresholdQ15;
+            if (value < -limiter.thresholdQ15)
+                value = -limiter.thresholdQ15;
+            samples[2 * frame + channel] = (int16_t)value;
+        }
+    }
+}
+#pragma endregion
+
+//-----------------------------------------------------------------------
+//|                         Production kernels                          |
+//-----------------------------------------------------------------------
+#pragma region Production kernels
+/// @brief Clamps to the int16_t range, written as min/max so that it stays branch-free
+static inline int32_t saturate(int32_t value)
+{
+    value = value < -32768 ? -32768 : value;
+    return value > 32767 ? 32767 : value;
+}
+
+/// @brief Same as dspGainRef
+void dspGain(int16_t *__restrict samples, uint32_t count, int32_t gainQ12)
+{
+    const int32_t round = 1 << (DSP_GAIN_SHIFT - 1);
+    for (uint32_t i = 0; i < count; i++)
+        samples[i] = (int16_t)saturate(((int32_t)samples[i] * gainQ12 + round) >> DSP_GAIN_SHIFT);
+}
+
+/// @brief Same as dspBiquadRef. The recursion forbids vectorizing along time, so both channels are run side by side
+/// on a history held in locals, written back once per call.
+void dspBiquad(int16_t *__restrict samples, uint32_t frames, const dspBiquadCoeffs &coeffs, dspBiquadState state[2])
+{
+    const int64_t b0 = coeffs.b0, b1 = coeffs.b1, b2 = coeffs.b2, a1 = coeffs.a1, a2 = coeffs.a2;
+    const int64_t fraction = (1LL << DSP_BIQUAD_SHIFT) - 1;
+    int32_t lx1 = state[0].x1, lx2 = state[0].x2, ly1 = state[0].y1, ly2 = state[0].y2;
+    int32_t rx1 = state[1].x1, rx2 = state[1].x2, ry1 = state[1].y1, ry2 = state[1].y2;
+    int64_t le = state[0].error, re = state[1].error;
+
+    for (uint32_t frame = 0; frame < frames; frame++)
+    {
+        int32_t lx = samples[2 * frame];
+        int32_t rx = samples[2 * frame + 1];
+        int64_t lacc = b0 * lx + b1 * lx1 + b2 * lx2 - a1 * ly1 - a2 * ly2 + le;
+        int64_t racc = b0 * rx + b1 * rx1 + b2 * rx2 - a1 * ry1 - a2 * ry2 + re;
+        le = lacc & fraction;
+        re = racc & fraction;
+        int32_t ly = saturate((int32_t)(lacc >> DSP_BIQUAD_SHIFT));
+        int32_t ry = saturate((int32_t)(racc >> DSP_BIQUAD_SHIFT));
+        lx2 = lx1;
+        lx1 = lx;
+        ly2 = ly1;
+        ly1 = ly;
+        rx2 = rx1;
+        rx1 = rx;
+        ry2 = ry1;
+        ry1 = ry;
+        samples[2 * frame] = (int16_t)ly;
+        samples[2 * frame + 1] = (int16_t)ry;
+    }
+
+    state[0].x1 = lx1, state[0].x2 = lx2, state[0].y1 = ly1, state[0].y2 = ly2, state[0].error = (int32_t)le;
+    state[1].x1 = rx1, state[1].x2 = rx2, state[1].y1 = ry1, state[1].y2 = ry2, state[1].error = (int32_t)re;
+}
+
+/// @brief Same as dspLimiterRef, with a branch-free peak search and a separate apply loop
+void dspLimiter(int16_t *__restrict samples, uint32_t frames, dspLimiterState &limiter)
+{
+    if (frames == 0)
+        return;
+    const uint32_t count = 2 * frames;
+    int32_t peak = 0;
+    for (uint32_t i = 0; i < count; i++)
+    {
+        int32_t magnitude = samples[i] < 0 ? -(int32_t)samples[i] : (int32_t)samples[i];
+        peak = magnitude > peak ? magnitude : peak;
+    }
+    const int32_t from = limiter.gainQ15;
+    const int32_t threshold = limiter.thresholdQ15;
+    int32_t gain = from;
+    int32_t target = DSP_LIMITER_UNITY;
+    if (peak > threshold)
+        target = (int32_t)(((int64_t)threshold << DSP_LIMITER_SHIFT) / peak);
+    if (target < gain)
+        gain = target;
+    else
+        gain += ((target - gain) * limiter.releaseQ15) >> DSP_LIMITER_SHIFT;
+    limiter.gainQ15 = gain;
+    if (from == DSP_LIMITER_UNITY && gain == DSP_LIMITER_UNITY)
+        return; // Unity all along, and then the peak is under the threshold : nothing changes
+
+    const int64_t step = ((int64_t)(gain - from) << DSP_LIMITER_SHIFT) / frames;
+    int64_t ramp = (int64_t)from << DSP_LIMITER_SHIFT;
+    for (uint32_t frame = 0; frame < frames; frame++)
+    {
+        ramp += step;
+        const int32_t frameGain = (int32_t)(ramp >> DSP_LIMITER_SHIFT);
+        int32_t left = ((int32_t)samples[2 * frame] * frameGain) / DSP_LIMITER_UNITY;
+        int32_t right = ((int32_t)samples[2 * frame + 1] * frameGain) / DSP_LIMITER_UNITY;
+        left = left > threshold ? threshold : (left < -threshold ? -threshold : left);
+        right = right > threshold ? threshold : (right < -threshold ? -threshold : right);
+        samples[2 * frame] = (int16_t)left;
+        samples[2 * frame + 1] = (int16_t)right;
+    }
+}
+#pragma endregion
+
+//-----------------------------------------------------------------------
+//|                               Stage                                 |
+//-----------------------------------------------------------------------
+#pragma region Stage
+/// @brief Computes the Q28 coefficients of an Audio EQ Cookbook biquad
+/// @param type Shape, DSP_BAND_OFF gives the identity
+/// @param sampleRate Sample rate, in Hz
+/// @param frequency Center or corner frequency, in Hz
+/// @param q Quality factor
+/// @param gainDb Gain at the center frequency, or of the shelf
+/// @return Coefficients, a0 normalized to 1. The identity if a coefficient does not fit, past about +18 dB.
+dspBiquadCoeffs pcmDsp::designBiquad(dspBandType type, uint32_t sampleRate, float frequency, float q, float gainDb)
+{
+    dspBiquadCoeffs coeffs;
+    if (type == DSP_BAND_OFF || sampleRate == 0 || q <= 0.0f || frequency <= 0.0f || frequency >= sampleRate / 2.0f)
+        return coeffs;
+
+    double a = pow(10.0, gainDb / 40.0);
+    double w0 = 2.0 * M_PI * frequency / sampleRate;
+    double cosW0 = cos(w0);
+    double alpha = sin(w0) / (2.0 * q);
+    double twoSqrtAAlpha = 2.0 * sqrt(a) * alpha;
+    double b0, b1, b2, a0, a1, a2;
+    switch (type)
+    {
+    case DSP_BAND_LOW_SHELF:
+        b0 = a * ((a + 1) - (a - 1) * cosW0 + twoSqrtAAlpha);
+        b1 = 2 * a * ((a - 1) - (a + 1) * cosW0);
+        b2 = a * ((a + 1) - (a - 1) * cosW0 - twoSqrtAAlpha);
+        a0 = (a + 1) + (a - 1) * cosW0 + twoSqrtAAlpha;
+        a1 = -2 * ((a - 1) + (a + 1) * cosW0);
+        a2 = (a + 1) + (a - 1) * cosW0 - twoSqrtAAlpha;
+        break;
+    case DSP_BAND_HIGH_SHELF:
+        b0 = a * ((a + 1) + (a - 1) * cosW0 + twoSqrtAAlpha);
+        b1 = -2 * a * ((a - 1) + (a + 1) * cosW0);
+        b2 = a * ((a + 1) + (a - 1) * cosW0 - twoSqrtAAlpha);
+        a0 = (a + 1) - (a - 1) * cosW0 + twoSqrtAAlpha;
+        a1 = 2 * ((a - 1) - (a + 1) * cosW0);
+        a2 = (a + 1) - (a - 1) * cosW0 - twoSqrtAAlpha;
+        break;
+    default: // DSP_BAND_PEAKING
+        b0 = 1 + alpha * a;
+        b1 = -2 * cosW0;
+        b2 = 1 - alpha * a;
+        a0 = 1 + alpha / a;
+        a1 = -2 * cosW0;
+        a2 = 1 - alpha / a;
+        break;
+    }
+    const double scale = (double)(1LL << DSP_BIQUAD_SHIFT) / a0;
+    const double limit = (double)INT32_MAX;
+    if (fabs(b0 * scale) > limit || fabs(b1 * scale) > limit || fabs(b2 * scale) > limit || fabs(a1 * scale) > limit ||
+        fabs(a2 * scale) > limit)
+        return coeffs;
+    coeffs.b0 = (int32_t)lround(b0 * scale);
+    coeffs.b1 = (int32_t)lround(b1 * scale);
+    coeffs.b2 = (int32_t)lround(b2 * scale);
+    coeffs.a1 = (int32_t)lround(a1 * scale);
+    coeffs.a2 = (int32_t)lround(a2 * scale);
+    return coeffs;
+}
+
+/// @brief Recomputes the coefficients of a band for the current sample rate
+void pcmDsp::_updateBand(band &target)
+{
+    target.coeffs = designBiquad(target.type, _sampleRate, target.frequency, target.q, target.gainDb);
+}
+
+/// @brief Recomputes the per-block release of the limiter for the current sample rate
+void pcmDsp::_updateLimiterRelease()
+{
+    if (_limiterReleaseMs <= 0.0f)
+    {
+        _limiter.releaseQ15 = DSP_LIMITER_UNITY; // Back to unity after every block
+        return;
+    }
+    double blockMs = 1000.0 * PCM_DSP_BLOCK_FRAMES / _sampleRate;
+    _limiter.releaseQ15 = (int32_t)lround((1.0 - exp(-blockMs / _limiterReleaseMs)) * DSP_LIMITER_UNITY);
+}
+
+/// @brief Changes the sample rate the filters and the limiter release are designed for. The history is cleared.
+/// @param sampleRate New sample rate, in Hz
+void pcmDsp::setSampleRate(uint32_t sampleRate)
+{
+    if (sampleRate == 0)
+        return;
+    _sampleRate = sampleRate;
+    for (band &target : _bands)
+        _updateBand(target);
+    _updateLimiterRelease();
+    reset();
+}
+
+/// @brief Sets the gain applied before the equalizer. Use a negative gain as headroom for equalizer boosts.
+/// @param gainDb Gain, clamped to +18 dB
+void pcmDsp::setGainDb(float gainDb)
+{
+    double gain = pow(10.0, gainDb / 20.0) * DSP_UNITY_GAIN;
+    _gainQ12 = (gain > 32767.0) ? 32767 : (int32_t)lround(gain);
+}
+
+/// @brief Sets one equalizer band
+/// @param index Band, below PCM_DSP_MAX_BANDS
+/// @param type Shape, DSP_BAND_OFF disables the band
+/// @param frequency Center or corner frequency, in Hz
+/// @param q Quality factor, 0.707 for a Butterworth shelf
+/// @param gainDb Gain of the band
+/// @return false if the index is out of range
+bool pcmDsp::setBand(uint8_t index, dspBandType type, float frequency, float q, float gainDb)
+{
+    if (index >= PCM_DSP_MAX_BANDS)
+        return false;
+    band &target = _bands[index];
+    target.type = type;
+    target.frequency = frequency;
+    target.q = q;
+    target.gainDb = gainDb;
+    target.state[0] = dspBiquadState();
+    target.state[1] = dspBiquadState();
+    _updateBand(target);
+    return true;
+}
+
+/// @brief Sets the peak limiter
+/// @param thresholdDb Highest output level, in dBFS. 0 disables the limiter.
+/// @param releaseMs Time constant of the gain recovery
+void pcmDsp::setLimiter(float thresholdDb, float releaseMs)
+{
+    double threshold = pow(10.0, thresholdDb / 20.0) * 32767.0;
+    _limiter.thresholdQ15 = (threshold >= 32767.0) ? 32767 : (int32_t)lround(threshold);
+    _limiterReleaseMs = releaseMs;
+    _updateLimiterRelease();
+}
+
+/// @brief Clears the filter history and the limiter gain, e.g. between two streams
+void pcmDsp::reset()
+{
+    for (band &target : _bands)
+    {
+        target.state[0] = dspBiquadState();
+        target.state[1] = dspBiquadState();
+    }
+    _limiter.gainQ15 = DSP_LIMITER_UNITY;
+}
+
+/// @brief Runs the stage in place. Stages left neutral are skipped.
+/// @param samples Interleaved 16-bit stereo samples
+/// @param frames Number of frames
+void pcmDsp::process(int16_t *samples, uint32_t frames)
+{
+    uint32_t start = _cycles ? _cycles() : 0;
+
+    if (_gainQ12 != DSP_UNITY_GAIN)
+        dspGain(samples, 2 * frames, _gainQ12);
+    for (band &target : _bands)
+    {
+        if (target.type != DSP_BAND_OFF)
+            dspBiquad(samples, frames, target.coeffs, target.state);
+    }
+    if (_limiter.thresholdQ15 < 32767)
+    {
+        for (uint32_t offset = 0; offset < frames; offset += PCM_DSP_BLOCK_FRAMES)
+        {
+            uint32_t blockFrames = (frames - offset < PCM_DSP_BLOCK_FRAMES) ? frames - offset : PCM_DSP_BLOCK_FRAMES;
+            dspLimiter(samples + 2 * offset, blockFrames, _limiter);
+        }
+    }
+
+    if (_cycles)
+    {
+        uint32_t cycles = _cycles() - start;
+        _cost.blocks++;
+        _cost.frames += frames;
+        _cost.cycles += cycles;
+        if (frames > 0 && cycles / frames > _cost.peakCyclesPerFrame)
+            _cost.peakCyclesPerFrame = cycles / frames;
+    }
+}
+#pragma endregion
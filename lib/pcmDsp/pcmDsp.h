@@ -0,0 +1,133 @@
+#pragma once
+#include <stdint.h>
+
+// Equalizer bands per stage
+#ifndef PCM_DSP_MAX_BANDS
+#define PCM_DSP_MAX_BANDS 4
+#endif
+// The limiter gain target is updated once per block of that many frames, and ramped to across the block
+#ifndef PCM_DSP_BLOCK_FRAMES
+#define PCM_DSP_BLOCK_FRAMES 64
+#endif
+
+// Fixed-point formats : gain in Q12 (up to +18 dB), biquad coefficients in Q28, limiter gain in Q15.
+// Q28 keeps 1 + a1 + a2 exact enough for low shelves, which sits around 1e-4 at 50 Hz, and covers coefficients up to 8.
+#define DSP_GAIN_SHIFT 12
+#define DSP_BIQUAD_SHIFT 28
+#define DSP_LIMITER_SHIFT 15
+#define DSP_UNITY_GAIN (1 << DSP_GAIN_SHIFT)
+#define DSP_LIMITER_UNITY (1 << DSP_LIMITER_SHIFT)
+
+/// @brief Biquad shapes, from the Audio EQ Cookbook
+enum dspBandType : uint8_t
+{
+    DSP_BAND_OFF = 0,
+    DSP_BAND_PEAKING,
+    DSP_BAND_LOW_SHELF,
+    DSP_BAND_HIGH_SHELF
+};
+
+/// @brief Biquad coefficients in Q28, a0 normalized to 1
+struct dspBiquadCoeffs
+{
+    int32_t b0 = 1 << DSP_BIQUAD_SHIFT;
+    int32_t b1 = 0;
+    int32_t b2 = 0;
+    int32_t a1 = 0;
+    int32_t a2 = 0;
+};
+
+/// @brief Direct Form I history of one channel, outputs are kept as saturated samples. The part of the accumulator
+/// dropped when rounding an output is added to the next one (first-order error feedback), which keeps the rounding
+/// noise from being amplified by the poles close to DC of a low shelf.
+struct dspBiquadState
+{
+    int32_t x1 = 0;
+    int32_t x2 = 0;
+    int32_t y1 = 0;
+    int32_t y2 = 0;
+    int32_t error = 0; // Fraction dropped from the last output, in Q28
+};
+
+/// @brief Peak limiter settings and state. The gain target is computed from the peak of each block, and recovers by a
+/// fraction of the gap to unity after every block. The gain ramps from one target to the next across the block rather
+/// than stepping, and the samples the ramp lets through above the threshold are clipped to it.
+struct dspLimiterState
+{
+    int32_t thresholdQ15 = 32767; // Linear amplitude
+    int32_t releaseQ15 = 0;       // Fraction of the gap to unity closed after each block
+    int32_t gainQ15 = DSP_LIMITER_UNITY;
+};
+
+/// @brief Cost counters of the stage, from the cycle counter passed to the constructor
+struct pcmDspCost
+{
+    uint32_t blocks = 0;
+    uint32_t frames = 0;
+    uint64_t cycles = 0;
+    uint32_t peakCyclesPerFrame = 0;
+
+    uint32_t averageCyclesPerFrame() const { return frames ? (uint32_t)(cycles / frames) : 0; }
+};
+
+// Reference kernels, one sample at a time. Slow on purpose, they define the expected output bit for bit.
+void dspGainRef(int16_t *samples, uint32_t count, int32_t gainQ12);
+void dspBiquadRef(int16_t *samples, uint32_t frames, const dspBiquadCoeffs &coeffs, dspBiquadState state[2]);
+void dspLimiterRef(int16_t *samples, uint32_t frames, dspLimiterState &limiter);
+
+// Production kernels on interleaved stereo, bit-exact with the reference ones. Written as branch-free loops over
+// local copies of the state, so that the compiler keeps everything in registers and vectorizes where it can.
+void dspGain(int16_t *__restrict samples, uint32_t count, int32_t gainQ12);
+void dspBiquad(int16_t *__restrict samples, uint32_t frames, const dspBiquadCoeffs &coeffs, dspBiquadState state[2]);
+void dspLimiter(int16_t *__restrict samples, uint32_t frames, dspLimiterState &limiter);
+
+/// @brief Fixed-point processing stage for interleaved 16-bit stereo : gain, then up to PCM_DSP_MAX_BANDS equalizer
+/// biquads, then a peak limiter. Settings are given in dB and Hz and converted once, the per-sample path is integer
+/// only. Not thread-safe, settings must be changed from the task calling process().
+class pcmDsp
+{
+public:
+    typedef uint32_t (*cycleCounter)();
+
+private:
+    cycleCounter _cycles;
+    uint32_t _sampleRate = 44100;
+
+    int32_t _gainQ12 = DSP_UNITY_GAIN;
+
+    struct band
+    {
+        dspBandType type = DSP_BAND_OFF;
+        float frequency = 1000.0f;
+        float q = 0.707f;
+        float gainDb = 0.0f;
+        dspBiquadCoeffs coeffs;
+        dspBiquadState state[2];
+    } _bands[PCM_DSP_MAX_BANDS];
+
+    dspLimiterState _limiter;
+    float _limiterReleaseMs = 0.0f;
+
+    pcmDspCost _cost;
+
+    void _updateBand(band &target);
+    void _updateLimiterRelease();
+
+public:
+    explicit pcmDsp(cycleCounter cycles = nullptr) : _cycles(cycles) {}
+
+    void setSampleRate(uint32_t sampleRate);
+    void setGainDb(float gainDb);
+    bool setBand(uint8_t index, dspBandType type, float frequency, float q, float gainDb);
+    void setLimiter(float thresholdDb, float releaseMs);
+    void reset();
+
+    void process(int16_t *samples, uint32_t frames);
+
+    uint32_t sampleRate() const { return _sampleRate; }
+    int32_t limiterGainQ15() const { return _limiter.gainQ15; }
+    const pcmDspCost &cost() const { return _cost; }
+    void resetCost() { _cost = pcmDspCost(); }
+
+    static dspBiquadCoeffs designBiquad(dspBandType type, uint32_t sampleRate, float frequency, float q, float gainDb);
+};
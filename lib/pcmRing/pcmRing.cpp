@@ -0,0 +1,124 @@
+#include "pcmRing.h"
+#include <string.h>
+
+/// @brief Attaches the storage
+/// @param storage Buffer of size bytes, owned by the caller
+/// @param size Size of the buffer, must be a power of two
+/// @param prefill Level the consumer waits for before reading, clamped to the size
+/// @return false if the storage is missing or its size is not a power of two
+bool pcmRing::begin(uint8_t *storage, uint32_t size, uint32_t prefill)
+{
+    if (storage == nullptr || size == 0 || (size & (size - 1)) != 0)
+        return false;
+    _storage = storage;
+    _size = size;
+    setPrefill(prefill);
+    return true;
+}
+
+/// @brief Changes the level the consumer waits for before reading, frame-aligned and clamped to the size.
+/// Consumer side, applied on the next priming.
+/// @param prefill New prefill level, in bytes
+void pcmRing::setPrefill(uint32_t prefill)
+{
+    if (prefill > _size)
+        prefill = _size;
+    _prefill = prefill - (prefill % PCM_FRAME_BYTES);
+}
+
+/// @brief Copies PCM into the ring, producer side. Never blocks.
+/// @param data PCM bytes
+/// @param len Number of bytes
+/// @return Number of bytes written, frame-aligned. The rest was dropped and counted as an overrun.
+uint32_t pcmRing::write(const uint8_t *data, uint32_t len)
+{
+    if (_storage == nullptr)
+        return 0;
+    uint32_t head = _head.load(std::memory_order_relaxed);
+    uint32_t fill = head - _tail.load(std::memory_order_acquire);
+    uint32_t room = _size - fill;
+    uint32_t count = (len < room) ? len : room;
+    count -= count % PCM_FRAME_BYTES;
+
+    uint32_t offset = head & (_size - 1);
+    uint32_t first = (count < _size - offset) ? count : _size - offset;
+    memcpy(_storage + offset, data, first);
+    memcpy(_storage, data + first, count - first);
+    _head.store(head + count, std::memory_order_release);
+
+    _writtenBytes.fetch_add(count, std::memory_order_relaxed);
+    if (count < len)
+    {
+        _overruns.fetch_add(1, std::memory_order_relaxed);
+        _overrunBytes.fetch_add(len - count, std::memory_order_relaxed);
+    }
+    if (fill + count > _peakFill.load(std::memory_order_relaxed))
+        _peakFill.store(fill + count, std::memory_order_relaxed);
+    return count;
+}
+
+/// @brief Copies PCM out of the ring, consumer side. Never blocks.
+/// @param data Destination buffer
+/// @param maxLen Size of the destination buffer
+/// @return Number of bytes read, frame-aligned. 0 while priming.
+uint32_t pcmRing::read(uint8_t *data, uint32_t maxLen)
+{
+    if (_storage == nullptr)
+        return 0;
+    uint32_t tail = _tail.load(std::memory_order_relaxed);
+    uint32_t fill = _head.load(std::memory_order_acquire) - tail;
+    if (!_primed)
+    {
+        if (fill < _prefill || fill == 0)
+            return 0;
+        _primed = true;
+    }
+    if (fill == 0)
+    {
+        // Ran dry : wait for the prefill level again
+        _primed = false;
+        _underruns.fetch_add(1, std::memory_order_relaxed);
+        return 0;
+    }
+    uint32_t count = (maxLen < fill) ? maxLen : fill;
+    count -= count % PCM_FRAME_BYTES;
+
+    uint32_t offset = tail & (_size - 1);
+    uint32_t first = (count < _size - offset) ? count : _size - offset;
+    memcpy(data, _storage + offset, first);
+    memcpy(data + first, _storage, count - first);
+    _tail.store(tail + count, std::memory_order_release);
+
+    _readBytes.fetch_add(count, std::memory_order_relaxed);
+    return count;
+}
+
+/// @brief Lets the consumer take what is left without waiting for the prefill level, e.g. the tail of a stream.
+/// Consumer side.
+void pcmRing::flush()
+{
+    if (fill() > 0)
+        _primed = true;
+}
+
+/// @brief Drops the buffered PCM and waits for the prefill level again, e.g. when the stream stops.
+/// Consumer side, the producer must be idle.
+void pcmRing::clear()
+{
+    _tail.store(_head.load(std::memory_order_acquire), std::memory_order_release);
+    _primed = false;
+}
+
+/// @brief Snapshot of the counters
+/// @return Counters since startup
+pcmRingStats pcmRing::stats() const
+{
+    pcmRingStats snapshot;
+    snapshot.writtenBytes = _writtenBytes.load(std::memory_order_relaxed);
+    snapshot.readBytes = _readBytes.load(std::memory_order_relaxed);
+    snapshot.overruns = _overruns.load(std::memory_order_relaxed);
+    snapshot.overrunBytes = _overrunBytes.load(std::memory_order_relaxed);
+    snapshot.underruns = _underruns.load(std::memory_order_relaxed);
+    snapshot.peakFill = _peakFill.load(std::memory_order_relaxed);
+    return snapshot;
+}
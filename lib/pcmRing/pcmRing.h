@@ -0,0 +1,57 @@
+#pragma once
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+// Bytes per stereo 16-bit frame, reads and writes are kept frame-aligned
+#ifndef PCM_FRAME_BYTES
+#define PCM_FRAME_BYTES 4
+#endif
+
+/// @brief Byte flow through the PCM ring since boot. peakFill is a high-water mark, the rest are running totals.
+struct pcmRingStats
+{
+    uint32_t writtenBytes = 0;
+    uint32_t readBytes = 0;
+    uint32_t overruns = 0;       // Writes that did not fit entirely
+    uint32_t overrunBytes = 0;   // Bytes dropped by those writes
+    uint32_t underruns = 0;      // Times the reader ran dry after priming
+    uint32_t peakFill = 0;       // Highest fill level after a write, in bytes
+};
+
+/// @brief Lock-free single-producer/single-consumer byte ring for PCM, on caller-provided storage so that it can live
+/// in PSRAM. The producer never blocks : what does not fit is dropped and counted as an overrun. The consumer starts
+/// after the ring is primed to the prefill level, and primes again after running dry, counted as an underrun.
+class pcmRing
+{
+private:
+    uint8_t *_storage = nullptr;
+    uint32_t _size = 0; // Power of two
+    uint32_t _prefill = 0;
+    std::atomic<uint32_t> _head{0}; // Bytes written, producer only
+    std::atomic<uint32_t> _tail{0}; // Bytes read, consumer only
+    bool _primed = false;           // Consumer only
+
+    // Statistics : the writer side owns the first four, the reader side the last two
+    std::atomic<uint32_t> _writtenBytes{0};
+    std::atomic<uint32_t> _overruns{0};
+    std::atomic<uint32_t> _overrunBytes{0};
+    std::atomic<uint32_t> _peakFill{0};
+    std::atomic<uint32_t> _readBytes{0};
+    std::atomic<uint32_t> _underruns{0};
+
+public:
+    bool begin(uint8_t *storage, uint32_t size, uint32_t prefill);
+    void setPrefill(uint32_t prefill);
+
+    uint32_t write(const uint8_t *data, uint32_t len);
+    uint32_t read(uint8_t *data, uint32_t maxLen);
+    void flush();
+    void clear();
+
+    uint32_t capacity() const { return _size; }
+    uint32_t prefill() const { return _prefill; }
+    uint32_t fill() const { return _head.load(std::memory_order_acquire) - _tail.load(std::memory_order_acquire); }
+    bool primed() const { return _primed; }
+    pcmRingStats stats() const;
+};
@@ -0,0 +1,76 @@
+#include "playPosition.h"
+
+/// @brief Keeps a position within the track
+/// @param positionMs Position, in ms
+/// @return The position, or the duration if it is known and shorter
+uint32_t playPosition::_clamp(uint64_t positionMs) const
+{
+    if (_durationMs != 0 && positionMs > _durationMs)
+        return _durationMs;
+    return (positionMs > UINT32_MAX) ? UINT32_MAX : (uint32_t)positionMs;
+}
+
+/// @brief Re-anchors on a position notified by the phone, and records how far the interpolation had drifted
+/// @param positionMs Notified position, in ms
+/// @param nowUs Current time, in us
+void playPosition::anchor(uint32_t positionMs, uint64_t nowUs)
+{
+    if (_playing && _stats.anchors > 0)
+    {
+        int32_t correction = (int32_t)((int64_t)positionMs - (int64_t)position(nowUs));
+        uint32_t magnitude = (correction < 0) ? -correction : correction;
+        _stats.lastCorrectionMs = correction;
+        if (magnitude > _stats.peakCorrectionMs)
+            _stats.peakCorrectionMs = magnitude;
+    }
+    _anchorMs = positionMs;
+    _anchorUs = nowUs;
+    _sentUs = nowUs;
+    _stats.anchors++;
+}
+
+/// @brief Starts or freezes the interpolation. Pausing keeps the position reached, playing resumes from it.
+/// @param playing true when the stream plays
+/// @param nowUs Current time, in us
+void playPosition::setPlaying(bool playing, uint64_t nowUs)
+{
+    if (playing == _playing)
+        return;
+    _anchorMs = position(nowUs);
+    _anchorUs = nowUs;
+    _playing = playing;
+}
+
+/// @brief Restarts from the beginning of a new track
+/// @param durationMs Duration of the track, 0 if unknown
+/// @param nowUs Current time, in us
+void playPosition::setTrack(uint32_t durationMs, uint64_t nowUs)
+{
+    _durationMs = durationMs;
+    _anchorMs = 0;
+    _anchorUs = nowUs;
+}
+
+/// @brief Interpolated position
+/// @param nowUs Current time, in us
+/// @return Position in ms, the anchor while paused
+uint32_t playPosition::position(uint64_t nowUs) const
+{
+    if (!_playing || nowUs < _anchorUs)
+        return _clamp(_anchorMs);
+    return _clamp(_anchorMs + (nowUs - _anchorUs) / 1000);
+}
+
+/// @brief Time left before the position is due to be sent on, at most once per interval and only while playing
+/// @param nowUs Current time, in us
+/// @param intervalMs Shortest interval between two sends, in ms
+/// @return ms left, 0 if due, UINT32_MAX while paused
+uint32_t playPosition::msUntilSend(uint64_t nowUs, uint32_t intervalMs) const
+{
+    if (!_playing)
+        return UINT32_MAX;
+    uint64_t dueUs = _sentUs + (uint64_t)intervalMs * 1000;
+    if (nowUs >= dueUs)
+        return 0;
+    return (uint32_t)((dueUs - nowUs + 999) / 1000);
+}
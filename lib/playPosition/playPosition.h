@@ -0,0 +1,39 @@
+#pragma once
+#include <stdint.h>
+
+/// @brief Counters of the interpolator
+struct playPositionStats
+{
+    uint32_t anchors = 0;          // Positions notified by the phone
+    int32_t lastCorrectionMs = 0;  // Notified minus interpolated position at the last anchor, while playing
+    uint32_t peakCorrectionMs = 0; // Largest correction, in absolute value
+};
+
+/// @brief Interpolates the play position between the AVRCP position notifications. The position is anchored on each
+/// notification along with the time it came, advances with the clock while playing, and is frozen while paused.
+/// Times are passed in by the caller, in us from a monotonic clock. Not thread-safe, callers serialize the calls.
+/// msUntilSend() paces the caller sending the position on : a notification counts as sent, as it is forwarded as is.
+class playPosition
+{
+private:
+    uint32_t _anchorMs = 0;   // Position at the anchor
+    uint64_t _anchorUs = 0;   // Time of the anchor
+    uint64_t _sentUs = 0;     // Time the position was last sent on, by the caller or on a notification
+    uint32_t _durationMs = 0; // Clamp of the position, 0 if unknown
+    bool _playing = false;
+    playPositionStats _stats;
+
+    uint32_t _clamp(uint64_t positionMs) const;
+
+public:
+    void anchor(uint32_t positionMs, uint64_t nowUs);
+    void setPlaying(bool playing, uint64_t nowUs);
+    void setTrack(uint32_t durationMs, uint64_t nowUs);
+    void setDuration(uint32_t durationMs) { _durationMs = durationMs; }
+
+    uint32_t position(uint64_t nowUs) const;
+    uint32_t msUntilSend(uint64_t nowUs, uint32_t intervalMs) const;
+    void markSent(uint64_t nowUs) { _sentUs = nowUs; }
+    bool playing() const { return _playing; }
+    const playPositionStats &stats() const { return _stats; }
+};
@@ -0,0 +1,100 @@
+#include "telemetry.h"
+
+/// @brief Telemetry task, reports at a fixed interval
+/// @param pvParameters telemetry instance
+void telemetry::_telemetryTask(void *pvParameters)
+{
+    telemetry *telemetryInstance = static_cast<telemetry *>(pvParameters);
+    TickType_t lastWake = xTaskGetTickCount();
+    while (true)
+    {
+        telemetryInstance->report();
+        vTaskDelayUntil(&lastWake, pdMS_TO_TICKS(telemetryInstance->_intervalMs));
+    }
+}
+
+/// @brief Starts the periodic report
+/// @param intervalMs Interval between two reports
+/// @return ESP_OK if the task was created, ESP_FAIL otherwise
+esp_err_t telemetry::begin(uint32_t intervalMs)
+{
+    _intervalMs = intervalMs;
+    xTaskCreatePinnedToCore(_telemetryTask, "Telemetry Task", TELEMETRY_TASK_STACK_SIZE, this, TELEMETRY_TASK_PRIORITY,
+                            &_telemetryTaskHandle, tskNO_AFFINITY);
+    if (_telemetryTaskHandle == NULL)
+    {
+        ESP_LOGE(__func__, "Could not create telemetry task");
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+/// @brief Logs one report, can also be called on demand from any task
+void telemetry::report()
+{
+#if configUSE_TRACE_FACILITY
+    static TaskStatus_t tasks[TELEMETRY_MAX_TASKS]; // Too large for the stack, and only one report runs at a time
+    static portMUX_TYPE reportLock = portMUX_INITIALIZER_UNLOCKED;
+    static bool reporting = false;
+    portENTER_CRITICAL(&reportLock);
+    bool busy = reporting;
+    reporting = true;
+    portEXIT_CRITICAL(&reportLock);
+    if (busy)
+        return;
+
+    UBaseType_t taskCount = uxTaskGetSystemState(tasks, TELEMETRY_MAX_TASKS, NULL);
+    if (taskCount == 0)
+        ESP_LOGW("TLM", "More than %d tasks, raise TELEMETRY_MAX_TASKS", TELEMETRY_MAX_TASKS);
+
+    // Tightest stacks first
+    for (UBaseType_t i = 1; i < taskCount; i++)
+        for (UBaseType_t j = i; j > 0 && tasks[j].usStackHighWaterMark < tasks[j - 1].usStackHighWaterMark; j--)
+        {
+            TaskStatus_t tmp = tasks[j];
+            tasks[j] = tasks[j - 1];
+            tasks[j - 1] = tmp;
+        }
+
+    // Compact "name:freeBytes" list, wrapped over as few lines as possible. Stack units are bytes on ESP32.
+    char line[TELEMETRY_LINE_SIZE];
+    int lineLen = 0;
+    for (UBaseType_t i = 0; i < taskCount; i++)
+    {
+        char entry[configMAX_TASK_NAME_LEN + 12];
+        int entryLen = snprintf(entry, sizeof(entry), " %s:%u", tasks[i].pcTaskName, (unsigned)tasks[i].usStackHighWaterMark);
+        if (lineLen > 0 && lineLen + entryLen >= (int)sizeof(line))
+        {
+            ESP_LOGI("TLM", "HWM%s", line);
+            lineLen = 0;
+        }
+        lineLen += snprintf(line + lineLen, sizeof(line) - lineLen, "%s", entry);
+    }
+    if (lineLen > 0)
+        ESP_LOGI("TLM", "HWM%s", line);
+
+    portENTER_CRITICAL(&reportLock);
+    reporting = false;
+    portEXIT_CRITICAL(&reportLock);
+#else
+    ESP_LOGI("TLM", "HWM of this task only (no trace facility): %u", (unsigned)uxTaskGetStackHighWaterMark(NULL));
+#endif
+
+    _reportHeap("DRAM", MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    if (heap_caps_get_total_size(MALLOC_CAP_SPIRAM) > 0)
+        _reportHeap("PSRAM", MALLOC_CAP_SPIRAM);
+}
+
+/// @brief Logs the state of the heap regions matching some capabilities
+/// @param label Name of the region in the report
+/// @param caps MALLOC_CAP_xxx capabilities of the region
+void telemetry::_reportHeap(const char *label, uint32_t caps)
+{
+    multi_heap_info_t info;
+    heap_caps_get_info(&info, caps);
+    // Fragmentation : share of the free memory that is not available as one block
+    uint32_t fragmentation = (info.total_free_bytes > 0) ? 100 - (uint32_t)((uint64_t)info.largest_free_block * 100 / info.total_free_bytes) : 0;
+    ESP_LOGI("TLM", "%s free %u min %u largest %u frag %lu%% of %u", label, (unsigned)info.total_free_bytes,
+             (unsigned)info.minimum_free_bytes, (unsigned)info.largest_free_block, fragmentation,
+             (unsigned)heap_caps_get_total_size(caps));
+}
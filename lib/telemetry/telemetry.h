@@ -0,0 +1,43 @@
+#pragma once
+#include "Arduino.h"
+#include "esp_heap_caps.h"
+
+// STACK_HIGH_WATERMARK_LOG is kept as an alias of ENABLE_TELEMETRY
+#if defined(STACK_HIGH_WATERMARK_LOG) && !defined(ENABLE_TELEMETRY)
+#define ENABLE_TELEMETRY
+#endif
+
+#ifndef TELEMETRY_INTERVAL_MS
+#define TELEMETRY_INTERVAL_MS 10000
+#endif
+#ifndef TELEMETRY_MAX_TASKS
+#define TELEMETRY_MAX_TASKS 32
+#endif
+#ifndef TELEMETRY_TASK_STACK_SIZE
+#define TELEMETRY_TASK_STACK_SIZE 3072
+#endif
+#ifndef TELEMETRY_TASK_PRIORITY
+#define TELEMETRY_TASK_PRIORITY 1
+#endif
+// Length of a report line before it is wrapped
+#ifndef TELEMETRY_LINE_SIZE
+#define TELEMETRY_LINE_SIZE 160
+#endif
+
+/// @brief Periodic stack and heap budget report, for right-sizing the task stacks and buffers from field data.
+/// Every TELEMETRY_INTERVAL_MS, logs under the "TLM" tag :
+/// - the stack high-water mark (minimum free bytes ever) of every task, tightest first
+/// - free, minimum free, largest free block and fragmentation of the internal DRAM heap, and of PSRAM if present
+class telemetry
+{
+private:
+    TaskHandle_t _telemetryTaskHandle = NULL;
+    uint32_t _intervalMs = TELEMETRY_INTERVAL_MS;
+
+    static void _telemetryTask(void *pvParameters);
+    static void _reportHeap(const char *label, uint32_t caps);
+
+public:
+    esp_err_t begin(uint32_t intervalMs = TELEMETRY_INTERVAL_MS);
+    void report();
+};
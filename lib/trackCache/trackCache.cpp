@@ -0,0 +1,110 @@
+#include "trackCache.h"
+#include <string.h>
+
+/// @brief Identity of a track : its title, artist and album, the duration aside
+/// @param record Track
+/// @return FNV-1a hash of the three strings, terminators included
+uint32_t trackCache::key(const trackRecord &record)
+{
+    uint32_t h = trackCoalescer::hash(record.title, strlen(record.title) + 1);
+    h = trackCoalescer::hash(record.artist, strlen(record.artist) + 1, h);
+    return trackCoalescer::hash(record.album, strlen(record.album) + 1, h);
+}
+
+/// @brief Looks up a cached track
+/// @param key Key of the track
+/// @return The entry, nullptr if the track is not cached
+trackCache::entry *trackCache::_find(uint32_t key)
+{
+    for (entry &candidate : _entries)
+    {
+        if (candidate.lastUsed != 0 && candidate.key == key)
+            return &candidate;
+    }
+    return nullptr;
+}
+
+/// @brief Moves the cursor onto a played track : one step along the history if it is the neighbour there, otherwise
+/// the history is cut after the cursor and the track appended, the oldest one dropped if it is full
+/// @param key Key of the played track
+void trackCache::_advanceHistory(uint32_t key)
+{
+    if (_historyLength > 0)
+    {
+        if (_history[_cursor] == key)
+            return;
+        if (_cursor + 1 < _historyLength && _history[_cursor + 1] == key)
+        {
+            _cursor++;
+            return;
+        }
+        if (_cursor > 0 && _history[_cursor - 1] == key)
+        {
+            _cursor--;
+            return;
+        }
+        _historyLength = _cursor + 1;
+    }
+    if (_historyLength == TRACK_CACHE_HISTORY)
+    {
+        memmove(_history, _history + 1, (TRACK_CACHE_HISTORY - 1) * sizeof(_history[0]));
+        _historyLength--;
+    }
+    _history[_historyLength] = key;
+    _cursor = _historyLength++;
+}
+
+/// @brief Records the track now playing, in the cache and in the history
+/// @param record Track now playing
+void trackCache::played(const trackRecord &record)
+{
+    uint32_t trackKey = key(record);
+    entry *slot = _find(trackKey);
+    if (slot != nullptr)
+    {
+        if (_historyLength == 0 || _history[_cursor] != trackKey)
+            _stats.repeats++;
+    }
+    else
+    {
+        // Free entry, or else the least recently used one
+        slot = &_entries[0];
+        for (entry &candidate : _entries)
+        {
+            if (candidate.lastUsed < slot->lastUsed)
+                slot = &candidate;
+        }
+        if (slot->lastUsed != 0)
+            _stats.evictions++;
+        slot->key = trackKey;
+    }
+    slot->record = record;
+    slot->lastUsed = ++_clock;
+    _advanceHistory(trackKey);
+}
+
+/// @brief Looks up the track next to the current one in the history, e.g. the previous one on a PREV command
+/// @param step -1 for the previous track, 1 for the next one after going back
+/// @return The cached track, nullptr if it is unknown or was evicted
+const trackRecord *trackCache::neighbour(int8_t step)
+{
+    int16_t index = (int16_t)_cursor + step;
+    entry *slot = nullptr;
+    if (_historyLength > 0 && index >= 0 && index < _historyLength)
+        slot = _find(_history[index]);
+    if (slot == nullptr)
+    {
+        _stats.misses++;
+        return nullptr;
+    }
+    _stats.hits++;
+    slot->lastUsed = ++_clock;
+    return &slot->record;
+}
+
+/// @brief Forgets the play order, e.g. on disconnect. The cached tracks and the counters are kept.
+void trackCache::resetHistory()
+{
+    _historyLength = 0;
+    _cursor = 0;
+}
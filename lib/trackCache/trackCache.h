@@ -0,0 +1,56 @@
+#pragma once
+#include <stdint.h>
+#include "trackCoalescer.h"
+
+// Tracks kept, least recently used evicted first
+#ifndef TRACK_CACHE_SIZE
+#define TRACK_CACHE_SIZE 8
+#endif
+// Tracks remembered in play order, for previous/next lookups
+#ifndef TRACK_CACHE_HISTORY
+#define TRACK_CACHE_HISTORY 16
+#endif
+
+/// @brief Outcome of the PREV/NEXT lookups, and how much the cache churns
+struct trackCacheStats
+{
+    uint32_t hits = 0;      // Lookups answered from the cache
+    uint32_t misses = 0;    // Lookups past the history, or of an evicted track
+    uint32_t repeats = 0;   // Tracks played again while still cached
+    uint32_t evictions = 0; // Tracks dropped to make room
+};
+
+/// @brief Fixed-memory LRU of recently played tracks, keyed by the hash of their title, artist and album, with the
+/// play order kept as a history and a cursor on the current track. Going back and forth in the history moves the
+/// cursor, and a track played off the history truncates it there, like the history of a browser.
+/// No locking : played() and neighbour() rewrite the LRU stamps and the cursor, so both must come from the same task,
+/// and the record neighbour() returns stays valid only until the next played().
+class trackCache
+{
+private:
+    struct entry
+    {
+        uint32_t key = 0;
+        uint32_t lastUsed = 0; // 0 for a free entry
+        trackRecord record;
+    } _entries[TRACK_CACHE_SIZE];
+    uint32_t _clock = 0;
+
+    uint32_t _history[TRACK_CACHE_HISTORY] = {0}; // Keys, oldest first
+    uint8_t _historyLength = 0;
+    uint8_t _cursor = 0; // Index of the current track in the history
+
+    trackCacheStats _stats;
+
+    entry *_find(uint32_t key);
+    void _advanceHistory(uint32_t key);
+
+public:
+    static uint32_t key(const trackRecord &record);
+
+    void played(const trackRecord &record);
+    const trackRecord *neighbour(int8_t step);
+    void resetHistory();
+
+    const trackCacheStats &stats() const { return _stats; }
+};
@@ -0,0 +1,203 @@
+#include "trackCoalescer.h"
+#include <stdlib.h>
+#include <string.h>
+
+/// @brief 32-bit FNV-1a hash
+/// @param data Bytes to hash
+/// @param len Number of bytes
+/// @param seed Hash of the preceding bytes, to hash several buffers as one
+/// @return Hash of the bytes
+uint32_t trackCoalescer::hash(const void *data, uint32_t len, uint32_t seed)
+{
+    const uint8_t *bytes = static_cast<const uint8_t *>(data);
+    uint32_t h = seed;
+    for (uint32_t i = 0; i < len; i++)
+    {
+        h ^= bytes[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+/// @brief Index of a field in the committed hashes
+uint8_t trackCoalescer::_slot(trackField field)
+{
+    switch (field)
+    {
+    case TRACK_TITLE:
+        return 0;
+    case TRACK_ARTIST:
+        return 1;
+    case TRACK_ALBUM:
+        return 2;
+    default:
+        return 3;
+    }
+}
+
+/// @brief Hash of one field of a track, as compared with the committed track
+uint32_t trackCoalescer::_fieldHash(trackField field, const trackRecord &record)
+{
+    switch (field)
+    {
+    case TRACK_TITLE:
+        return hash(record.title, strlen(record.title));
+    case TRACK_ARTIST:
+        return hash(record.artist, strlen(record.artist));
+    case TRACK_ALBUM:
+        return hash(record.album, strlen(record.album));
+    default:
+        return hash(&record.durationMs, sizeof(record.durationMs));
+    }
+}
+
+/// @brief Completes the pending burst with the expected track, the fields the phone already sent taking precedence,
+/// and makes it due at once
+void trackCoalescer::_confirm()
+{
+    if (!(_pendingFields & TRACK_ARTIST))
+        memcpy(_record.artist, _expected.artist, sizeof(_record.artist));
+    if (!(_pendingFields & TRACK_ALBUM))
+        memcpy(_record.album, _expected.album, sizeof(_record.album));
+    if (!(_pendingFields & TRACK_DURATION))
+        _record.durationMs = _expected.durationMs;
+    _pendingFields = TRACK_TITLE | TRACK_ARTIST | TRACK_ALBUM | TRACK_DURATION;
+    _confirmed = true;
+    _stats.confirmed++;
+}
+
+/// @brief Adds an attribute to the burst being assembled. A later value of the same field replaces the earlier one.
+/// @param field Attribute
+/// @param text Text of the attribute, the duration is in ms as decimal text
+/// @param nowMs Current time, in ms
+void trackCoalescer::add(trackField field, const char *text, uint32_t nowMs)
+{
+    if (_pendingFields == 0)
+        _firstMs = nowMs;
+    _lastMs = nowMs;
+    _pendingFields |= field;
+    _stats.attributes++;
+
+    switch (field)
+    {
+    case TRACK_TITLE:
+        strncpy(_record.title, text, sizeof(_record.title) - 1);
+        if (_expecting)
+        {
+            if (strcmp(_record.title, _expected.title) == 0)
+                _confirm();
+            else
+                _stats.unconfirmed++;
+            _expecting = false;
+        }
+        break;
+    case TRACK_ARTIST:
+        strncpy(_record.artist, text, sizeof(_record.artist) - 1);
+        break;
+    case TRACK_ALBUM:
+        strncpy(_record.album, text, sizeof(_record.album) - 1);
+        break;
+    case TRACK_DURATION:
+        _record.durationMs = (uint32_t)strtoul(text, nullptr, 10);
+        break;
+    }
+}
+
+/// @brief Time left before the burst must be committed
+/// @param nowMs Current time, in ms
+/// @return 0 if the burst is due or nothing is pending, the remaining ms otherwise
+uint32_t trackCoalescer::msUntilDue(uint32_t nowMs) const
+{
+    if (_pendingFields == 0 || _confirmed)
+        return 0;
+    uint32_t sinceLast = nowMs - _lastMs;
+    uint32_t sinceFirst = nowMs - _firstMs;
+    if (sinceLast >= TRACK_COALESCE_QUIET_MS || sinceFirst >= TRACK_COALESCE_MAX_MS)
+        return 0;
+    uint32_t quietLeft = TRACK_COALESCE_QUIET_MS - sinceLast;
+    uint32_t maxLeft = TRACK_COALESCE_MAX_MS - sinceFirst;
+    return (quietLeft < maxLeft) ? quietLeft : maxLeft;
+}
+
+/// @brief Closes the burst and compares its fields with the committed track, which it then becomes
+/// @return Mask of the trackField values that changed, to apply from record(). 0 if the burst was a duplicate.
+uint8_t trackCoalescer::commit()
+{
+    uint8_t changed = 0;
+    if (_pendingFields == 0)
+        return 0;
+
+    for (uint8_t bit = 0; bit < 4; bit++)
+    {
+        trackField field = (trackField)(1 << bit);
+        if (!(_pendingFields & field))
+            continue;
+        uint32_t h = _fieldHash(field, _record);
+        uint8_t slot = _slot(field);
+        if ((_committedFields & field) && _committedHashes[slot] == h)
+        {
+            _stats.skippedFields++;
+            continue;
+        }
+        _committedHashes[slot] = h;
+        _committedFields |= field;
+        changed |= field;
+    }
+
+    _pendingFields = 0;
+    _confirmed = false;
+    _stats.bursts++;
+    if (changed)
+    {
+        _changedMs = _lastMs;
+        _unsettled = true;
+        _stats.commits++;
+    }
+    else
+        _stats.duplicateBursts++;
+    return changed;
+}
+
+/// @brief Holds the track a PREV/NEXT command should lead to, without committing it. If the next title from the phone
+/// is the expected one, the rest of the track is taken from it and the burst is due at once. Any other title drops it,
+/// so that the head unit only ever sees the track the phone actually plays.
+/// @param record Expected track
+void trackCoalescer::expect(const trackRecord &record)
+{
+    _expected = record;
+    _expecting = true;
+}
+
+/// @brief Time left before the committed track counts as settled
+/// @param nowMs Current time, in ms
+/// @return 0 if it is settled, UINT32_MAX if it did not change since the last settle() or a burst is pending
+uint32_t trackCoalescer::msUntilSettled(uint32_t nowMs) const
+{
+    if (!_unsettled || _pendingFields != 0)
+        return UINT32_MAX;
+    uint32_t since = nowMs - _changedMs;
+    return (since >= TRACK_SETTLE_MS) ? 0 : TRACK_SETTLE_MS - since;
+}
+
+/// @brief Reports once that the committed track is settled, i.e. whole : no burst changed it for TRACK_SETTLE_MS and
+/// none is pending. Only then does record() hold a single track rather than one in the middle of changing.
+/// @param nowMs Current time, in ms
+/// @return true the first time the track is found settled, with a title
+bool trackCoalescer::settle(uint32_t nowMs)
+{
+    if (msUntilSettled(nowMs) != 0)
+        return false;
+    _unsettled = false;
+    return _record.title[0] != '\0';
+}
+
+/// @brief Forgets the committed track and the pending burst, e.g. on disconnect. The counters are kept.
+void trackCoalescer::reset()
+{
+    _record = trackRecord();
+    _pendingFields = 0;
+    _committedFields = 0;
+    _confirmed = false;
+    _expecting = false;
+    _unsettled = false;
+}
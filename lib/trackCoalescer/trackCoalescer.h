@@ -0,0 +1,87 @@
+#pragma once
+#include <stdint.h>
+#include "metadataRing.h"
+
+// A burst is committed once no attribute arrived for TRACK_COALESCE_QUIET_MS,
+// or TRACK_COALESCE_MAX_MS after its first attribute at the latest
+#ifndef TRACK_COALESCE_QUIET_MS
+#define TRACK_COALESCE_QUIET_MS 20
+#endif
+#ifndef TRACK_COALESCE_MAX_MS
+#define TRACK_COALESCE_MAX_MS 100
+#endif
+// A committed track is settled once no burst changed it for TRACK_SETTLE_MS, phones may send it in several bursts
+#ifndef TRACK_SETTLE_MS
+#define TRACK_SETTLE_MS 1000
+#endif
+
+/// @brief Track attributes, as bits of a field mask
+enum trackField : uint8_t
+{
+    TRACK_TITLE = 0x01,
+    TRACK_ARTIST = 0x02,
+    TRACK_ALBUM = 0x04,
+    TRACK_DURATION = 0x08
+};
+
+/// @brief One track, as assembled from an AVRCP metadata burst
+struct trackRecord
+{
+    char title[METADATA_TEXT_SIZE] = {0};
+    char artist[METADATA_TEXT_SIZE] = {0};
+    char album[METADATA_TEXT_SIZE] = {0};
+    uint32_t durationMs = 0;
+};
+
+/// @brief What the coalescer received and how much of it reached the head unit, to tune the burst windows
+struct trackCoalescerStats
+{
+    uint32_t attributes = 0;      // Attributes added
+    uint32_t bursts = 0;          // Bursts closed
+    uint32_t commits = 0;         // Bursts that changed at least one field
+    uint32_t duplicateBursts = 0; // Bursts identical to the committed track, dropped
+    uint32_t skippedFields = 0;   // Fields of committed bursts identical to the committed track
+    uint32_t confirmed = 0;       // Expected tracks whose title came from the phone, committed at once
+    uint32_t unconfirmed = 0;     // Expected tracks the phone moved away from
+};
+
+/// @brief Collects the attributes of one AVRCP metadata burst into a single track record, then commits only the fields
+/// that differ from the committed track. Fields are compared through their FNV-1a hash, so that only the record being
+/// assembled needs to be kept. A track expected from a cache is held until the phone sends its title, and then
+/// completes the burst at once. The burst timing comes from the caller's clock, so add(), msUntilDue(), commit() and
+/// settle() must all be called from the one task that drains the metadata ring.
+class trackCoalescer
+{
+private:
+    trackRecord _record;
+    uint8_t _pendingFields = 0;
+    uint32_t _firstMs = 0;
+    uint32_t _lastMs = 0;
+    bool _confirmed = false; // The pending burst is an expected track, due at once
+    trackRecord _expected;   // Track expected after a PREV/NEXT command, until the next title
+    bool _expecting = false;
+    uint32_t _changedMs = 0; // Last attribute of the last burst that changed the committed track
+    bool _unsettled = false; // Committed track changed since the last settle()
+    uint32_t _committedHashes[4] = {0};
+    uint8_t _committedFields = 0;
+    trackCoalescerStats _stats;
+
+    static uint8_t _slot(trackField field);
+    static uint32_t _fieldHash(trackField field, const trackRecord &record);
+    void _confirm();
+
+public:
+    static uint32_t hash(const void *data, uint32_t len, uint32_t seed = 2166136261u);
+
+    void add(trackField field, const char *text, uint32_t nowMs);
+    bool pending() const { return _pendingFields != 0; }
+    uint32_t msUntilDue(uint32_t nowMs) const;
+    uint8_t commit();
+    void expect(const trackRecord &record);
+    uint32_t msUntilSettled(uint32_t nowMs) const;
+    bool settle(uint32_t nowMs);
+    void reset();
+
+    const trackRecord &record() const { return _record; }
+    const trackCoalescerStats &stats() const { return _stats; }
+};
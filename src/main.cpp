@@ -1,7 +1,20 @@
 #include <Arduino.h>
+#include <Preferences.h>
 #include "AudioTools.h"
 #include "BluetoothA2DPSink.h"
+#include "bufferProfile.h"
+#include "esp_cpu.h"
+#include "esp_heap_caps.h"
+#include "esp_memory_utils.h"
+#include "esp_timer.h"
 #include "esPod.h"
+#include "metadataRing.h"
+#include "pcmDsp.h"
+#include "pcmRing.h"
+#include "playPosition.h"
+#include "trackCache.h"
+#include "trackCoalescer.h"
+#include "telemetry.h"
 
 #pragma region Board IO Macros
 // LED Logic inversion
@@ -27,9 +40,6 @@
 #pragma endregion
 
 #pragma region AVRC-related FreeRTOS tasks defines
-#ifndef AVRC_QUEUE_SIZE
-#define AVRC_QUEUE_SIZE 32
-#endif
 #ifndef PROCESS_AVRC_TASK_STACK_SIZE
 #define PROCESS_AVRC_TASK_STACK_SIZE 4096
 #endif
@@ -43,6 +53,11 @@
 #ifndef A2DP_SINK_NAME
 #define A2DP_SINK_NAME "espiPod"
 #endif
+// Time given to the directed reconnect to the last phone, at boot or after a lost link, before the sink becomes
+// discoverable
+#ifndef RECONNECT_TIMEOUT_MS
+#define RECONNECT_TIMEOUT_MS 5000
+#endif
 #ifndef WS_PIN
 #define WS_PIN 25
 #endif
@@ -52,11 +67,84 @@
 #ifndef BCLK_PIN
 #define BCLK_PIN 27
 #endif
+// Output rate until the source negotiates another one
+#ifndef PCM_DEFAULT_SAMPLE_RATE
+#define PCM_DEFAULT_SAMPLE_RATE 44100
+#endif
+
+// Buffering profile at boot : BUFFER_PROFILE_LOW_LATENCY, BUFFER_PROFILE_BALANCED or BUFFER_PROFILE_ROBUST.
+// It sets the I2S DMA buffers and the PCM ring size and prefill, and can be switched from the serial monitor.
+#ifndef BUFFER_PROFILE
+#define BUFFER_PROFILE BUFFER_PROFILE_BALANCED
+#endif
+// Storage of the PCM ring between the A2DP stream reader and the I2S writer task, in PSRAM when available. Must be a
+// power of two. Profiles asking for a larger ring are clamped to it.
+#ifndef PCM_RING_SIZE
+#ifdef BOARD_HAS_PSRAM
+#define PCM_RING_SIZE 65536
+#else
+#define PCM_RING_SIZE 16384
+#endif
+#endif
+#ifndef PCM_WRITE_CHUNK
+#define PCM_WRITE_CHUNK 1024
+#endif
+#ifndef PCM_WRITER_TASK_STACK_SIZE
+#define PCM_WRITER_TASK_STACK_SIZE 3072
+#endif
+#ifndef PCM_WRITER_TASK_PRIORITY
+#define PCM_WRITER_TASK_PRIORITY 10
+#endif
+#ifndef PCM_WRITER_CORE
+#define PCM_WRITER_CORE 1
+#endif
+// Longest sleep of the writer when the ring is empty or priming
+#ifndef PCM_WRITER_WAIT_MS
+#define PCM_WRITER_WAIT_MS 5
+#endif
+#ifndef PCM_STATS_INTERVAL_MS
+#define PCM_STATS_INTERVAL_MS 10000
+#endif
+
+// Longest time without a position sent to the esPod while playing, so the position is at most this stale. Well under
+// the 1 s of the AVRCP notifications, which restart the interval, so that their jitter never delays a send.
+#ifndef PLAY_POSITION_UPDATE_MS
+#define PLAY_POSITION_UPDATE_MS 250
+#endif
+
+// Past this position, phones restart the current track on PREV rather than going to the previous one
+#ifndef PREV_RESTART_MS
+#define PREV_RESTART_MS 3000
+#endif
+
+// Optional DSP stage in the I2S writer (ENABLE_PCM_DSP) : gain, bass and treble shelves, limiter. Tune per head unit.
+#ifndef PCM_DSP_GAIN_DB
+#define PCM_DSP_GAIN_DB 0
+#endif
+#ifndef PCM_DSP_BASS_HZ
+#define PCM_DSP_BASS_HZ 100
+#endif
+#ifndef PCM_DSP_BASS_DB
+#define PCM_DSP_BASS_DB 0
+#endif
+#ifndef PCM_DSP_TREBLE_HZ
+#define PCM_DSP_TREBLE_HZ 8000
+#endif
+#ifndef PCM_DSP_TREBLE_DB
+#define PCM_DSP_TREBLE_DB 0
+#endif
+// Limiter threshold in dBFS, 0 disables it
+#ifndef PCM_DSP_LIMITER_DB
+#define PCM_DSP_LIMITER_DB -1
+#endif
+#ifndef PCM_DSP_RELEASE_MS
+#define PCM_DSP_RELEASE_MS 50
+#endif
 
 #ifdef AUDIOKIT // Using the AiThink A1S AudioKit chip
 #include "AudioBoard.h"
 #include "AudioTools/AudioLibs/I2SCodecStream.h"
-AudioInfo info(44100, 2, 16);
+AudioInfo info(PCM_DEFAULT_SAMPLE_RATE, 2, 16);
 DriverPins minimalPins;
 AudioBoard minimalAudioKit(AudioDriverES8388, minimalPins);
 I2SCodecStream i2s(minimalAudioKit);
@@ -66,25 +154,195 @@ I2SStream i2s;
 BluetoothA2DPSink a2dp_sink;
 #endif
 
-/// @brief Data stream reader callback
+// Last phone, stored in NVS and mirrored here so that reconnecting and storing the same phone again skip the flash
+esp_bd_addr_t storedPeer = {0};
+bool storedPeerValid = false; // Both loaded before the A2DP Sink starts, then written by the timer task only
+bool peerLinked = false;      // A phone connected since the last disconnection, BT callbacks only
+esp_timer_handle_t reconnectTimer = nullptr; // Discoverable once the directed reconnect timed out
+esp_timer_handle_t linkLossTimer = nullptr;  // Directed reconnect after a lost link, out of the BT callback
+esp_timer_handle_t peerStoreTimer = nullptr; // NVS write of a new phone, out of the BT callback
+
+// PCM ring and its writer task
+pcmRing pcmBuffer;
+uint8_t *pcmStorage = nullptr; // PCM_RING_SIZE bytes behind the ring
+TaskHandle_t pcmWriterTaskHandle;
+volatile bool pcmStreaming = false; // Set while the A2DP audio stream is started
+volatile uint32_t pendingSampleRate = 0; // Rate negotiated by the source, applied by the writer task
+uint32_t outputSampleRate = PCM_DEFAULT_SAMPLE_RATE;
+bufferProfileId activeBufferProfile = BUFFER_PROFILE;
+volatile int8_t pendingBufferProfile = -1; // Profile requested at runtime, applied by the writer task between streams
+uint32_t i2sBufferCount = 0;  // I2S DMA buffers
+uint32_t i2sBufferFrames = 0; // Frames per I2S DMA buffer
+// Times since boot, to report ignition to first audio
+int64_t peerConnectedUs = 0;
+volatile int64_t streamStartedUs = 0;
+bool firstAudioLogged = false; // Writer task only
+// Defined with the other helpers, the writer task switches profiles
+bool configurePCMRing(const bufferProfile &profile);
+void beginI2S(const bufferProfile &profile);
+void logBufferProfile(const bufferProfile &profile);
+void requestBufferProfile(bufferProfileId id);
+
+#ifdef ENABLE_PCM_DSP
+/// @brief CPU cycle counter for the DSP cost accounting
+static uint32_t dspCycleCount()
+{
+	return esp_cpu_get_cycle_count();
+}
+pcmDsp dsp(dspCycleCount);
+#endif
+
+/// @brief Data stream reader callback, only copies into the PCM ring so that the Bluetooth data path never waits on
+/// the I2S DMA. What does not fit is dropped and counted as an overrun.
 /// @param data Data buffer to pass to the I2S
 /// @param length Length of the data buffer
 void read_data_stream(const uint8_t *data, uint32_t length)
 {
-	i2s.write(data, length);
+	pcmBuffer.write(data, length);
+	if (pcmWriterTaskHandle != nullptr)
+		xTaskNotifyGive(pcmWriterTaskHandle);
+}
+
+/// @brief Reclocks the I2S output, and the codec on the AudioKit, at the rate negotiated by the source. Runs in the
+/// writer task between two writes, so the stream is never torn down nor written to while reconfiguring.
+/// The PCM already in the ring is played at the new rate : the source only renegotiates before (re)starting the stream.
+static void applySampleRate()
+{
+	uint32_t rate = pendingSampleRate;
+	pendingSampleRate = 0;
+	AudioInfo newInfo = i2s.audioInfo();
+	if (newInfo.sample_rate == rate)
+		return;
+	newInfo.sample_rate = rate;
+	outputSampleRate = rate;
+
+	int64_t start = esp_timer_get_time();
+	i2s.setAudioInfo(newInfo);
+	int64_t elapsedUs = esp_timer_get_time() - start;
+#ifdef ENABLE_PCM_DSP
+	dsp.setSampleRate(rate);
+#endif
+
+	// Glitch-free if well within what one DMA buffer keeps playing : half of it leaves room for the writer to refill
+	uint32_t bufferPeriodUs = (uint32_t)((uint64_t)i2sBufferFrames * 1000000 / rate);
+	if (elapsedUs <= bufferPeriodUs / 2)
+		ESP_LOGI(__func__, "Output reclocked to %lu Hz in %lld us (buffer period %lu us)", rate, elapsedUs, bufferPeriodUs);
+	else
+		ESP_LOGW(__func__, "Output reclocked to %lu Hz in %lld us, more than half the %lu us buffer period", rate,
+				 elapsedUs, bufferPeriodUs);
+}
+
+/// @brief Switches to the requested buffering profile : resizes the ring and restarts the I2S output with the new DMA
+/// buffers. Runs in the writer task while no stream is playing, so the producer is idle and nothing is cut.
+static void applyBufferProfile()
+{
+	activeBufferProfile = (bufferProfileId)pendingBufferProfile;
+	pendingBufferProfile = -1;
+	const bufferProfile &profile = getBufferProfile(activeBufferProfile);
+	pcmBuffer.clear();
+	configurePCMRing(profile);
+	i2s.end();
+	beginI2S(profile);
+	logBufferProfile(profile);
+}
+
+/// @brief I2S writer task, drains the PCM ring into the I2S output, blocking on the DMA. Waits for the prefill level
+/// at the start of a stream and after an underrun, and reports the ring counters and the buffered latency every
+/// PCM_STATS_INTERVAL_MS.
+/// @param pvParameters
+static void pcmWriterTask(void *pvParameters)
+{
+	static int16_t chunk[PCM_WRITE_CHUNK / sizeof(int16_t)]; // Kept off the stack
+	pcmRingStats reported; // Counters at the last report
+	TickType_t lastReport = xTaskGetTickCount();
+	// Audio queued between the A2DP stack and the DAC after each write, in us. What the DMA holds is tracked as the time
+	// at which the audio written so far runs out.
+	int64_t i2sDrainedAtUs = 0;
+	uint32_t bufferedMin = UINT32_MAX, bufferedMax = 0, writes = 0;
+	uint64_t bufferedSum = 0;
+
+	while (true)
+	{
+		if (pendingSampleRate != 0)
+			applySampleRate();
+		if (pendingBufferProfile >= 0 && !pcmStreaming && pcmBuffer.fill() == 0)
+			applyBufferProfile();
+		if (!pcmStreaming && pcmBuffer.fill() == 0 && pcmBuffer.primed())
+			pcmBuffer.clear(); // End of stream, not an underrun
+		else if (!pcmStreaming)
+			pcmBuffer.flush(); // Plays the tail of the stream, even if shorter than the prefill
+		uint32_t len = pcmBuffer.read((uint8_t *)chunk, sizeof(chunk));
+		if (len > 0)
+		{
+#ifdef ENABLE_PCM_DSP
+			dsp.process(chunk, len / PCM_FRAME_BYTES);
+#endif
+			i2s.write((uint8_t *)chunk, len);
+			int64_t now = esp_timer_get_time();
+			if (!firstAudioLogged)
+			{
+				firstAudioLogged = true;
+				ESP_LOGI(__func__, "Ignition to first audio %lu ms : peer connected at %lu ms, stream started at %lu ms",
+						 (uint32_t)(now / 1000), (uint32_t)(peerConnectedUs / 1000), (uint32_t)(streamStartedUs / 1000));
+			}
+			i2sDrainedAtUs = ((i2sDrainedAtUs > now) ? i2sDrainedAtUs : now) +
+							 (int64_t)len * 1000000 / ((int64_t)outputSampleRate * PCM_FRAME_BYTES);
+			uint32_t buffered = (uint32_t)(i2sDrainedAtUs - now) +
+								(uint32_t)((uint64_t)pcmBuffer.fill() * 1000000 / ((uint64_t)outputSampleRate * PCM_FRAME_BYTES));
+			bufferedMin = (buffered < bufferedMin) ? buffered : bufferedMin;
+			bufferedMax = (buffered > bufferedMax) ? buffered : bufferedMax;
+			bufferedSum += buffered;
+			writes++;
+		}
+		else
+			ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(PCM_WRITER_WAIT_MS));
+
+		if (xTaskGetTickCount() - lastReport >= pdMS_TO_TICKS(PCM_STATS_INTERVAL_MS))
+		{
+			lastReport = xTaskGetTickCount();
+			pcmRingStats current = pcmBuffer.stats();
+			if (current.underruns != reported.underruns || current.overruns != reported.overruns)
+				ESP_LOGW(__func__, "PCM ring fill %lu/%lu peak %lu, %lu underruns, %lu overruns (%lu bytes dropped)",
+						 pcmBuffer.fill(), pcmBuffer.capacity(), current.peakFill, current.underruns, current.overruns,
+						 current.overrunBytes);
+			else
+				ESP_LOGD(__func__, "PCM ring fill %lu/%lu peak %lu", pcmBuffer.fill(), pcmBuffer.capacity(), current.peakFill);
+			reported = current;
+			if (writes > 0)
+			{
+				ESP_LOGI(__func__, "Buffered latency %lu ms (min %lu, max %lu), %s profile", (uint32_t)(bufferedSum / writes / 1000),
+						 bufferedMin / 1000, bufferedMax / 1000, getBufferProfile(activeBufferProfile).name);
+				bufferedMin = UINT32_MAX;
+				bufferedMax = bufferedSum = writes = 0;
+			}
+#ifdef ENABLE_PCM_DSP
+			// Share of the writer core spent in the DSP, the rest is left to SBC decoding and everything else
+			const pcmDspCost &cost = dsp.cost();
+			uint64_t coreCyclesPerFrame = (uint64_t)getCpuFrequencyMhz() * 1000000 / dsp.sampleRate();
+			ESP_LOGI(__func__, "DSP %lu cycles/frame (peak %lu), %.2f%% of core %d (peak %.2f%%)",
+					 cost.averageCyclesPerFrame(), cost.peakCyclesPerFrame, 100.0 * cost.averageCyclesPerFrame() / coreCyclesPerFrame,
+					 xPortGetCoreID(), 100.0 * cost.peakCyclesPerFrame / coreCyclesPerFrame);
+			dsp.resetCost();
+#endif
+		}
+	}
 }
 
 #pragma endregion
 
 #pragma region Helper Functions declaration
+esp_err_t initializePCMWriter();
 void initializeA2DPSink();
 esp_err_t initializeAVRCTask();
+esp_err_t initializePeerTimers();
+void reconnectLastPeer();
 #pragma endregion
 
 #pragma region A2DP/AVRC callbacks declaration
 void connectionStateChanged(esp_a2d_connection_state_t state, void *ptr);
 void audioStateChanged(esp_a2d_audio_state_t state, void *ptr);
 void avrc_rn_play_pos_callback(uint32_t play_pos);
+void sampleRateChanged(uint16_t rate);
 void avrc_metadata_callback(uint8_t id, const uint8_t *text);
 void playStatusHandler(PB_COMMAND playCommand);
 #pragma endregion
@@ -94,9 +352,13 @@ void playStatusHandler(PB_COMMAND playCommand);
 // esPod espod(1,UART1_RX,UART1_TX,0);
 esPod espod(1, UART1_RX, UART1_TX, 19200);
 bool pendingPlayReq = false; // Might use this to make sure play requests are not ignored.
+#ifdef ENABLE_TELEMETRY
+telemetry budget;
+#endif
 
 void setup()
 {
+	Serial.begin(115200); // Console commands, on the UART the logs go to
 
 #ifdef LED_BUILTIN
 	pinMode(LED_BUILTIN, OUTPUT);
@@ -118,149 +380,436 @@ void setup()
 	ESP_LOGI("VERSION", "%s", VERSION_STRING);
 	ESP_LOGI("BRANCH", "%s", VERSION_BRANCH);
 
+#ifdef ENABLE_TELEMETRY
+	// Periodic stack/heap report, before the other tasks so that their worst case is caught
+	if (budget.begin() != ESP_OK)
+		ESP_LOGW(__func__, "Telemetry could not start");
+#endif
+
 	// Start AVRC Notifications handler
 	if (initializeAVRCTask() != ESP_OK)
 		esp_restart();
 
-	// Start the A2DP Sink
+	// Start the PCM ring and its I2S writer, then the A2DP Sink feeding it
+	if (initializePCMWriter() != ESP_OK)
+		esp_restart();
 	initializeA2DPSink();
 
+	// The esPod answers the head unit from now on, the phone connects in the background
 	espod.attachPlayControlHandler(playStatusHandler);
-	ESP_LOGI(__func__, "Waiting for peer");
-	while (a2dp_sink.get_connection_state() != ESP_A2D_CONNECTION_STATE_CONNECTED)
+	ESP_LOGI(__func__, "Setup finished in %lu ms", (uint32_t)(esp_timer_get_time() / 1000));
+}
+
+void loop()
+{
+	// Console commands : 'l', 'b' and 'r' switch to the low-latency, balanced and robust buffering profiles
+	while (Serial.available() > 0)
 	{
-		delay(10);
+		switch (Serial.read())
+		{
+		case 'l':
+			requestBufferProfile(BUFFER_PROFILE_LOW_LATENCY);
+			break;
+		case 'b':
+			requestBufferProfile(BUFFER_PROFILE_BALANCED);
+			break;
+		case 'r':
+			requestBufferProfile(BUFFER_PROFILE_ROBUST);
+			break;
+		}
 	}
-	delay(50);
-	ESP_LOGI(__func__, "Peer connected: %s", a2dp_sink.get_peer_name());
-	ESP_LOGI(__func__, "Setup finished");
+	vTaskDelay(pdMS_TO_TICKS(50));
 }
 
-void loop()
+#pragma region AVRC Task and Ring declaration/definition
+// AVRC metadata ring, preallocated : the BT callback copies into it without touching the heap
+metadataRing avrcMetadataRing;
+TaskHandle_t processAVRCTaskHandle;
+// Set on disconnect, the esPod forgot the track so the next burst must not be taken for a duplicate
+volatile bool avrcMetadataResetPending = false;
+// Set by the PREV/NEXT commands of the head unit : -1 or 1, for the task to apply the neighbour track from the cache
+volatile int8_t avrcNavigationPending = 0;
+// Play position between the AVRCP notifications, anchored from the BT callbacks and sent on by the AVRC task
+playPosition playClock;
+portMUX_TYPE playClockLock = portMUX_INITIALIZER_UNLOCKED;
+
+/// @brief Applies a coalesced track to the esPod, only the fields that changed. The title goes last, as a title
+/// change triggers the track change logic, which must see the rest of the track already up to date.
+/// @param track Coalesced track
+/// @param changed Mask of the trackField values that changed
+static void commitTrack(const trackRecord &track, uint8_t changed)
 {
-	vTaskDelay(1); // Purely out of precaution
+	if (changed & TRACK_ALBUM)
+		espod.updateAlbumName((char *)track.album);
+	if (changed & TRACK_ARTIST)
+		espod.updateArtistName((char *)track.artist);
+	if (changed & TRACK_DURATION)
+		espod.updateTrackDuration(track.durationMs);
+	// A new title starts the interpolation over, until the next position notification
+	portENTER_CRITICAL(&playClockLock);
+	if (changed & TRACK_TITLE)
+		playClock.setTrack(track.durationMs, esp_timer_get_time());
+	else if (changed & TRACK_DURATION)
+		playClock.setDuration(track.durationMs);
+	portEXIT_CRITICAL(&playClockLock);
+	if (changed & TRACK_TITLE) // Title change triggers the NEXT track if unexpected
+		espod.updateTrackTitle((char *)track.title);
 }
 
-#pragma region AVRC Task and Queue declaration/definition
-// Metadata universal structure
-struct avrcMetadata
+/// @brief Looks up the neighbour track in the cache right after a PREV/NEXT command, for the coalescer to expect.
+/// Nothing reaches the head unit before the phone sends the title : if it matches, the whole track is committed at once
+/// rather than after the burst, otherwise the phone's track goes through as usual. Either way the head unit sees a
+/// single track change.
+/// @param coalescer Coalescer of the AVRC task
+/// @param cache Track cache of the AVRC task
+/// @param step -1 for the previous track, 1 for the next one
+static void expectCachedNeighbour(trackCoalescer &coalescer, trackCache &cache, int8_t step)
 {
-	uint8_t id = 0;
-	uint8_t *payload = nullptr;
-};
+	portENTER_CRITICAL(&playClockLock);
+	uint32_t position = playClock.position(esp_timer_get_time());
+	portEXIT_CRITICAL(&playClockLock);
+	if (step < 0 && position >= PREV_RESTART_MS)
+		return; // Restarts the current track
+
+	const trackRecord *cached = cache.neighbour(step);
+	if (cached == nullptr)
+	{
+		ESP_LOGD(__func__, "Track cache miss, %lu hits %lu misses", cache.stats().hits, cache.stats().misses);
+		return;
+	}
+	coalescer.expect(*cached);
+	ESP_LOGD(__func__, "Track cache hit, %lu hits %lu misses : expecting %s", cache.stats().hits,
+			 cache.stats().misses, cached->title);
+}
 
-// AVRC Queue and Task
-QueueHandle_t avrcMetadataQueue;
-TaskHandle_t processAVRCTaskHandle;
+/// @brief Sends the interpolated play position to the esPod when nothing was sent for PLAY_POSITION_UPDATE_MS while
+/// playing, so that GetPlayStatus stays current between the AVRCP notifications, or without them
+/// @return ms until the position is due again, UINT32_MAX while paused
+static uint32_t sendPlayPosition()
+{
+	uint64_t nowUs = esp_timer_get_time();
+	portENTER_CRITICAL(&playClockLock);
+	bool due = playClock.msUntilSend(nowUs, PLAY_POSITION_UPDATE_MS) == 0;
+	if (due)
+		playClock.markSent(nowUs);
+	uint32_t position = playClock.position(nowUs);
+	uint32_t waitMs = playClock.msUntilSend(nowUs, PLAY_POSITION_UPDATE_MS);
+	portEXIT_CRITICAL(&playClockLock);
+	if (due)
+		espod.updatePlayPosition(position);
+	return waitMs;
+}
 
-/// @brief Low priority task to process a queue of received metadata
+/// @brief Low priority task to process the received metadata, woken up by the callback. Each AVRCP burst is coalesced
+/// into a single track, committed once the burst is over, and dropped altogether if nothing changed. Tracks are cached
+/// once settled, so that the history never holds one caught between two bursts, to answer the PREV/NEXT commands.
+/// While playing, the task also wakes to fill in the play position between late AVRCP notifications.
 /// @param pvParameters
 static void processAVRCTask(void *pvParameters)
 {
-	avrcMetadata incMetadata; // Incoming metadata (pointer to payload)
+	static metadataEntry incMetadata; // Incoming metadata, kept off the stack
+	static trackCoalescer coalescer;  // Holds a whole track, kept off the stack too
+	static trackCache cache;          // Recent tracks
+	metadataRingStats reported; // Counters at the last warning
+	uint32_t positionWaitMs = UINT32_MAX; // Until the play position is due, UINT32_MAX while paused
 
-#ifdef STACK_HIGH_WATERMARK_LOG
-	UBaseType_t uxHighWaterMark;
-	UBaseType_t minHightWaterMark = PROCESS_AVRC_TASK_STACK_SIZE;
-#endif
-
-	// Main loop
+	// Main loop, stack usage is covered by the telemetry task
 	while (true)
 	{
-// Stack high watermark logging
-#ifdef STACK_HIGH_WATERMARK_LOG
-		uxHighWaterMark = uxTaskGetStackHighWaterMark(NULL);
-		if (uxHighWaterMark < minHightWaterMark)
+		// Block until a callback signals new metadata or a new playing state, or until the pending burst, the settling
+		// track or the play position is due, then empty the ring
+		uint32_t waitMs = coalescer.pending() ? coalescer.msUntilDue(millis()) : coalescer.msUntilSettled(millis());
+		waitMs = (positionWaitMs < waitMs) ? positionWaitMs : waitMs;
+		ulTaskNotifyTake(pdTRUE, (waitMs == UINT32_MAX) ? portMAX_DELAY : pdMS_TO_TICKS(waitMs));
+		if (avrcMetadataResetPending)
 		{
-			minHightWaterMark = uxHighWaterMark;
-			ESP_LOGI("HWM", "Process AVRC Task High Watermark: %d, used stack: %d", minHightWaterMark,
-					 PROCESS_AVRC_TASK_STACK_SIZE - minHightWaterMark);
+			avrcMetadataResetPending = false;
+			coalescer.reset();
+			cache.resetHistory();
 		}
-#endif
-		// Check incoming metadata in queue, block indefinitely if there is nothing
-		if (xQueueReceive(avrcMetadataQueue, &incMetadata, portMAX_DELAY) == pdTRUE)
+		int8_t step = avrcNavigationPending;
+		if (step != 0)
+		{
+			avrcNavigationPending = 0;
+			expectCachedNeighbour(coalescer, cache, step);
+		}
+		while (avrcMetadataRing.pop(incMetadata))
 		{
-			if (incMetadata.payload != nullptr)
+			switch (incMetadata.id)
 			{
-				// Start processing
-				switch (incMetadata.id)
-				{
-				case ESP_AVRC_MD_ATTR_ALBUM:
-
-					espod.updateAlbumName((char *)incMetadata.payload);
-					break;
-
-				case ESP_AVRC_MD_ATTR_ARTIST:
-					espod.updateArtistName((char *)incMetadata.payload);
-					break;
-
-				case ESP_AVRC_MD_ATTR_TITLE: // Title change triggers the NEXT track if unexpected
-					espod.updateTrackTitle((char *)incMetadata.payload);
-					break;
-
-				case ESP_AVRC_MD_ATTR_PLAYING_TIME:
-					espod.updateTrackDuration(atoi((char *)incMetadata.payload));
-					break;
-				}
-
-				// End Processing, deallocate memory
-				free(incMetadata.payload);
-				incMetadata.payload = nullptr;
+			case ESP_AVRC_MD_ATTR_ALBUM:
+				coalescer.add(TRACK_ALBUM, incMetadata.text, millis());
+				break;
+
+			case ESP_AVRC_MD_ATTR_ARTIST:
+				coalescer.add(TRACK_ARTIST, incMetadata.text, millis());
+				break;
+
+			case ESP_AVRC_MD_ATTR_TITLE:
+				coalescer.add(TRACK_TITLE, incMetadata.text, millis());
+				break;
+
+			case ESP_AVRC_MD_ATTR_PLAYING_TIME:
+				coalescer.add(TRACK_DURATION, incMetadata.text, millis());
+				break;
 			}
 		}
+		if (coalescer.pending() && coalescer.msUntilDue(millis()) == 0)
+		{
+			uint8_t changed = coalescer.commit();
+			if (changed)
+				commitTrack(coalescer.record(), changed);
+			else
+				ESP_LOGD(__func__, "Duplicate metadata burst dropped, %lu so far", coalescer.stats().duplicateBursts);
+		}
+		if (coalescer.settle(millis()))
+			cache.played(coalescer.record());
+		positionWaitMs = sendPlayPosition();
+
+		// Report the losses here rather than in the BT callback
+		metadataRingStats current = avrcMetadataRing.stats();
+		if (current.overwritten != reported.overwritten || current.truncated != reported.truncated)
+		{
+			ESP_LOGW(__func__, "Metadata ring : %lu entries overwritten, %lu truncated to %d bytes (%lu pushed)",
+					 current.overwritten, current.truncated, METADATA_TEXT_SIZE - 1, current.pushed);
+			reported = current;
+		}
 	}
 }
+
+/// @brief Asks the AVRC task to apply the neighbour track from the cache, on the PREV/NEXT commands
+/// @param step -1 for the previous track, 1 for the next one
+static void requestCachedNeighbour(int8_t step)
+{
+	avrcNavigationPending = step;
+	if (processAVRCTaskHandle != nullptr)
+		xTaskNotifyGive(processAVRCTaskHandle);
+}
 #pragma endregion
 
 #pragma region Helper Function Definitions
 
-/// @brief Configures the CODEC or DAC and starts the A2DP Sink
-void initializeA2DPSink()
+/// @brief Starts the I2S output, and the codec on the AudioKit, with the DMA buffers of a profile at the current rate
+/// @param profile Buffering profile
+void beginI2S(const bufferProfile &profile)
 {
 #ifdef AUDIOKIT
-	minimalPins.addI2C(PinFunction::CODEC, 32, 33);
-	minimalPins.addI2S(PinFunction::CODEC, 0, BCLK_PIN, WS_PIN, DIN_PIN, 35);
-	// a2dp_sink.set_stream_reader(read_data_stream, false); // Might need commenting out
 	auto cfg = i2s.defaultConfig();
 	cfg.copyFrom(info);
-	i2s.begin(cfg);
 #else
-	a2dp_sink.set_stream_reader(read_data_stream, false);
 	auto cfg = i2s.defaultConfig(TX_MODE);
 	cfg.pin_ws = WS_PIN;
 	cfg.pin_data = DIN_PIN;
 	cfg.pin_bck = BCLK_PIN;
-	cfg.sample_rate = 44100;
 	cfg.i2s_format = I2S_LSB_FORMAT;
+#endif
+	cfg.sample_rate = outputSampleRate;
+	cfg.buffer_count = profile.i2sBufferCount;
+	cfg.buffer_size = profile.i2sBufferFrames;
+	i2sBufferCount = cfg.buffer_count;
+	i2sBufferFrames = cfg.buffer_size;
 	i2s.begin(cfg);
+}
+
+/// @brief Configures the CODEC or DAC and starts the A2DP Sink
+void initializeA2DPSink()
+{
+#ifdef AUDIOKIT
+	minimalPins.addI2C(PinFunction::CODEC, 32, 33);
+	minimalPins.addI2S(PinFunction::CODEC, 0, BCLK_PIN, WS_PIN, DIN_PIN, 35);
 #endif
+	beginI2S(getBufferProfile(activeBufferProfile));
+	logBufferProfile(getBufferProfile(activeBufferProfile));
 
-	a2dp_sink.set_auto_reconnect(true, 10000);
+	// The decoded PCM only goes to the ring, the writer task feeds the I2S
+	a2dp_sink.set_stream_reader(read_data_stream, false);
+	// Reconnects go through reconnectLastPeer() only, at boot and after a lost link
+	a2dp_sink.set_auto_reconnect(false);
 	a2dp_sink.set_on_connection_state_changed(connectionStateChanged);
 	a2dp_sink.set_on_audio_state_changed(audioStateChanged);
+	// With a stream reader, the library leaves the output alone : the writer task follows the negotiated rate
+	a2dp_sink.set_sample_rate_callback(sampleRateChanged);
 	a2dp_sink.set_avrc_metadata_callback(avrc_metadata_callback);
 	a2dp_sink.set_avrc_metadata_attribute_mask(ESP_AVRC_MD_ATTR_TITLE | ESP_AVRC_MD_ATTR_ARTIST |
 											   ESP_AVRC_MD_ATTR_ALBUM | ESP_AVRC_MD_ATTR_PLAYING_TIME);
 	a2dp_sink.set_avrc_rn_play_pos_callback(avrc_rn_play_pos_callback, 1);
+	// Before start(), so that a phone connecting right away is stored
+	bool peerTimersReady = initializePeerTimers() == ESP_OK;
+	if (!peerTimersReady)
+		ESP_LOGE(__func__, "Failed to create the reconnect timers, discoverable");
 
 	a2dp_sink.start(A2DP_SINK_NAME);
 
 	ESP_LOGI(__func__, "a2dp_sink started: %s", A2DP_SINK_NAME);
 	delay(5);
+	if (peerTimersReady)
+		reconnectLastPeer();
 }
 
-/// @brief Initializes the AVRC metadata queue, and attempts to start the
-/// related task
-/// @return ESP_FAIL if the queue or task could not be created, ESP_OK otherwise
-esp_err_t initializeAVRCTask()
+/// @brief Makes the sink discoverable if the directed reconnect did not succeed in time
+/// @param arg Not used
+static void reconnectTimeout(void *arg)
+{
+	if (a2dp_sink.get_connection_state() == ESP_A2D_CONNECTION_STATE_CONNECTED)
+		return;
+	ESP_LOGI(__func__, "Last phone did not reconnect within %d ms, now discoverable", RECONNECT_TIMEOUT_MS);
+	a2dp_sink.set_discoverability(ESP_BT_GENERAL_DISCOVERABLE);
+}
+
+/// @brief Reconnects to the last phone after a lost link, from the timer task rather than the BT callback
+/// @param arg Not used
+static void linkLost(void *arg)
+{
+	if (a2dp_sink.get_connection_state() == ESP_A2D_CONNECTION_STATE_DISCONNECTED)
+		reconnectLastPeer();
+}
+
+/// @brief Stores the connected phone in NVS for the next boot, from the timer task rather than the BT callback. Only
+/// when it changed, to spare the flash.
+/// @param arg Not used
+static void storePeer(void *arg)
+{
+	esp_bd_addr_t *peer = a2dp_sink.get_current_peer_address();
+	if (peer == nullptr || a2dp_sink.get_connection_state() != ESP_A2D_CONNECTION_STATE_CONNECTED)
+		return;
+	if (storedPeerValid && memcmp(storedPeer, *peer, sizeof(storedPeer)) == 0)
+		return;
+	Preferences peerStore;
+	peerStore.begin("lastPeer", false);
+	if (peerStore.putBytes("address", *peer, sizeof(esp_bd_addr_t)) == sizeof(esp_bd_addr_t))
+	{
+		memcpy(storedPeer, *peer, sizeof(storedPeer));
+		storedPeerValid = true;
+		ESP_LOGI(__func__, "Phone stored for the next boot");
+	}
+	peerStore.end();
+}
+
+/// @brief Loads the last phone from NVS and creates the timers of the reconnects and of its storage
+/// @return ESP_FAIL if a timer could not be created, ESP_OK otherwise
+esp_err_t initializePeerTimers()
+{
+	Preferences peerStore;
+	peerStore.begin("lastPeer", true);
+	storedPeerValid = peerStore.getBytes("address", storedPeer, sizeof(storedPeer)) == sizeof(storedPeer);
+	peerStore.end();
+
+	esp_timer_create_args_t timerArgs = {};
+	timerArgs.callback = reconnectTimeout;
+	timerArgs.name = "reconnect";
+	if (esp_timer_create(&timerArgs, &reconnectTimer) != ESP_OK)
+		return ESP_FAIL;
+	timerArgs.callback = linkLost;
+	timerArgs.name = "linkLoss";
+	if (esp_timer_create(&timerArgs, &linkLossTimer) != ESP_OK)
+		return ESP_FAIL;
+	timerArgs.callback = storePeer;
+	timerArgs.name = "peerStore";
+	if (esp_timer_create(&timerArgs, &peerStoreTimer) != ESP_OK)
+		return ESP_FAIL;
+	return ESP_OK;
+}
+
+/// @brief Connects straight to the last phone, hidden from other devices for RECONNECT_TIMEOUT_MS, then falls back to
+/// discoverable. Without a stored phone, the sink stays discoverable.
+void reconnectLastPeer()
+{
+	if (!storedPeerValid)
+	{
+		ESP_LOGI(__func__, "No phone stored, discoverable");
+		return;
+	}
+
+	ESP_LOGI(__func__, "Reconnecting to %02x:%02x:%02x:%02x:%02x:%02x", storedPeer[0], storedPeer[1], storedPeer[2],
+			 storedPeer[3], storedPeer[4], storedPeer[5]);
+	a2dp_sink.set_discoverability(ESP_BT_NON_DISCOVERABLE);
+	if (!a2dp_sink.connect_to(storedPeer))
+		ESP_LOGW(__func__, "Directed reconnect could not be started");
+
+	esp_timer_stop(reconnectTimer); // Restarted if a previous attempt is still timing
+	if (esp_timer_start_once(reconnectTimer, RECONNECT_TIMEOUT_MS * 1000) != ESP_OK)
+	{
+		ESP_LOGE(__func__, "Failed to start the reconnect timer, discoverable");
+		a2dp_sink.set_discoverability(ESP_BT_GENERAL_DISCOVERABLE);
+	}
+}
+
+/// @brief Sizes the PCM ring for a profile, within the storage. Only while the producer is idle.
+/// @param profile Buffering profile
+/// @return false if the ring has no storage
+bool configurePCMRing(const bufferProfile &profile)
 {
-	avrcMetadataQueue = xQueueCreate(AVRC_QUEUE_SIZE, sizeof(avrcMetadata));
-	if (avrcMetadataQueue == nullptr)
+	uint32_t size = profile.ringSize;
+	uint32_t prefill = profile.ringPrefill;
+	if (clampRingSettings(PCM_RING_SIZE, size, prefill))
+		ESP_LOGW(__func__, "%s profile clamped : ring %lu bytes, prefill %lu bytes instead of %lu and %lu", profile.name,
+				 size, prefill, profile.ringSize, profile.ringPrefill);
+	if (!dmaFitsPrefill(profile.i2sBufferCount * profile.i2sBufferFrames * PCM_FRAME_BYTES, prefill))
+		ESP_LOGW(__func__, "%s profile DMA not under the prefill minus one A2DP packet, expect dropouts", profile.name);
+	return pcmBuffer.begin(pcmStorage, size, prefill);
+}
+
+/// @brief Logs the buffers of a profile and the delay they add at the current rate. The output starts with the first
+/// write, so the nominal delay is the prefill, on top of what the A2DP stack holds.
+/// @param profile Buffering profile
+void logBufferProfile(const bufferProfile &profile)
+{
+	ESP_LOGI(__func__, "%s profile : DMA %lu x %lu frames (%lu ms), ring %lu bytes (%lu ms), nominal latency %lu ms",
+			 profile.name, i2sBufferCount, i2sBufferFrames,
+			 pcmBytesToMs(i2sBufferCount * i2sBufferFrames * PCM_FRAME_BYTES, outputSampleRate), pcmBuffer.capacity(),
+			 pcmBytesToMs(pcmBuffer.capacity(), outputSampleRate), pcmBytesToMs(pcmBuffer.prefill(), outputSampleRate));
+}
+
+/// @brief Asks the writer task to switch buffering profile, as soon as no stream is playing
+/// @param id Requested profile
+void requestBufferProfile(bufferProfileId id)
+{
+	if (pcmStreaming)
+		ESP_LOGI(__func__, "%s profile applied when the stream stops", getBufferProfile(id).name);
+	pendingBufferProfile = id;
+	if (pcmWriterTaskHandle != nullptr)
+		xTaskNotifyGive(pcmWriterTaskHandle);
+}
+
+/// @brief Allocates the PCM ring, in PSRAM when available, and starts the I2S writer task
+/// @return ESP_FAIL if the ring could not be allocated or the task could not be created, ESP_OK otherwise
+esp_err_t initializePCMWriter()
+{
+#ifdef BOARD_HAS_PSRAM
+	pcmStorage = (uint8_t *)heap_caps_malloc(PCM_RING_SIZE, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+#endif
+	if (pcmStorage == nullptr)
+		pcmStorage = (uint8_t *)heap_caps_malloc(PCM_RING_SIZE, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+	if (!configurePCMRing(getBufferProfile(activeBufferProfile)))
 	{
-		ESP_LOGE(__func__, "Failed to create metadata queue");
+		ESP_LOGE(__func__, "Failed to allocate the %d bytes PCM ring", PCM_RING_SIZE);
 		return ESP_FAIL;
 	}
 
+	xTaskCreatePinnedToCore(pcmWriterTask, "pcmWriterTask", PCM_WRITER_TASK_STACK_SIZE, NULL, PCM_WRITER_TASK_PRIORITY,
+							&pcmWriterTaskHandle, PCM_WRITER_CORE);
+	if (pcmWriterTaskHandle == nullptr)
+	{
+		ESP_LOGE(__func__, "Failed to create pcmWriterTask");
+		return ESP_FAIL;
+	}
+	ESP_LOGI(__func__, "PCM ring storage of %d bytes in %s", PCM_RING_SIZE,
+			 esp_ptr_external_ram(pcmStorage) ? "PSRAM" : "DRAM");
+
+#ifdef ENABLE_PCM_DSP
+	dsp.setSampleRate(PCM_DEFAULT_SAMPLE_RATE);
+	dsp.setGainDb(PCM_DSP_GAIN_DB);
+	dsp.setBand(0, PCM_DSP_BASS_DB ? DSP_BAND_LOW_SHELF : DSP_BAND_OFF, PCM_DSP_BASS_HZ, 0.707f, PCM_DSP_BASS_DB);
+	dsp.setBand(1, PCM_DSP_TREBLE_DB ? DSP_BAND_HIGH_SHELF : DSP_BAND_OFF, PCM_DSP_TREBLE_HZ, 0.707f, PCM_DSP_TREBLE_DB);
+	dsp.setLimiter(PCM_DSP_LIMITER_DB, PCM_DSP_RELEASE_MS);
+#endif
+	return ESP_OK;
+}
+
+/// @brief Attempts to start the task processing the AVRC metadata ring
+/// @return ESP_FAIL if the task could not be created, ESP_OK otherwise
+esp_err_t initializeAVRCTask()
+{
 	xTaskCreatePinnedToCore(processAVRCTask, "processAVRCTask", PROCESS_AVRC_TASK_STACK_SIZE, NULL,
 							PROCESS_AVRC_TASK_PRIORITY, &processAVRCTaskHandle, ARDUINO_RUNNING_CORE);
 	if (processAVRCTaskHandle == nullptr)
@@ -285,6 +834,16 @@ void connectionStateChanged(esp_a2d_connection_state_t state, void *ptr)
 	case ESP_A2D_CONNECTION_STATE_CONNECTED:
 		ESP_LOGD(__func__, "ESP_A2D_CONNECTION_STATE_CONNECTED, espod enabled");
 		espod.disabled = false;
+		if (peerConnectedUs == 0)
+		{
+			peerConnectedUs = esp_timer_get_time();
+			ESP_LOGI(__func__, "Peer connected %lu ms after boot: %s", (uint32_t)(peerConnectedUs / 1000),
+					 a2dp_sink.get_peer_name());
+		}
+		peerLinked = true;
+		// The NVS write, if the phone is a new one, is left to the timer task
+		if (peerStoreTimer != nullptr)
+			esp_timer_start_once(peerStoreTimer, 0);
 		// Meant to pre-fetch playing status
 		ESP_LOGI(__func__, "Attempting to send play request.");
 		a2dp_sink.play();
@@ -296,6 +855,13 @@ void connectionStateChanged(esp_a2d_connection_state_t state, void *ptr)
 		ESP_LOGD(__func__, "ESP_A2D_CONNECTION_STATE_DISCONNECTED, espod disabled");
 		espod.resetState();
 		espod.disabled = true;
+		avrcMetadataResetPending = true;
+		if (processAVRCTaskHandle != nullptr)
+			xTaskNotifyGive(processAVRCTaskHandle);
+		// Only a link that was up is reconnected, so that a failed attempt does not start another one
+		if (peerLinked && linkLossTimer != nullptr)
+			esp_timer_start_once(linkLossTimer, 0);
+		peerLinked = false;
 #ifdef LED_BUILTIN
 		digitalWrite(LED_BUILTIN, INVERT_LED_LOGIC(LOW));
 #endif
@@ -316,24 +882,49 @@ void audioStateChanged(esp_a2d_audio_state_t state, void *ptr)
 	switch (state)
 	{
 	case ESP_A2D_AUDIO_STATE_STARTED:
+		pcmStreaming = true;
+		if (streamStartedUs == 0)
+			streamStartedUs = esp_timer_get_time();
 		espod.play(true);
 		break;
 	case ESP_A2D_AUDIO_STATE_REMOTE_SUSPEND:
+		pcmStreaming = false;
 		espod.pause(true);
 		break;
-		// case ESP_A2D_AUDIO_STATE_STOPPED:
+	case ESP_A2D_AUDIO_STATE_STOPPED:
+		pcmStreaming = false;
 		//  espod.stop();
-		// 	break;
+		break;
 	}
+	// The position only advances while the stream plays
+	portENTER_CRITICAL(&playClockLock);
+	playClock.setPlaying(state == ESP_A2D_AUDIO_STATE_STARTED, esp_timer_get_time());
+	portEXIT_CRITICAL(&playClockLock);
+	if (processAVRCTaskHandle != nullptr) // Paces the play position again
+		xTaskNotifyGive(processAVRCTaskHandle);
+}
+
+/// @brief Callback on the A2DP codec configuration, hands the negotiated sample rate over to the writer task
+/// @param rate Sample rate of the SBC stream, in Hz
+void sampleRateChanged(uint16_t rate)
+{
+	ESP_LOGD(__func__, "Source negotiated %u Hz", rate);
+	pendingSampleRate = rate;
+	if (pcmWriterTaskHandle != nullptr)
+		xTaskNotifyGive(pcmWriterTaskHandle);
 }
 
 /// @brief Play position callback returning the ms spent since start on every
-/// interval - normally 1s
+/// interval - normally 1s. Re-anchors the interpolated position.
 /// @param play_pos Playing Position in ms
 void avrc_rn_play_pos_callback(uint32_t play_pos)
 {
+	portENTER_CRITICAL(&playClockLock);
+	playClock.anchor(play_pos, esp_timer_get_time());
+	int32_t correction = playClock.stats().lastCorrectionMs;
+	portEXIT_CRITICAL(&playClockLock);
 	espod.updatePlayPosition(play_pos);
-	ESP_LOGV(__func__, "PlayPosition called");
+	ESP_LOGV(__func__, "PlayPosition called, interpolation off by %ld ms", correction);
 }
 
 /// @brief Catch callback for the AVRC metadata. There can be duplicates !
@@ -354,21 +945,10 @@ void avrc_metadata_callback(uint8_t id, const uint8_t *text)
 		return;
 	}
 
-	avrcMetadata incMetadata;
-	incMetadata.id = id;
-	incMetadata.payload = (uint8_t *)strdup((const char *)text);
-
-	if (incMetadata.payload == nullptr)
-	{
-		ESP_LOGE(__func__, "Memory allocation failed for metadata");
-		return;
-	}
-
-	if (xQueueSend(avrcMetadataQueue, &incMetadata, 0) != pdTRUE)
-	{
-		ESP_LOGW(__func__, "Metadata queue full, discarding metadata");
-		free(incMetadata.payload);
-	}
+	// Copy into a preallocated slot, the oldest entry is overwritten if the task is lagging behind
+	avrcMetadataRing.push(id, (const char *)text);
+	if (processAVRCTaskHandle != nullptr)
+		xTaskNotifyGive(processAVRCTaskHandle);
 }
 
 /// @brief Callback function that passes intended playback operations from the
@@ -392,18 +972,22 @@ void playStatusHandler(PB_COMMAND playCommand)
 		break;
 	case PB_CMD_PREVIOUS_TRACK:
 		a2dp_sink.previous();
+		requestCachedNeighbour(-1);
 		ESP_LOGD(__func__, "A2DP_REWIND");
 		break;
 	case PB_CMD_NEXT_TRACK:
 		a2dp_sink.next();
+		requestCachedNeighbour(1);
 		ESP_LOGD(__func__, "A2DP_NEXT");
 		break;
 	case PB_CMD_NEXT:
 		a2dp_sink.next();
+		requestCachedNeighbour(1);
 		ESP_LOGD(__func__, "A2DP_NEXT");
 		break;
 	case PB_CMD_PREV:
 		a2dp_sink.previous();
+		requestCachedNeighbour(-1);
 		ESP_LOGD(__func__, "A2DP_PREV");
 		break;
 	}
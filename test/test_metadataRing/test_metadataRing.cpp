@@ -0,0 +1,162 @@
+#include <unity.h>
+#include <atomic>
+#include <stdio.h>
+#include <string.h>
+#include <thread>
+
+#include "metadataRing.h"
+
+#pragma region Helpers
+#define STRESS_PUSHES 2000000
+#define STRESS_REPEATS 8 // Copies of the sequence number in a text, so that a torn copy shows
+
+/// @brief Text of the n-th stress entry : its sequence number, repeated
+static void stressText(uint32_t sequence, char *text)
+{
+    for (uint32_t i = 0; i < STRESS_REPEATS; i++)
+        snprintf(text + 9 * i, 10, "%08lx ", (unsigned long)sequence);
+}
+
+/// @brief Checks that every copy of the sequence number in a text is the same
+/// @return The sequence number, or UINT32_MAX if the copy is torn
+static uint32_t stressSequence(const metadataEntry &entry)
+{
+    if (entry.length != 9 * STRESS_REPEATS)
+        return UINT32_MAX;
+    unsigned long sequence = 0;
+    if (sscanf(entry.text, "%08lx", &sequence) != 1)
+        return UINT32_MAX;
+    char expected[9 * STRESS_REPEATS + 1];
+    stressText((uint32_t)sequence, expected);
+    if (memcmp(entry.text, expected, entry.length) != 0 || entry.id != (uint8_t)sequence)
+        return UINT32_MAX;
+    return (uint32_t)sequence;
+}
+#pragma endregion
+
+#pragma region Tests
+void setUp() {}
+void tearDown() {}
+
+void test_entries_come_out_in_order()
+{
+    metadataRing ring;
+    metadataEntry entry;
+    TEST_ASSERT_FALSE(ring.pop(entry));
+    TEST_ASSERT_TRUE(ring.push(1, "Title"));
+    TEST_ASSERT_TRUE(ring.push(2, "Artist"));
+    TEST_ASSERT_EQUAL_UINT32(2, ring.size());
+    TEST_ASSERT_TRUE(ring.pop(entry));
+    TEST_ASSERT_EQUAL_UINT8(1, entry.id);
+    TEST_ASSERT_EQUAL_STRING("Title", entry.text);
+    TEST_ASSERT_TRUE(ring.pop(entry));
+    TEST_ASSERT_EQUAL_UINT8(2, entry.id);
+    TEST_ASSERT_EQUAL_UINT16(6, entry.length);
+    TEST_ASSERT_FALSE(ring.pop(entry));
+}
+
+void test_long_text_is_cut_on_a_character_boundary()
+{
+    metadataRing ring;
+    metadataEntry entry;
+    char text[METADATA_TEXT_SIZE + 8];
+    memset(text, 'a', sizeof(text));
+    // A 2-byte character straddling the limit
+    text[METADATA_TEXT_SIZE - 2] = (char)0xC3;
+    text[METADATA_TEXT_SIZE - 1] = (char)0xA9;
+    text[sizeof(text) - 1] = '\0';
+    ring.push(1, text);
+    TEST_ASSERT_TRUE(ring.pop(entry));
+    TEST_ASSERT_EQUAL_UINT16(METADATA_TEXT_SIZE - 2, entry.length);
+    TEST_ASSERT_EQUAL_UINT32(strlen(entry.text), entry.length);
+    TEST_ASSERT_EQUAL_UINT32(1, ring.stats().truncated);
+}
+
+void test_full_ring_overwrites_the_oldest_entry()
+{
+    metadataRing ring;
+    metadataEntry entry;
+    char text[16];
+    for (uint32_t i = 0; i < METADATA_RING_SIZE; i++)
+    {
+        snprintf(text, sizeof(text), "%lu", (unsigned long)i);
+        TEST_ASSERT_TRUE(ring.push((uint8_t)i, text));
+    }
+    TEST_ASSERT_FALSE(ring.push(0xFF, "Newest"));
+    TEST_ASSERT_EQUAL_UINT32(METADATA_RING_SIZE, ring.size());
+    TEST_ASSERT_TRUE(ring.pop(entry));
+    TEST_ASSERT_EQUAL_UINT8(1, entry.id);
+    for (uint32_t i = 2; i < METADATA_RING_SIZE; i++)
+        TEST_ASSERT_TRUE(ring.pop(entry));
+    TEST_ASSERT_TRUE(ring.pop(entry));
+    TEST_ASSERT_EQUAL_STRING("Newest", entry.text);
+
+    metadataRingStats stats = ring.stats();
+    TEST_ASSERT_EQUAL_UINT32(METADATA_RING_SIZE + 1, stats.pushed);
+    TEST_ASSERT_EQUAL_UINT32(METADATA_RING_SIZE, stats.popped);
+    TEST_ASSERT_EQUAL_UINT32(1, stats.overwritten);
+}
+
+/// @brief A producer that never waits races a slower consumer, so that the producer keeps taking back the slot the
+/// consumer is copying. Every entry popped must be whole and newer than the previous one, and none may be lost
+/// without being counted.
+void test_overwrite_race_never_hands_out_torn_entries()
+{
+    metadataRing ring;
+    std::atomic<bool> done{false};
+    uint32_t torn = 0;
+    uint32_t reordered = 0;
+    uint32_t popped = 0;
+
+    std::thread consumer([&]()
+                         {
+        metadataEntry entry;
+        uint32_t previous = UINT32_MAX;
+        while (true)
+        {
+            bool finished = done.load(std::memory_order_acquire);
+            if (!ring.pop(entry))
+            {
+                if (finished)
+                    break;
+                std::this_thread::yield();
+                continue;
+            }
+            popped++;
+            uint32_t sequence = stressSequence(entry);
+            if (sequence == UINT32_MAX)
+                torn++;
+            else if (previous != UINT32_MAX && sequence <= previous)
+                reordered++;
+            else
+                previous = sequence;
+        } });
+
+    char text[9 * STRESS_REPEATS + 1];
+    for (uint32_t sequence = 0; sequence < STRESS_PUSHES; sequence++)
+    {
+        stressText(sequence, text);
+        ring.push((uint8_t)sequence, text);
+    }
+    done.store(true, std::memory_order_release);
+    consumer.join();
+
+    metadataRingStats stats = ring.stats();
+    TEST_ASSERT_EQUAL_UINT32(0, torn);
+    TEST_ASSERT_EQUAL_UINT32(0, reordered);
+    TEST_ASSERT_EQUAL_UINT32(STRESS_PUSHES, stats.pushed);
+    TEST_ASSERT_EQUAL_UINT32(popped, stats.popped);
+    TEST_ASSERT_EQUAL_UINT32(STRESS_PUSHES, stats.popped + stats.overwritten);
+    TEST_ASSERT_EQUAL_UINT32(0, ring.size());
+}
+#pragma endregion
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_entries_come_out_in_order);
+    RUN_TEST(test_long_text_is_cut_on_a_character_boundary);
+    RUN_TEST(test_full_ring_overwrites_the_oldest_entry);
+    RUN_TEST(test_overwrite_race_never_hands_out_torn_entries);
+    return UNITY_END();
+}
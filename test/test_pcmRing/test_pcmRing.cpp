@@ -0,0 +1,201 @@
+#include <unity.h>
+#include <atomic>
+#include <string.h>
+#include <thread>
+
+#include "pcmRing.h"
+
+#pragma region Helpers
+#define RING_SIZE 256
+#define STRESS_BYTES (16u * 1024 * 1024)
+
+static uint8_t storage[RING_SIZE];
+
+/// @brief Fills a buffer with a byte pattern that carries on from start
+static void pattern(uint8_t *data, uint32_t len, uint32_t start)
+{
+    for (uint32_t i = 0; i < len; i++)
+        data[i] = (uint8_t)((start + i) * 7);
+}
+#pragma endregion
+
+#pragma region Tests
+void setUp() { memset(storage, 0, sizeof(storage)); }
+void tearDown() {}
+
+void test_begin_rejects_bad_storage()
+{
+    pcmRing ring;
+    TEST_ASSERT_FALSE(ring.begin(nullptr, RING_SIZE, 0));
+    TEST_ASSERT_FALSE(ring.begin(storage, RING_SIZE - 4, 0));
+    TEST_ASSERT_TRUE(ring.begin(storage, RING_SIZE, 2 * RING_SIZE));
+    TEST_ASSERT_EQUAL_UINT32(RING_SIZE, ring.prefill());
+    ring.setPrefill(63);
+    TEST_ASSERT_EQUAL_UINT32(60, ring.prefill());
+}
+
+void test_read_waits_for_the_prefill_level()
+{
+    pcmRing ring;
+    uint8_t data[RING_SIZE];
+    ring.begin(storage, RING_SIZE, 128);
+    pattern(data, sizeof(data), 0);
+    TEST_ASSERT_EQUAL_UINT32(124, ring.write(data, 124));
+    TEST_ASSERT_EQUAL_UINT32(0, ring.read(data, sizeof(data)));
+    TEST_ASSERT_FALSE(ring.primed());
+    TEST_ASSERT_EQUAL_UINT32(4, ring.write(data, 4));
+    TEST_ASSERT_EQUAL_UINT32(64, ring.read(data, 64));
+    TEST_ASSERT_TRUE(ring.primed());
+    // Primed : whatever is there is handed out, below the prefill too
+    TEST_ASSERT_EQUAL_UINT32(64, ring.read(data, sizeof(data)));
+}
+
+void test_running_dry_primes_again_and_counts_an_underrun()
+{
+    pcmRing ring;
+    uint8_t data[RING_SIZE];
+    ring.begin(storage, RING_SIZE, 64);
+    ring.write(data, 64);
+    TEST_ASSERT_EQUAL_UINT32(64, ring.read(data, sizeof(data)));
+    TEST_ASSERT_EQUAL_UINT32(0, ring.read(data, sizeof(data)));
+    TEST_ASSERT_FALSE(ring.primed());
+    TEST_ASSERT_EQUAL_UINT32(1, ring.stats().underruns);
+    ring.write(data, 32);
+    TEST_ASSERT_EQUAL_UINT32(0, ring.read(data, sizeof(data)));
+}
+
+void test_data_survives_the_wraparound()
+{
+    pcmRing ring;
+    uint8_t in[RING_SIZE], out[RING_SIZE];
+    ring.begin(storage, RING_SIZE, 0);
+    uint32_t written = 0, read = 0;
+    // Odd-sized chunks so that every offset of the wraparound is crossed, what does not fit is left out of the pattern
+    for (uint32_t round = 0; round < 200; round++)
+    {
+        uint32_t len = 4 * (1 + round % 37);
+        pattern(in, len, written);
+        written += ring.write(in, len);
+        uint32_t got = ring.read(out, 4 * (1 + (round + 11) % 37));
+        uint8_t expected[RING_SIZE];
+        pattern(expected, got, read);
+        TEST_ASSERT_EQUAL_HEX8_ARRAY(expected, out, got);
+        read += got;
+    }
+    TEST_ASSERT_EQUAL_UINT32(written - read, ring.fill());
+}
+
+void test_write_past_capacity_is_dropped_frame_aligned()
+{
+    pcmRing ring;
+    uint8_t data[RING_SIZE + 8];
+    ring.begin(storage, RING_SIZE, 0);
+    TEST_ASSERT_EQUAL_UINT32(RING_SIZE - 8, ring.write(data, RING_SIZE - 8));
+    TEST_ASSERT_EQUAL_UINT32(8, ring.write(data, 14));
+    TEST_ASSERT_EQUAL_UINT32(0, ring.write(data, 4));
+    pcmRingStats stats = ring.stats();
+    TEST_ASSERT_EQUAL_UINT32(2, stats.overruns);
+    TEST_ASSERT_EQUAL_UINT32(6 + 4, stats.overrunBytes);
+    TEST_ASSERT_EQUAL_UINT32(RING_SIZE, stats.peakFill);
+}
+
+void test_flush_drains_a_tail_shorter_than_the_prefill()
+{
+    pcmRing ring;
+    uint8_t data[RING_SIZE];
+    ring.begin(storage, RING_SIZE, 128);
+    ring.write(data, 40);
+    TEST_ASSERT_EQUAL_UINT32(0, ring.read(data, sizeof(data)));
+    ring.flush();
+    TEST_ASSERT_EQUAL_UINT32(40, ring.read(data, sizeof(data)));
+    TEST_ASSERT_EQUAL_UINT32(0, ring.fill());
+    // Nothing left : flushing again does not prime an empty ring
+    ring.clear();
+    ring.flush();
+    TEST_ASSERT_FALSE(ring.primed());
+}
+
+void test_clear_drops_the_buffered_pcm()
+{
+    pcmRing ring;
+    uint8_t data[RING_SIZE];
+    ring.begin(storage, RING_SIZE, 64);
+    ring.write(data, 128);
+    TEST_ASSERT_EQUAL_UINT32(64, ring.read(data, 64));
+    ring.clear();
+    TEST_ASSERT_EQUAL_UINT32(0, ring.fill());
+    TEST_ASSERT_FALSE(ring.primed());
+    TEST_ASSERT_EQUAL_UINT32(0, ring.stats().underruns);
+}
+
+/// @brief A producer and a consumer run flat out on their own threads. The producer retries what did not fit, so the
+/// consumer must see the byte pattern without a gap, a repeat or a torn chunk.
+void test_spsc_stress_keeps_the_stream_intact()
+{
+    static uint8_t stressStorage[4096];
+    pcmRing ring;
+    ring.begin(stressStorage, sizeof(stressStorage), 1024);
+    std::atomic<bool> done{false};
+    uint32_t mismatches = 0;
+    uint32_t readTotal = 0;
+
+    std::thread consumer([&]()
+                         {
+        uint8_t out[700];
+        while (true)
+        {
+            bool finished = done.load(std::memory_order_acquire);
+            if (finished)
+                ring.flush();
+            uint32_t got = ring.read(out, sizeof(out));
+            for (uint32_t i = 0; i < got; i++)
+                if (out[i] != (uint8_t)((readTotal + i) * 7))
+                    mismatches++;
+            readTotal += got;
+            if (got == 0)
+            {
+                if (finished && ring.fill() == 0)
+                    break;
+                std::this_thread::yield();
+            }
+        } });
+
+    uint8_t in[1000];
+    uint32_t written = 0;
+    while (written < STRESS_BYTES)
+    {
+        uint32_t len = (STRESS_BYTES - written < sizeof(in)) ? STRESS_BYTES - written : sizeof(in);
+        pattern(in, len, written);
+        uint32_t sent = 0;
+        while (sent < len)
+        {
+            uint32_t count = ring.write(in + sent, len - sent);
+            if (count == 0)
+                std::this_thread::yield();
+            sent += count;
+        }
+        written += len;
+    }
+    done.store(true, std::memory_order_release);
+    consumer.join();
+
+    TEST_ASSERT_EQUAL_UINT32(0, mismatches);
+    TEST_ASSERT_EQUAL_UINT32(STRESS_BYTES, readTotal);
+    TEST_ASSERT_EQUAL_UINT32(STRESS_BYTES, ring.stats().writtenBytes);
+    TEST_ASSERT_EQUAL_UINT32(STRESS_BYTES, ring.stats().readBytes);
+}
+#pragma endregion
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_begin_rejects_bad_storage);
+    RUN_TEST(test_read_waits_for_the_prefill_level);
+    RUN_TEST(test_running_dry_primes_again_and_counts_an_underrun);
+    RUN_TEST(test_data_survives_the_wraparound);
+    RUN_TEST(test_write_past_capacity_is_dropped_frame_aligned);
+    RUN_TEST(test_flush_drains_a_tail_shorter_than_the_prefill);
+    RUN_TEST(test_clear_drops_the_buffered_pcm);
+    RUN_TEST(test_spsc_stress_keeps_the_stream_intact);
+    return UNITY_END();
+}
@@ -0,0 +1,156 @@
+#include <unity.h>
+
+#include "playPosition.h"
+
+#pragma region Helpers
+#define MS 1000ULL // us per ms
+#pragma endregion
+
+#pragma region Tests
+void setUp() {}
+void tearDown() {}
+
+void test_position_advances_only_while_playing()
+{
+    playPosition clock;
+    clock.anchor(5000, 0);
+    TEST_ASSERT_EQUAL_UINT32(5000, clock.position(800 * MS));
+    clock.setPlaying(true, 1000 * MS);
+    TEST_ASSERT_EQUAL_UINT32(5000, clock.position(1000 * MS));
+    TEST_ASSERT_EQUAL_UINT32(5250, clock.position(1250 * MS));
+    clock.setPlaying(false, 1500 * MS);
+    TEST_ASSERT_EQUAL_UINT32(5500, clock.position(9000 * MS));
+    clock.setPlaying(true, 9000 * MS);
+    TEST_ASSERT_EQUAL_UINT32(5600, clock.position(9100 * MS));
+}
+
+void test_anchor_records_the_drift_while_playing()
+{
+    playPosition clock;
+    clock.setPlaying(true, 0);
+    clock.anchor(0, 0);
+    clock.anchor(1030, 1000 * MS);
+    TEST_ASSERT_EQUAL_INT32(30, clock.stats().lastCorrectionMs);
+    clock.anchor(2010, 2000 * MS);
+    TEST_ASSERT_EQUAL_INT32(-20, clock.stats().lastCorrectionMs);
+    TEST_ASSERT_EQUAL_UINT32(30, clock.stats().peakCorrectionMs);
+    TEST_ASSERT_EQUAL_UINT32(3, clock.stats().anchors);
+}
+
+void test_position_is_clamped_to_the_duration()
+{
+    playPosition clock;
+    clock.setTrack(3000, 0);
+    clock.setPlaying(true, 0);
+    TEST_ASSERT_EQUAL_UINT32(3000, clock.position(10000 * MS));
+    // Unknown duration : no clamp
+    clock.setDuration(0);
+    TEST_ASSERT_EQUAL_UINT32(10000, clock.position(10000 * MS));
+}
+
+void test_new_track_starts_from_zero()
+{
+    playPosition clock;
+    clock.setPlaying(true, 0);
+    clock.anchor(60000, 0);
+    clock.setTrack(200000, 5000 * MS);
+    TEST_ASSERT_EQUAL_UINT32(0, clock.position(5000 * MS));
+    TEST_ASSERT_EQUAL_UINT32(100, clock.position(5100 * MS));
+}
+
+void test_clock_going_back_keeps_the_anchor()
+{
+    playPosition clock;
+    clock.setPlaying(true, 0);
+    clock.anchor(4000, 2000 * MS);
+    TEST_ASSERT_EQUAL_UINT32(4000, clock.position(1000 * MS));
+}
+
+void test_nothing_is_sent_while_paused()
+{
+    playPosition clock;
+    TEST_ASSERT_EQUAL_UINT32(UINT32_MAX, clock.msUntilSend(5000 * MS, 1000));
+    clock.setPlaying(true, 5000 * MS);
+    TEST_ASSERT_EQUAL_UINT32(0, clock.msUntilSend(5000 * MS, 1000));
+}
+
+void test_sends_are_paced_by_the_interval()
+{
+    playPosition clock;
+    clock.setPlaying(true, 0);
+    clock.markSent(1000 * MS);
+    TEST_ASSERT_EQUAL_UINT32(1000, clock.msUntilSend(1000 * MS, 1000));
+    TEST_ASSERT_EQUAL_UINT32(1, clock.msUntilSend(1999 * MS + 500, 1000));
+    TEST_ASSERT_EQUAL_UINT32(0, clock.msUntilSend(2000 * MS, 1000));
+}
+
+void test_notification_counts_as_sent()
+{
+    playPosition clock;
+    clock.setPlaying(true, 0);
+    clock.markSent(0);
+    // The phone notifies every second : nothing is ever due from the interpolation
+    for (uint64_t t = 900; t < 10000; t += 1000)
+    {
+        clock.anchor((uint32_t)t, t * MS);
+        TEST_ASSERT_NOT_EQUAL(0, clock.msUntilSend((t + 999) * MS, 1000));
+    }
+    // The notifications stop : due one interval after the last one
+    TEST_ASSERT_EQUAL_UINT32(0, clock.msUntilSend(10900 * MS, 1000));
+}
+
+void test_notification_just_after_a_send_restarts_the_interval()
+{
+    playPosition clock;
+    clock.setPlaying(true, 0);
+    clock.markSent(1000 * MS);
+    // The phone notifies 10 ms after the interpolated position went out
+    clock.anchor(1010, 1010 * MS);
+    TEST_ASSERT_EQUAL_UINT32(250, clock.msUntilSend(1010 * MS, 250));
+    TEST_ASSERT_NOT_EQUAL(0, clock.msUntilSend(1259 * MS, 250));
+    TEST_ASSERT_EQUAL_UINT32(0, clock.msUntilSend(1260 * MS, 250));
+}
+
+void test_interval_under_the_notifications_bounds_the_staleness()
+{
+    playPosition clock;
+    clock.setPlaying(true, 0);
+    clock.markSent(0);
+    // Jittery 1 s notifications, the caller sends whenever due : never more than one interval without a send
+    uint64_t lastSentMs = 0;
+    uint64_t nextNotificationMs = 1030;
+    uint32_t notifications = 0;
+    for (uint64_t t = 1; t < 10000; t++)
+    {
+        if (t == nextNotificationMs)
+        {
+            clock.anchor((uint32_t)t, t * MS);
+            lastSentMs = t;
+            nextNotificationMs += (notifications++ % 2) ? 960 : 1050;
+        }
+        else if (clock.msUntilSend(t * MS, 250) == 0)
+        {
+            clock.markSent(t * MS);
+            TEST_ASSERT_EQUAL_UINT32(250, (uint32_t)(t - lastSentMs));
+            lastSentMs = t;
+        }
+        TEST_ASSERT_LESS_OR_EQUAL_UINT32(250, (uint32_t)(t - lastSentMs));
+    }
+}
+#pragma endregion
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_position_advances_only_while_playing);
+    RUN_TEST(test_anchor_records_the_drift_while_playing);
+    RUN_TEST(test_position_is_clamped_to_the_duration);
+    RUN_TEST(test_new_track_starts_from_zero);
+    RUN_TEST(test_clock_going_back_keeps_the_anchor);
+    RUN_TEST(test_nothing_is_sent_while_paused);
+    RUN_TEST(test_sends_are_paced_by_the_interval);
+    RUN_TEST(test_notification_counts_as_sent);
+    RUN_TEST(test_notification_just_after_a_send_restarts_the_interval);
+    RUN_TEST(test_interval_under_the_notifications_bounds_the_staleness);
+    return UNITY_END();
+}
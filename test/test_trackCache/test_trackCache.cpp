@@ -0,0 +1,157 @@
+#include <unity.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "trackCache.h"
+
+#pragma region Helpers
+/// @brief Track named after a number, on a shared album
+static trackRecord track(uint32_t n)
+{
+    trackRecord record;
+    snprintf(record.title, sizeof(record.title), "Title %lu", (unsigned long)n);
+    snprintf(record.artist, sizeof(record.artist), "Artist %lu", (unsigned long)n);
+    strcpy(record.album, "Album");
+    record.durationMs = 1000 * n;
+    return record;
+}
+
+/// @brief Title of the neighbour track, "" on a miss
+static const char *neighbourTitle(trackCache &cache, int8_t step)
+{
+    const trackRecord *record = cache.neighbour(step);
+    return (record == nullptr) ? "" : record->title;
+}
+#pragma endregion
+
+#pragma region Tests
+void setUp() {}
+void tearDown() {}
+
+void test_key_is_the_seeded_hash_of_the_three_strings()
+{
+    trackRecord record = track(1);
+    uint32_t expected = trackCoalescer::hash("Title 1", 8);
+    expected = trackCoalescer::hash("Artist 1", 9, expected);
+    expected = trackCoalescer::hash("Album", 6, expected);
+    TEST_ASSERT_EQUAL_HEX32(expected, trackCache::key(record));
+    // The duration is not part of the identity
+    record.durationMs = 1;
+    TEST_ASSERT_EQUAL_HEX32(expected, trackCache::key(record));
+}
+
+void test_key_tells_the_strings_apart()
+{
+    // Same bytes, split differently between the fields : the terminators keep the keys apart
+    trackRecord a, b;
+    strcpy(a.title, "AB");
+    strcpy(a.artist, "C");
+    strcpy(b.title, "A");
+    strcpy(b.artist, "BC");
+    TEST_ASSERT_NOT_EQUAL(trackCache::key(a), trackCache::key(b));
+}
+
+void test_previous_and_next_follow_the_history()
+{
+    trackCache cache;
+    TEST_ASSERT_EQUAL_STRING("", neighbourTitle(cache, -1));
+    for (uint32_t n = 1; n <= 3; n++)
+        cache.played(track(n));
+    TEST_ASSERT_EQUAL_STRING("Title 2", neighbourTitle(cache, -1));
+    TEST_ASSERT_EQUAL_STRING("", neighbourTitle(cache, 1));
+    // Going back moves the cursor, the next track is then known
+    cache.played(track(2));
+    TEST_ASSERT_EQUAL_STRING("Title 1", neighbourTitle(cache, -1));
+    TEST_ASSERT_EQUAL_STRING("Title 3", neighbourTitle(cache, 1));
+    cache.played(track(3));
+    TEST_ASSERT_EQUAL_STRING("Title 2", neighbourTitle(cache, -1));
+    TEST_ASSERT_EQUAL_UINT32(4, cache.stats().hits);
+    TEST_ASSERT_EQUAL_UINT32(2, cache.stats().misses);
+}
+
+void test_track_played_off_the_history_truncates_it()
+{
+    trackCache cache;
+    for (uint32_t n = 1; n <= 3; n++)
+        cache.played(track(n));
+    cache.played(track(2));
+    cache.played(track(9));
+    TEST_ASSERT_EQUAL_STRING("Title 2", neighbourTitle(cache, -1));
+    TEST_ASSERT_EQUAL_STRING("", neighbourTitle(cache, 1));
+}
+
+void test_same_track_again_does_not_move_the_cursor()
+{
+    trackCache cache;
+    cache.played(track(1));
+    cache.played(track(2));
+    trackRecord longer = track(2);
+    longer.durationMs = 99000;
+    cache.played(longer);
+    TEST_ASSERT_EQUAL_STRING("Title 1", neighbourTitle(cache, -1));
+    TEST_ASSERT_EQUAL_UINT32(0, cache.stats().repeats);
+    // Any other cached track played again is a repeat, going back included
+    cache.played(track(1));
+    TEST_ASSERT_EQUAL_UINT32(1, cache.stats().repeats);
+    cache.played(track(3));
+    cache.played(track(2));
+    TEST_ASSERT_EQUAL_UINT32(2, cache.stats().repeats);
+}
+
+void test_least_recently_used_track_is_evicted()
+{
+    trackCache cache;
+    for (uint32_t n = 1; n <= TRACK_CACHE_SIZE; n++)
+        cache.played(track(n));
+    TEST_ASSERT_EQUAL_UINT32(0, cache.stats().evictions);
+    cache.played(track(TRACK_CACHE_SIZE + 1));
+    TEST_ASSERT_EQUAL_UINT32(1, cache.stats().evictions);
+    // Track 1 is still in the history, but no longer cached
+    for (uint32_t n = TRACK_CACHE_SIZE + 1; n > 2; n--)
+        cache.played(track(n - 1));
+    TEST_ASSERT_EQUAL_STRING("", neighbourTitle(cache, -1));
+}
+
+void test_history_keeps_the_latest_tracks()
+{
+    trackCache cache;
+    for (uint32_t n = 1; n <= TRACK_CACHE_HISTORY + 2; n++)
+        cache.played(track(n % TRACK_CACHE_SIZE)); // Every key stays cached
+    // Walk back to the oldest track kept
+    uint32_t steps = 0;
+    const trackRecord *record;
+    while ((record = cache.neighbour(-1)) != nullptr)
+    {
+        trackRecord previous = *record;
+        cache.played(previous);
+        steps++;
+    }
+    TEST_ASSERT_EQUAL_UINT32(TRACK_CACHE_HISTORY - 1, steps);
+}
+
+void test_reset_history_keeps_the_cache()
+{
+    trackCache cache;
+    cache.played(track(1));
+    cache.played(track(2));
+    cache.resetHistory();
+    TEST_ASSERT_EQUAL_STRING("", neighbourTitle(cache, -1));
+    cache.played(track(1));
+    TEST_ASSERT_EQUAL_UINT32(1, cache.stats().repeats);
+    TEST_ASSERT_EQUAL_UINT32(0, cache.stats().evictions);
+}
+#pragma endregion
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_key_is_the_seeded_hash_of_the_three_strings);
+    RUN_TEST(test_key_tells_the_strings_apart);
+    RUN_TEST(test_previous_and_next_follow_the_history);
+    RUN_TEST(test_track_played_off_the_history_truncates_it);
+    RUN_TEST(test_same_track_again_does_not_move_the_cursor);
+    RUN_TEST(test_least_recently_used_track_is_evicted);
+    RUN_TEST(test_history_keeps_the_latest_tracks);
+    RUN_TEST(test_reset_history_keeps_the_cache);
+    return UNITY_END();
+}
@@ -0,0 +1,257 @@
+#include <unity.h>
+#include <string.h>
+
+#include "trackCoalescer.h"
+
+#pragma region Helpers
+#define ALL_FIELDS (TRACK_TITLE | TRACK_ARTIST | TRACK_ALBUM | TRACK_DURATION)
+
+/// @brief Adds a whole track, one attribute per ms, title first
+static uint32_t addTrack(trackCoalescer &coalescer, const char *title, const char *artist, const char *album,
+                         const char *durationMs, uint32_t nowMs)
+{
+    coalescer.add(TRACK_TITLE, title, nowMs++);
+    coalescer.add(TRACK_ARTIST, artist, nowMs++);
+    coalescer.add(TRACK_ALBUM, album, nowMs++);
+    coalescer.add(TRACK_DURATION, durationMs, nowMs);
+    return nowMs;
+}
+#pragma endregion
+
+#pragma region Tests
+void setUp() {}
+void tearDown() {}
+
+void test_burst_is_due_after_the_quiet_window()
+{
+    trackCoalescer coalescer;
+    TEST_ASSERT_FALSE(coalescer.pending());
+    TEST_ASSERT_EQUAL_UINT32(0, coalescer.msUntilDue(0));
+
+    uint32_t lastMs = addTrack(coalescer, "Title", "Artist", "Album", "180000", 1000);
+    TEST_ASSERT_TRUE(coalescer.pending());
+    TEST_ASSERT_EQUAL_UINT32(TRACK_COALESCE_QUIET_MS, coalescer.msUntilDue(lastMs));
+    TEST_ASSERT_EQUAL_UINT32(1, coalescer.msUntilDue(lastMs + TRACK_COALESCE_QUIET_MS - 1));
+    TEST_ASSERT_EQUAL_UINT32(0, coalescer.msUntilDue(lastMs + TRACK_COALESCE_QUIET_MS));
+}
+
+void test_each_attribute_restarts_the_quiet_window()
+{
+    trackCoalescer coalescer;
+    coalescer.add(TRACK_TITLE, "Title", 1000);
+    coalescer.add(TRACK_ARTIST, "Artist", 1000 + TRACK_COALESCE_QUIET_MS - 1);
+    TEST_ASSERT_EQUAL_UINT32(TRACK_COALESCE_QUIET_MS - 1, coalescer.msUntilDue(1000 + TRACK_COALESCE_QUIET_MS));
+}
+
+void test_trickling_burst_is_due_after_the_max_window()
+{
+    trackCoalescer coalescer;
+    uint32_t nowMs = 1000;
+    uint32_t stepMs = TRACK_COALESCE_QUIET_MS - 1;
+    coalescer.add(TRACK_TITLE, "Title", nowMs);
+    while (nowMs + stepMs < 1000 + TRACK_COALESCE_MAX_MS)
+    {
+        nowMs += stepMs;
+        TEST_ASSERT_NOT_EQUAL(0, coalescer.msUntilDue(nowMs));
+        coalescer.add(TRACK_ARTIST, "Artist", nowMs);
+    }
+    // The quiet window would wait longer, the max window caps it
+    TEST_ASSERT_EQUAL_UINT32(1000 + TRACK_COALESCE_MAX_MS - nowMs, coalescer.msUntilDue(nowMs));
+    TEST_ASSERT_EQUAL_UINT32(0, coalescer.msUntilDue(1000 + TRACK_COALESCE_MAX_MS));
+}
+
+void test_first_commit_reports_every_field()
+{
+    trackCoalescer coalescer;
+    addTrack(coalescer, "Title", "Artist", "Album", "180000", 0);
+    TEST_ASSERT_EQUAL_UINT8(ALL_FIELDS, coalescer.commit());
+    TEST_ASSERT_FALSE(coalescer.pending());
+    TEST_ASSERT_EQUAL_STRING("Title", coalescer.record().title);
+    TEST_ASSERT_EQUAL_UINT32(180000, coalescer.record().durationMs);
+}
+
+void test_identical_burst_is_a_duplicate()
+{
+    trackCoalescer coalescer;
+    addTrack(coalescer, "Title", "Artist", "Album", "180000", 0);
+    coalescer.commit();
+    addTrack(coalescer, "Title", "Artist", "Album", "180000", 500);
+    TEST_ASSERT_EQUAL_UINT8(0, coalescer.commit());
+    TEST_ASSERT_EQUAL_UINT32(1, coalescer.stats().duplicateBursts);
+    TEST_ASSERT_EQUAL_UINT32(4, coalescer.stats().skippedFields);
+}
+
+void test_only_the_changed_fields_are_committed()
+{
+    trackCoalescer coalescer;
+    addTrack(coalescer, "Title", "Artist", "Album", "180000", 0);
+    coalescer.commit();
+    addTrack(coalescer, "Next title", "Artist", "Album", "200000", 500);
+    TEST_ASSERT_EQUAL_UINT8(TRACK_TITLE | TRACK_DURATION, coalescer.commit());
+    TEST_ASSERT_EQUAL_STRING("Next title", coalescer.record().title);
+}
+
+void test_title_arriving_last_in_the_window_joins_the_burst()
+{
+    trackCoalescer coalescer;
+    coalescer.add(TRACK_ARTIST, "Artist", 0);
+    coalescer.add(TRACK_ALBUM, "Album", 5);
+    coalescer.add(TRACK_DURATION, "180000", 10);
+    coalescer.add(TRACK_TITLE, "Title", 10 + TRACK_COALESCE_QUIET_MS - 1);
+    TEST_ASSERT_NOT_EQUAL(0, coalescer.msUntilDue(10 + TRACK_COALESCE_QUIET_MS));
+    TEST_ASSERT_EQUAL_UINT8(ALL_FIELDS, coalescer.commit());
+}
+
+void test_title_arriving_after_the_window_is_a_burst_of_its_own()
+{
+    trackCoalescer coalescer;
+    addTrack(coalescer, "Title", "Artist", "Album", "180000", 0);
+    coalescer.commit();
+    coalescer.add(TRACK_ARTIST, "Other artist", 1000);
+    coalescer.add(TRACK_ALBUM, "Other album", 1001);
+    TEST_ASSERT_EQUAL_UINT32(0, coalescer.msUntilDue(1001 + TRACK_COALESCE_QUIET_MS));
+    TEST_ASSERT_EQUAL_UINT8(TRACK_ARTIST | TRACK_ALBUM, coalescer.commit());
+    coalescer.add(TRACK_TITLE, "Other title", 1001 + TRACK_COALESCE_QUIET_MS + 5);
+    TEST_ASSERT_EQUAL_UINT8(TRACK_TITLE, coalescer.commit());
+    TEST_ASSERT_EQUAL_UINT32(3, coalescer.stats().commits);
+}
+
+void test_later_value_of_a_field_replaces_the_earlier_one()
+{
+    trackCoalescer coalescer;
+    coalescer.add(TRACK_TITLE, "A much longer placeholder", 0);
+    coalescer.add(TRACK_TITLE, "Short", 1);
+    TEST_ASSERT_EQUAL_UINT8(TRACK_TITLE, coalescer.commit());
+    TEST_ASSERT_EQUAL_STRING("Short", coalescer.record().title);
+    TEST_ASSERT_EQUAL_UINT32(2, coalescer.stats().attributes);
+}
+
+void test_reset_forgets_the_committed_track()
+{
+    trackCoalescer coalescer;
+    addTrack(coalescer, "Title", "Artist", "Album", "180000", 0);
+    coalescer.commit();
+    coalescer.reset();
+    addTrack(coalescer, "Title", "Artist", "Album", "180000", 500);
+    TEST_ASSERT_EQUAL_UINT8(ALL_FIELDS, coalescer.commit());
+}
+
+void test_hash_matches_the_fnv1a_vectors()
+{
+    TEST_ASSERT_EQUAL_HEX32(0x811c9dc5, trackCoalescer::hash("", 0));
+    TEST_ASSERT_EQUAL_HEX32(0xe40c292c, trackCoalescer::hash("a", 1));
+    TEST_ASSERT_EQUAL_HEX32(0xbf9cf968, trackCoalescer::hash("foobar", 6));
+}
+
+void test_seeded_hash_chains_buffers_as_one()
+{
+    uint32_t chained = trackCoalescer::hash("foo", 3);
+    chained = trackCoalescer::hash("bar", 3, chained);
+    TEST_ASSERT_EQUAL_HEX32(trackCoalescer::hash("foobar", 6), chained);
+    TEST_ASSERT_NOT_EQUAL(trackCoalescer::hash("bar", 3), trackCoalescer::hash("bar", 3, 12345));
+}
+
+void test_expected_track_waits_for_the_phone_title()
+{
+    trackCoalescer coalescer;
+    addTrack(coalescer, "Title", "Artist", "Album", "180000", 0);
+    coalescer.commit();
+    trackRecord next;
+    strcpy(next.title, "Next title");
+    strcpy(next.artist, "Next artist");
+    strcpy(next.album, "Album");
+    next.durationMs = 200000;
+    coalescer.expect(next);
+    TEST_ASSERT_FALSE(coalescer.pending());
+    TEST_ASSERT_EQUAL_STRING("Title", coalescer.record().title);
+
+    // The title confirms it : the whole track is due at once
+    coalescer.add(TRACK_TITLE, "Next title", 1000);
+    TEST_ASSERT_EQUAL_UINT32(0, coalescer.msUntilDue(1000));
+    TEST_ASSERT_EQUAL_UINT8(TRACK_TITLE | TRACK_ARTIST | TRACK_DURATION, coalescer.commit());
+    TEST_ASSERT_EQUAL_STRING("Next artist", coalescer.record().artist);
+    TEST_ASSERT_EQUAL_UINT32(200000, coalescer.record().durationMs);
+    // The rest of the phone's burst changes nothing
+    coalescer.add(TRACK_ARTIST, "Next artist", 1001);
+    coalescer.add(TRACK_ALBUM, "Album", 1002);
+    coalescer.add(TRACK_DURATION, "200000", 1003);
+    TEST_ASSERT_EQUAL_UINT8(0, coalescer.commit());
+    TEST_ASSERT_EQUAL_UINT32(1, coalescer.stats().confirmed);
+}
+
+void test_other_title_drops_the_expected_track()
+{
+    trackCoalescer coalescer;
+    addTrack(coalescer, "Title", "Artist", "Album", "180000", 0);
+    coalescer.commit();
+    trackRecord next;
+    strcpy(next.title, "Next title");
+    strcpy(next.artist, "Next artist");
+    coalescer.expect(next);
+
+    uint32_t lastMs = addTrack(coalescer, "Shuffled title", "Other artist", "Album", "150000", 1000);
+    TEST_ASSERT_NOT_EQUAL(0, coalescer.msUntilDue(lastMs));
+    TEST_ASSERT_EQUAL_UINT8(TRACK_TITLE | TRACK_ARTIST | TRACK_DURATION, coalescer.commit());
+    TEST_ASSERT_EQUAL_STRING("Other artist", coalescer.record().artist);
+    TEST_ASSERT_EQUAL_UINT32(1, coalescer.stats().unconfirmed);
+    // Expected only until the next title
+    coalescer.add(TRACK_TITLE, "Next title", 2000);
+    TEST_ASSERT_NOT_EQUAL(0, coalescer.msUntilDue(2000));
+}
+
+void test_track_settles_once_the_bursts_stop()
+{
+    trackCoalescer coalescer;
+    TEST_ASSERT_EQUAL_UINT32(UINT32_MAX, coalescer.msUntilSettled(0));
+    coalescer.add(TRACK_ARTIST, "Artist", 0);
+    coalescer.add(TRACK_ALBUM, "Album", 1);
+    TEST_ASSERT_EQUAL_UINT32(UINT32_MAX, coalescer.msUntilSettled(500));
+    coalescer.commit();
+    TEST_ASSERT_EQUAL_UINT32(TRACK_SETTLE_MS - 499, coalescer.msUntilSettled(500));
+    // The title comes in a burst of its own : nothing is reported in between
+    coalescer.add(TRACK_TITLE, "Title", 600);
+    TEST_ASSERT_FALSE(coalescer.settle(600 + TRACK_SETTLE_MS));
+    coalescer.commit();
+    TEST_ASSERT_FALSE(coalescer.settle(600 + TRACK_SETTLE_MS - 1));
+    TEST_ASSERT_TRUE(coalescer.settle(600 + TRACK_SETTLE_MS));
+    TEST_ASSERT_EQUAL_STRING("Title", coalescer.record().title);
+    TEST_ASSERT_EQUAL_STRING("Album", coalescer.record().album);
+    // Once only, and a duplicate burst does not unsettle it
+    TEST_ASSERT_FALSE(coalescer.settle(5000));
+    coalescer.add(TRACK_TITLE, "Title", 6000);
+    coalescer.add(TRACK_ALBUM, "Album", 6001);
+    TEST_ASSERT_EQUAL_UINT8(0, coalescer.commit());
+    TEST_ASSERT_EQUAL_UINT32(UINT32_MAX, coalescer.msUntilSettled(9000));
+}
+
+void test_track_without_a_title_never_settles()
+{
+    trackCoalescer coalescer;
+    coalescer.add(TRACK_ARTIST, "Artist", 0);
+    coalescer.commit();
+    TEST_ASSERT_FALSE(coalescer.settle(TRACK_SETTLE_MS));
+    TEST_ASSERT_EQUAL_UINT32(UINT32_MAX, coalescer.msUntilSettled(TRACK_SETTLE_MS));
+}
+#pragma endregion
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_burst_is_due_after_the_quiet_window);
+    RUN_TEST(test_each_attribute_restarts_the_quiet_window);
+    RUN_TEST(test_trickling_burst_is_due_after_the_max_window);
+    RUN_TEST(test_first_commit_reports_every_field);
+    RUN_TEST(test_identical_burst_is_a_duplicate);
+    RUN_TEST(test_only_the_changed_fields_are_committed);
+    RUN_TEST(test_title_arriving_last_in_the_window_joins_the_burst);
+    RUN_TEST(test_title_arriving_after_the_window_is_a_burst_of_its_own);
+    RUN_TEST(test_later_value_of_a_field_replaces_the_earlier_one);
+    RUN_TEST(test_reset_forgets_the_committed_track);
+    RUN_TEST(test_hash_matches_the_fnv1a_vectors);
+    RUN_TEST(test_seeded_hash_chains_buffers_as_one);
+    RUN_TEST(test_expected_track_waits_for_the_phone_title);
+    RUN_TEST(test_other_title_drops_the_expected_track);
+    RUN_TEST(test_track_settles_once_the_bursts_stop);
+    RUN_TEST(test_track_without_a_title_never_settles);
+    return UNITY_END();
+}
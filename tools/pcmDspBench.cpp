@@ -0,0 +1,253 @@
+// Host-side check and benchmark of the pcmDsp kernels : every production kernel must match its reference bit for bit,
+// and the equalizer bands must realize their design gain at DC, at their frequency and at Nyquist.
+//
+// Build and run from the repository root :
+//   g++ -std=c++17 -O2 -Ilib/pcmDsp -o pcmDspBench tools/pcmDspBench.cpp lib/pcmDsp/pcmDsp.cpp
+//   ./pcmDspBench [seconds]
+//
+// Exits with 1 if a production kernel differs from its reference, or if a band misses its gain by more than
+// GAIN_TOLERANCE_DB.
+
+#include <chrono>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include "pcmDsp.h"
+
+static const uint32_t sampleRate = 44100;
+static const uint32_t chunkFrames = 256; // What the I2S writer task hands over at once
+
+#define GAIN_TOLERANCE_DB 0.05
+
+/// @brief Nanoseconds since the first call, stands in for the CPU cycle counter
+static uint32_t nanoCounter()
+{
+    static const auto origin = std::chrono::steady_clock::now();
+    return (uint32_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - origin).count();
+}
+
+/// @brief Loud test program : two tones, a sweep and noise, with bursts close to full scale to drive the limiter
+static void synthesize(std::vector<int16_t> &pcm, uint32_t frames)
+{
+    pcm.resize(2 * frames);
+    uint32_t noise = 12345;
+    for (uint32_t i = 0; i < frames; i++)
+    {
+        double t = (double)i / sampleRate;
+        double envelope = ((i / (sampleRate / 4)) % 2) ? 1.0 : 0.3;
+        double sweep = sin(2 * M_PI * (50.0 + 4000.0 * t / 10.0) * t);
+        for (uint32_t channel = 0; channel < 2; channel++)
+        {
+            noise = noise * 1664525u + 1013904223u;
+            double value = 0.45 * sin(2 * M_PI * (channel ? 97.0 : 61.0) * t) + 0.3 * sin(2 * M_PI * 1000.0 * t) +
+                           0.2 * sweep + 0.05 * ((int32_t)(noise >> 16) - 32768) / 32768.0;
+            pcm[2 * i + channel] = (int16_t)lround(value * envelope * 32767.0 * 0.95);
+        }
+    }
+}
+
+struct kernelResult
+{
+    const char *name;
+    double referenceNs;
+    double productionNs;
+    bool exact;
+};
+
+/// @brief Runs a reference and a production kernel over the same input, chunk by chunk, and compares the outputs
+template <typename Reference, typename Production>
+static kernelResult compare(const char *name, const std::vector<int16_t> &input, Reference reference, Production production)
+{
+    std::vector<int16_t> expected = input;
+    std::vector<int16_t> actual = input;
+    uint32_t frames = input.size() / 2;
+
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t offset = 0; offset < frames; offset += chunkFrames)
+        reference(&expected[2 * offset], (frames - offset < chunkFrames) ? frames - offset : chunkFrames);
+    auto middle = std::chrono::steady_clock::now();
+    for (uint32_t offset = 0; offset < frames; offset += chunkFrames)
+        production(&actual[2 * offset], (frames - offset < chunkFrames) ? frames - offset : chunkFrames);
+    auto end = std::chrono::steady_clock::now();
+
+    kernelResult result;
+    result.name = name;
+    result.referenceNs = std::chrono::duration<double, std::nano>(middle - start).count() / frames;
+    result.productionNs = std::chrono::duration<double, std::nano>(end - middle).count() / frames;
+    result.exact = memcmp(expected.data(), actual.data(), expected.size() * sizeof(int16_t)) == 0;
+    return result;
+}
+
+/// @brief Gain the production biquad realizes on a steady tone, once the filter has settled
+/// @param frequency Tone frequency, 0 for DC, sampleRate / 2 for Nyquist
+/// @return Gain in dB, measured by correlating the output with the tone
+static double realizedGainDb(const dspBiquadCoeffs &coeffs, uint32_t rate, double frequency)
+{
+    const double amplitude = 4096.0; // -18 dBFS, room for +18 dB without saturating
+    const uint32_t settleFrames = 2 * rate, measureFrames = 2 * rate;
+    std::vector<int16_t> pcm(2 * chunkFrames);
+    dspBiquadState state[2];
+    double sumCos = 0.0, sumSin = 0.0;
+    uint32_t measured = 0;
+    for (uint32_t offset = 0; offset < settleFrames + measureFrames; offset += chunkFrames)
+    {
+        for (uint32_t i = 0; i < chunkFrames; i++)
+        {
+            double phase = 2 * M_PI * frequency * (offset + i) / rate;
+            pcm[2 * i] = pcm[2 * i + 1] = (int16_t)lround(amplitude * cos(phase));
+        }
+        dspBiquad(pcm.data(), chunkFrames, coeffs, state);
+        if (offset < settleFrames)
+            continue;
+        for (uint32_t i = 0; i < chunkFrames; i++)
+        {
+            double phase = 2 * M_PI * frequency * (offset + i) / rate;
+            sumCos += pcm[2 * i] * cos(phase);
+            sumSin += pcm[2 * i] * sin(phase);
+        }
+        measured += chunkFrames;
+    }
+    // DC and Nyquist have no quadrature component, and cos^2 averages 1 instead of 1/2
+    double scale = (frequency == 0.0 || 2 * frequency == rate) ? 1.0 : 2.0;
+    return 20.0 * log10(scale * sqrt(sumCos * sumCos + sumSin * sumSin) / measured / amplitude);
+}
+
+struct bandCheck
+{
+    dspBandType type;
+    float frequency;
+    float q;
+    float gainDb;
+};
+
+/// @brief Checks the bands a car setup would use, low shelves down to 50 Hz included, against the gains they are
+/// designed for : the shelf gain on its side, half of it at the corner, and none on the other side. A peak has its gain
+/// at the center and none at DC or Nyquist.
+/// @return false if a band misses a target by more than GAIN_TOLERANCE_DB
+static bool checkRealizedGains()
+{
+    static const bandCheck bands[] = {
+        {DSP_BAND_LOW_SHELF, 50.0f, 0.707f, 6.0f},   {DSP_BAND_LOW_SHELF, 50.0f, 0.707f, -6.0f},
+        {DSP_BAND_LOW_SHELF, 100.0f, 0.707f, 6.0f},  {DSP_BAND_LOW_SHELF, 100.0f, 0.707f, 12.0f},
+        {DSP_BAND_LOW_SHELF, 100.0f, 0.707f, -12.0f}, {DSP_BAND_HIGH_SHELF, 8000.0f, 0.707f, 4.0f},
+        {DSP_BAND_HIGH_SHELF, 8000.0f, 0.707f, -6.0f}, {DSP_BAND_PEAKING, 1000.0f, 1.0f, -3.0f},
+        {DSP_BAND_PEAKING, 60.0f, 1.4f, 6.0f},
+    };
+    static const uint32_t rates[] = {44100, 48000};
+    static const char *typeNames[] = {"off", "peaking", "low shelf", "high shelf"};
+
+    bool allWithin = true;
+    printf("%-28s %6s %20s %20s %20s\n", "band", "rate", "DC dB (target)", "f0 dB (target)", "Nyquist dB (target)");
+    for (uint32_t rate : rates)
+    {
+        for (const bandCheck &band : bands)
+        {
+            dspBiquadCoeffs coeffs = pcmDsp::designBiquad(band.type, rate, band.frequency, band.q, band.gainDb);
+            double targets[3];
+            switch (band.type)
+            {
+            case DSP_BAND_LOW_SHELF:
+                targets[0] = band.gainDb, targets[1] = band.gainDb / 2, targets[2] = 0.0;
+                break;
+            case DSP_BAND_HIGH_SHELF:
+                targets[0] = 0.0, targets[1] = band.gainDb / 2, targets[2] = band.gainDb;
+                break;
+            default:
+                targets[0] = 0.0, targets[1] = band.gainDb, targets[2] = 0.0;
+                break;
+            }
+            const double frequencies[3] = {0.0, band.frequency, rate / 2.0};
+            char name[48];
+            snprintf(name, sizeof(name), "%s %g Hz %+g dB", typeNames[band.type], band.frequency, band.gainDb);
+            printf("%-28s %6u", name, rate);
+            for (uint32_t i = 0; i < 3; i++)
+            {
+                double realized = realizedGainDb(coeffs, rate, frequencies[i]);
+                bool within = fabs(realized - targets[i]) <= GAIN_TOLERANCE_DB;
+                printf(" %9.3f (%+6.2f)%s", realized, targets[i], within ? "  " : " !");
+                allWithin &= within;
+            }
+            printf("\n");
+        }
+    }
+    printf("\n");
+    return allWithin;
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t seconds = (argc > 1) ? (uint32_t)atoi(argv[1]) : 10;
+    if (seconds == 0)
+        seconds = 10;
+    bool gainsWithin = checkRealizedGains();
+    std::vector<int16_t> input;
+    synthesize(input, seconds * sampleRate);
+
+    const int32_t gainQ12 = (int32_t)lround(pow(10.0, 6.0 / 20.0) * DSP_UNITY_GAIN);
+    const dspBiquadCoeffs bass = pcmDsp::designBiquad(DSP_BAND_LOW_SHELF, sampleRate, 100.0f, 0.707f, 6.0f);
+    const dspBiquadCoeffs mid = pcmDsp::designBiquad(DSP_BAND_PEAKING, sampleRate, 1000.0f, 1.0f, -3.0f);
+    dspLimiterState limiterSettings;
+    limiterSettings.thresholdQ15 = (int32_t)lround(pow(10.0, -1.0 / 20.0) * 32767.0);
+    limiterSettings.releaseQ15 = (int32_t)lround((1.0 - exp(-(1000.0 * PCM_DSP_BLOCK_FRAMES / sampleRate) / 50.0)) * DSP_LIMITER_UNITY);
+
+    std::vector<kernelResult> results;
+    results.push_back(compare("gain +6 dB", input,
+                              [&](int16_t *pcm, uint32_t frames) { dspGainRef(pcm, 2 * frames, gainQ12); },
+                              [&](int16_t *pcm, uint32_t frames) { dspGain(pcm, 2 * frames, gainQ12); }));
+
+    dspBiquadState referenceState[2], productionState[2];
+    results.push_back(compare("low shelf 100 Hz +6 dB", input,
+                              [&](int16_t *pcm, uint32_t frames) { dspBiquadRef(pcm, frames, bass, referenceState); },
+                              [&](int16_t *pcm, uint32_t frames) { dspBiquad(pcm, frames, bass, productionState); }));
+    dspBiquadState referenceMid[2], productionMid[2];
+    results.push_back(compare("peaking 1 kHz -3 dB", input,
+                              [&](int16_t *pcm, uint32_t frames) { dspBiquadRef(pcm, frames, mid, referenceMid); },
+                              [&](int16_t *pcm, uint32_t frames) { dspBiquad(pcm, frames, mid, productionMid); }));
+
+    // The limiter is fed a boosted signal so that it has to act
+    std::vector<int16_t> boosted = input;
+    dspGainRef(boosted.data(), boosted.size(), gainQ12);
+    dspLimiterState referenceLimiter = limiterSettings, productionLimiter = limiterSettings;
+    results.push_back(compare("limiter -1 dBFS", boosted,
+                              [&](int16_t *pcm, uint32_t frames) {
+                                  for (uint32_t offset = 0; offset < frames; offset += PCM_DSP_BLOCK_FRAMES)
+                                      dspLimiterRef(pcm + 2 * offset, (frames - offset < PCM_DSP_BLOCK_FRAMES) ? frames - offset : PCM_DSP_BLOCK_FRAMES, referenceLimiter);
+                              },
+                              [&](int16_t *pcm, uint32_t frames) {
+                                  for (uint32_t offset = 0; offset < frames; offset += PCM_DSP_BLOCK_FRAMES)
+                                      dspLimiter(pcm + 2 * offset, (frames - offset < PCM_DSP_BLOCK_FRAMES) ? frames - offset : PCM_DSP_BLOCK_FRAMES, productionLimiter);
+                              }));
+
+    bool allExact = true;
+    printf("%-24s %12s %12s %8s  %s\n", "kernel", "ref ns/fr", "prod ns/fr", "speedup", "bit-exact");
+    for (const kernelResult &result : results)
+    {
+        printf("%-24s %12.2f %12.2f %7.1fx  %s\n", result.name, result.referenceNs, result.productionNs,
+               result.referenceNs / result.productionNs, result.exact ? "yes" : "NO");
+        allExact &= result.exact;
+    }
+
+    // Whole stage, as configured on a car : a little headroom, bass and treble, limiter
+    pcmDsp stage(nanoCounter);
+    stage.setSampleRate(sampleRate);
+    stage.setGainDb(-3.0f);
+    stage.setBand(0, DSP_BAND_LOW_SHELF, 100.0f, 0.707f, 6.0f);
+    stage.setBand(1, DSP_BAND_PEAKING, 1000.0f, 1.0f, -3.0f);
+    stage.setBand(2, DSP_BAND_HIGH_SHELF, 8000.0f, 0.707f, 4.0f);
+    stage.setLimiter(-1.0f, 50.0f);
+    std::vector<int16_t> pcm = input;
+    uint32_t frames = pcm.size() / 2;
+    for (uint32_t offset = 0; offset < frames; offset += chunkFrames)
+        stage.process(&pcm[2 * offset], (frames - offset < chunkFrames) ? frames - offset : chunkFrames);
+    const pcmDspCost &cost = stage.cost();
+    double nsPerFrame = (double)cost.cycles / cost.frames;
+    printf("\nstage (gain, 3 bands, limiter) : %.2f ns/frame, peak %u ns/frame, %.0fx real time, %.2f%% of one core\n",
+           nsPerFrame, cost.peakCyclesPerFrame, 1e9 / sampleRate / nsPerFrame, 100.0 * nsPerFrame * sampleRate / 1e9);
+
+    if (!gainsWithin)
+        printf("A band misses its design gain by more than %.2f dB\n", GAIN_TOLERANCE_DB);
+    return (allExact && gainsWithin) ? 0 : 1;
+}
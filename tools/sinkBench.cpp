@@ -0,0 +1,448 @@
+// Host-side benchmark of the audio sink path : a producer thread replays A2DP-like delivery patterns into a pcmRing
+// through a read_data_stream() stand-in, and a writer thread drains it like pcmWriterTask into a mock I2S output that
+// plays at the real-time clock. Reports the buffered audio over time, underruns and the cost of each stream callback.
+//
+// Build and run from the repository root :
+//   g++ -std=c++17 -O2 -pthread -Ilib/pcmRing -Ilib/bufferProfile -o sinkBench tools/sinkBench.cpp
+//       lib/pcmRing/pcmRing.cpp lib/bufferProfile/bufferProfile.cpp
+//   ./sinkBench [options]
+//
+// Options, sizes in bytes like the PCM_* and I2S settings of src/main.cpp :
+//   --pattern=steady|jitter|gaps|catchup|all|<file>  Delivery pattern, default all. A file holds one callback per
+//                                                    line, "<offset_us> <bytes>", offsets from the start of the run.
+//   --seconds=N        Length of each run, default 5
+//   --packet=N         Bytes per callback, default 4096 (1024 frames, about 23 ms at 44.1 kHz)
+//   --jitter=MS        Largest extra delay of a callback in the jitter pattern, default 30
+//   --gap=MS           Length of the stalls in the gaps and catchup patterns, default 150, one every 2 s
+//   --profile=NAME     Buffering profile of src/main.cpp the sizes start from, default balanced
+//   --ring=N --prefill=N --chunk=N                   PCM ring, default from the profile, chunk 1024
+//   --storage=N        Ring storage, default 65536 with PSRAM. The ring and the prefill are clamped like the firmware.
+//   --dma-count=N --dma-frames=N                     I2S DMA buffers, default from the profile
+//   --trace=MS         Prints the buffered audio every MS, 0 to disable. Default 250 for a single pattern.
+//
+// Exits with 1 if any run had an audible dropout, i.e. the mock I2S output ran out of data once playing.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <math.h>
+#include <mutex>
+#include <random>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "bufferProfile.h"
+#include "pcmRing.h"
+
+typedef std::chrono::steady_clock benchClock;
+
+static const uint32_t sampleRate = 44100;
+static const double bytesPerUs = sampleRate * PCM_FRAME_BYTES / 1e6;
+
+struct benchSettings
+{
+    std::string pattern = "all";
+    uint32_t seconds = 5;
+    uint32_t packet = 4096;
+    uint32_t jitterMs = 30;
+    uint32_t gapMs = 150;
+    uint32_t ring = 0;    // 0 for the profile ones
+    uint32_t prefill = 0;
+    uint32_t storage = 65536; // PCM_RING_SIZE of src/main.cpp
+    uint32_t chunk = 1024;
+    uint32_t dmaCount = 0;
+    uint32_t dmaFrames = 0;
+    int32_t traceMs = -1; // -1 for the default
+};
+
+/// @brief Converts bytes of PCM to milliseconds of audio
+static double bytesToMs(double bytes) { return bytes / bytesPerUs / 1000.0; }
+
+/// @brief Time since the start of the run, in microseconds
+static double usSince(benchClock::time_point origin)
+{
+    return std::chrono::duration<double, std::micro>(benchClock::now() - origin).count();
+}
+
+/// @brief One callback of the A2DP stack : when it comes, relative to the start of the run, and how much it carries
+struct delivery
+{
+    double offsetUs;
+    uint32_t bytes;
+};
+
+/// @brief Builds the callbacks of a run. Packets are due every packet period, and the pattern decides when they
+/// actually arrive :
+/// - steady : on time
+/// - jitter : late by a random amount, never reordered
+/// - gaps : every 2 s, a stall holds the packets back and they all arrive at once when it ends
+/// - catchup : same stall, then the source sends at twice the rate until it is back on schedule
+static std::vector<delivery> buildPattern(const std::string &pattern, const benchSettings &settings)
+{
+    std::vector<delivery> deliveries;
+    double periodUs = settings.packet / bytesPerUs;
+    double lengthUs = settings.seconds * 1e6;
+    double gapUs = settings.gapMs * 1000.0;
+    const double stallEveryUs = 2e6;
+    std::mt19937 random(42);
+    std::uniform_real_distribution<double> jitter(0.0, settings.jitterMs * 1000.0);
+
+    double previous = 0;
+    for (uint32_t n = 0; n * periodUs < lengthUs; n++)
+    {
+        double due = n * periodUs;
+        double arrival = due;
+        double stallStart = floor(due / stallEveryUs) * stallEveryUs + stallEveryUs / 2;
+        if (due < stallStart)
+            stallStart -= stallEveryUs;
+        double stallEnd = stallStart + gapUs;
+
+        if (pattern == "jitter")
+            arrival = due + jitter(random);
+        else if (pattern == "gaps" && stallStart >= 0 && due < stallEnd)
+            arrival = stallEnd;
+        else if (pattern == "catchup" && stallStart >= 0)
+            arrival = std::max(due, stallEnd + (due - stallStart) / 2);
+
+        arrival = std::max(arrival, previous);
+        previous = arrival;
+        deliveries.push_back({arrival, settings.packet});
+    }
+    return deliveries;
+}
+
+/// @brief Reads a recorded pattern, one "<offset_us> <bytes>" callback per line
+static bool loadPattern(const std::string &path, std::vector<delivery> &deliveries)
+{
+    FILE *file = fopen(path.c_str(), "r");
+    if (file == nullptr)
+        return false;
+    double offsetUs;
+    uint32_t bytes;
+    while (fscanf(file, "%lf %u", &offsetUs, &bytes) == 2)
+        deliveries.push_back({offsetUs, bytes});
+    fclose(file);
+    return !deliveries.empty();
+}
+
+/// @brief I2S output playing at the real-time clock. write() blocks until the DMA buffers have room, like the ESP32
+/// driver. Once started, running out of data is an audible dropout : the output plays silence until the next write.
+class mockI2S
+{
+private:
+    benchClock::time_point _origin;
+    double _capacityUs;
+    double _drainedAtUs = -1; // When the queued data runs out, -1 before the first write
+    std::mutex _lock;
+
+public:
+    uint32_t dropouts = 0;
+    double silentUs = 0;
+
+    mockI2S(benchClock::time_point origin, uint32_t capacityBytes) : _origin(origin), _capacityUs(capacityBytes / bytesPerUs) {}
+
+    void write(uint32_t len)
+    {
+        double lenUs = len / bytesPerUs;
+        std::unique_lock<std::mutex> guard(_lock);
+        double now = usSince(_origin);
+        if (_drainedAtUs < 0)
+            _drainedAtUs = now;
+        else if (now > _drainedAtUs)
+        {
+            dropouts++;
+            silentUs += now - _drainedAtUs;
+            _drainedAtUs = now;
+        }
+        // Wait for the DMA to make room for the whole write
+        double readyAtUs = _drainedAtUs + lenUs - _capacityUs;
+        if (readyAtUs > now)
+        {
+            guard.unlock();
+            std::this_thread::sleep_for(std::chrono::duration<double, std::micro>(readyAtUs - now));
+            guard.lock();
+        }
+        _drainedAtUs += lenUs;
+    }
+
+    /// @brief Queued bytes at that instant
+    double fill()
+    {
+        std::lock_guard<std::mutex> guard(_lock);
+        double queuedUs = _drainedAtUs - usSince(_origin);
+        return queuedUs > 0 ? queuedUs * bytesPerUs : 0;
+    }
+
+    void stop()
+    {
+        std::lock_guard<std::mutex> guard(_lock);
+        _drainedAtUs = -1;
+    }
+};
+
+struct runResult
+{
+    std::string pattern;
+    uint32_t callbacks = 0;
+    double callbackMeanNs = 0;
+    double callbackP99Ns = 0;
+    double callbackMaxNs = 0;
+    double bufferedMinMs = 0;
+    double bufferedMeanMs = 0;
+    double bufferedMaxMs = 0;
+    pcmRingStats ring;
+    uint32_t dropouts = 0;
+    double silentMs = 0;
+};
+
+/// @brief Stands in for the writer task notification
+struct notifier
+{
+    std::mutex lock;
+    std::condition_variable signal;
+    bool pending = false;
+
+    void give()
+    {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            pending = true;
+        }
+        signal.notify_one();
+    }
+
+    void take(uint32_t timeoutMs)
+    {
+        std::unique_lock<std::mutex> guard(lock);
+        signal.wait_for(guard, std::chrono::milliseconds(timeoutMs), [this] { return pending; });
+        pending = false;
+    }
+};
+
+static runResult runPattern(const std::string &name, const std::vector<delivery> &deliveries, const benchSettings &settings,
+                            uint32_t traceMs)
+{
+    std::vector<uint8_t> storage(settings.ring);
+    pcmRing ring;
+    if (!ring.begin(storage.data(), settings.ring, settings.prefill))
+    {
+        fprintf(stderr, "Ring size must be a power of two\n");
+        exit(2);
+    }
+    benchClock::time_point origin = benchClock::now();
+    mockI2S i2s(origin, settings.dmaCount * settings.dmaFrames * PCM_FRAME_BYTES);
+    notifier writerNotification;
+    std::atomic<bool> streaming{true};
+    std::atomic<bool> running{true};
+    std::vector<double> callbackNs;
+    callbackNs.reserve(deliveries.size());
+
+    // Same loop as pcmWriterTask
+    std::thread writer([&] {
+        std::vector<uint8_t> chunk(settings.chunk);
+        while (running)
+        {
+            if (!streaming && ring.fill() == 0 && ring.primed())
+            {
+                ring.clear();
+                i2s.stop();
+            }
+            else if (!streaming)
+                ring.flush();
+            uint32_t len = ring.read(chunk.data(), chunk.size());
+            if (len > 0)
+                i2s.write(len);
+            else
+                writerNotification.take(5);
+        }
+    });
+
+    // Same work as read_data_stream
+    std::thread producer([&] {
+        std::vector<uint8_t> pcm(65536);
+        for (const delivery &callback : deliveries)
+        {
+            std::this_thread::sleep_until(origin + std::chrono::duration_cast<benchClock::duration>(
+                                                       std::chrono::duration<double, std::micro>(callback.offsetUs)));
+            if (callback.bytes > pcm.size())
+                pcm.resize(callback.bytes);
+            benchClock::time_point start = benchClock::now();
+            ring.write(pcm.data(), callback.bytes);
+            writerNotification.give();
+            callbackNs.push_back(std::chrono::duration<double, std::nano>(benchClock::now() - start).count());
+        }
+        streaming = false;
+    });
+
+    // Occupancy, sampled every millisecond once playing
+    runResult result;
+    result.pattern = name;
+    result.bufferedMinMs = 1e9;
+    double bufferedSum = 0;
+    uint32_t samples = 0;
+    double endUs = deliveries.back().offsetUs;
+    double nextTraceUs = 0;
+    if (traceMs)
+        printf("\n%s\n%8s %10s %10s %12s %10s %10s\n", name.c_str(), "t ms", "ring ms", "dma ms", "buffered ms",
+               "underruns", "dropouts");
+    while (usSince(origin) < endUs)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        double nowUs = usSince(origin);
+        double ringMs = bytesToMs(ring.fill());
+        double dmaMs = bytesToMs(i2s.fill());
+        if (ring.primed() || dmaMs > 0)
+        {
+            result.bufferedMinMs = std::min(result.bufferedMinMs, ringMs + dmaMs);
+            result.bufferedMaxMs = std::max(result.bufferedMaxMs, ringMs + dmaMs);
+            bufferedSum += ringMs + dmaMs;
+            samples++;
+        }
+        if (traceMs && nowUs >= nextTraceUs)
+        {
+            printf("%8.0f %10.1f %10.1f %12.1f %10u %10u\n", nowUs / 1000, ringMs, dmaMs, ringMs + dmaMs,
+                   ring.stats().underruns, i2s.dropouts);
+            nextTraceUs += traceMs * 1000.0;
+        }
+    }
+
+    producer.join();
+    // Let the tail of the stream play out
+    while (ring.fill() > 0 || i2s.fill() > 0)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    running = false;
+    writer.join();
+
+    result.callbacks = callbackNs.size();
+    for (double ns : callbackNs)
+        result.callbackMeanNs += ns / callbackNs.size();
+    std::sort(callbackNs.begin(), callbackNs.end());
+    result.callbackP99Ns = callbackNs[(callbackNs.size() * 99) / 100];
+    result.callbackMaxNs = callbackNs.back();
+    result.bufferedMeanMs = samples ? bufferedSum / samples : 0;
+    if (!samples)
+        result.bufferedMinMs = 0;
+    result.ring = ring.stats();
+    result.dropouts = i2s.dropouts;
+    result.silentMs = i2s.silentUs / 1000;
+    return result;
+}
+
+/// @brief Parses "--name=value" into value if the argument matches
+static bool option(const char *argument, const char *name, std::string &value)
+{
+    size_t length = strlen(name);
+    if (strncmp(argument, name, length) != 0 || argument[length] != '=')
+        return false;
+    value = argument + length + 1;
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    benchSettings settings;
+    bufferProfileId profileId = BUFFER_PROFILE_BALANCED;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string value;
+        if (option(argv[i], "--profile", value))
+        {
+            if (!findBufferProfile(value.c_str(), profileId))
+            {
+                fprintf(stderr, "Unknown profile %s\n", value.c_str());
+                return 2;
+            }
+        }
+        else if (option(argv[i], "--pattern", value))
+            settings.pattern = value;
+        else if (option(argv[i], "--seconds", value))
+            settings.seconds = atoi(value.c_str());
+        else if (option(argv[i], "--packet", value))
+            settings.packet = atoi(value.c_str());
+        else if (option(argv[i], "--jitter", value))
+            settings.jitterMs = atoi(value.c_str());
+        else if (option(argv[i], "--gap", value))
+            settings.gapMs = atoi(value.c_str());
+        else if (option(argv[i], "--ring", value))
+            settings.ring = atoi(value.c_str());
+        else if (option(argv[i], "--prefill", value))
+            settings.prefill = atoi(value.c_str());
+        else if (option(argv[i], "--storage", value))
+            settings.storage = atoi(value.c_str());
+        else if (option(argv[i], "--chunk", value))
+            settings.chunk = atoi(value.c_str());
+        else if (option(argv[i], "--dma-count", value))
+            settings.dmaCount = atoi(value.c_str());
+        else if (option(argv[i], "--dma-frames", value))
+            settings.dmaFrames = atoi(value.c_str());
+        else if (option(argv[i], "--trace", value))
+            settings.traceMs = atoi(value.c_str());
+        else
+        {
+            fprintf(stderr, "Unknown option %s, see the top of tools/sinkBench.cpp\n", argv[i]);
+            return 2;
+        }
+    }
+    if (settings.seconds == 0 || settings.packet == 0 || settings.chunk == 0)
+    {
+        fprintf(stderr, "Seconds, packet and chunk must not be 0\n");
+        return 2;
+    }
+
+    std::vector<std::string> patterns;
+    if (settings.pattern == "all")
+        patterns = {"steady", "jitter", "gaps", "catchup"};
+    else
+        patterns = {settings.pattern};
+    uint32_t traceMs = settings.traceMs >= 0 ? settings.traceMs : (patterns.size() == 1 ? 250 : 0);
+
+    // Options left out come from the profile
+    const bufferProfile &profile = getBufferProfile(profileId);
+    settings.ring = settings.ring ? settings.ring : profile.ringSize;
+    settings.prefill = settings.prefill ? settings.prefill : profile.ringPrefill;
+    settings.dmaCount = settings.dmaCount ? settings.dmaCount : profile.i2sBufferCount;
+    settings.dmaFrames = settings.dmaFrames ? settings.dmaFrames : profile.i2sBufferFrames;
+    uint32_t dmaBytes = settings.dmaCount * settings.dmaFrames * PCM_FRAME_BYTES;
+    uint32_t askedRing = settings.ring, askedPrefill = settings.prefill;
+    if (clampRingSettings(settings.storage, settings.ring, settings.prefill))
+        printf("Clamped like the firmware : ring %u bytes, prefill %u bytes instead of %u and %u\n", settings.ring,
+               settings.prefill, askedRing, askedPrefill);
+    if (!dmaFitsPrefill(dmaBytes, settings.prefill))
+        printf("DMA not under the prefill minus one A2DP packet, expect dropouts\n");
+    printf("%s profile : ring %u bytes (%.1f ms), prefill %u bytes (%.1f ms), DMA %u x %u frames (%.1f ms), packets of "
+           "%u bytes (%.1f ms)\n",
+           profile.name, settings.ring, bytesToMs(settings.ring), settings.prefill, bytesToMs(settings.prefill),
+           settings.dmaCount, settings.dmaFrames, bytesToMs(dmaBytes), settings.packet, bytesToMs(settings.packet));
+
+    std::vector<runResult> results;
+    for (const std::string &pattern : patterns)
+    {
+        std::vector<delivery> deliveries;
+        if (pattern == "steady" || pattern == "jitter" || pattern == "gaps" || pattern == "catchup")
+            deliveries = buildPattern(pattern, settings);
+        else if (!loadPattern(pattern, deliveries))
+        {
+            fprintf(stderr, "Cannot read the pattern file %s\n", pattern.c_str());
+            return 2;
+        }
+        results.push_back(runPattern(pattern, deliveries, settings, traceMs));
+    }
+
+    bool clean = true;
+    printf("\n%-10s %9s %21s %22s %9s %9s %9s %10s\n", "pattern", "callbacks", "callback ns mean/p99/max",
+           "buffered ms min/avg/max", "underruns", "overruns", "dropouts", "silent ms");
+    for (const runResult &result : results)
+    {
+        printf("%-10s %9u %7.0f/%6.0f/%6.0f %8.1f/%6.1f/%6.1f %9u %9u %9u %10.1f\n", result.pattern.c_str(), result.callbacks,
+               result.callbackMeanNs, result.callbackP99Ns, result.callbackMaxNs, result.bufferedMinMs,
+               result.bufferedMeanMs, result.bufferedMaxMs, result.ring.underruns, result.ring.overruns, result.dropouts,
+               result.silentMs);
+        clean &= result.dropouts == 0;
+    }
+    return clean ? 0 : 1;
+}